@@ -69,15 +69,16 @@ tree doesn't have cyclic references.
 #define JSON_MAX_RECURSION_DEPTH 1024
 #endif
 
-// Max recursion depth, default for decoder
+// Max nesting depth, default for decoder when JSONObjectDecoder.maxDepth is 0
 #ifndef JSON_MAX_OBJECT_DEPTH
 #define JSON_MAX_OBJECT_DEPTH 1024
 #endif
 
 /*
-Dictates and limits how much stack space for buffers UltraJSON will use before resorting to provided heap functions */
+Dictates and limits how much stack space for buffers UltraJSON will use before resorting to provided heap functions.
+Kept small so decoding works on threads with small stacks */
 #ifndef JSON_MAX_STACK_BUFFER_SIZE
-#define JSON_MAX_STACK_BUFFER_SIZE 131072
+#define JSON_MAX_STACK_BUFFER_SIZE 16384
 #endif
 
 #ifdef _WIN32
@@ -179,6 +180,7 @@ typedef char *(*JSPFN_ITERGETNAME)(JSOBJ obj, JSONTypeContext *tc, size_t *outLe
 typedef void *(*JSPFN_MALLOC)(size_t size);
 typedef void (*JSPFN_FREE)(void *pptr);
 typedef void *(*JSPFN_REALLOC)(void *base, size_t size);
+typedef JSOBJ (*JSPFN_NEWSTRINGUTF8)(void *prv, char *start, char *end, JSUTF32 maxChar, int escaped);
 
 
 struct __JSONObjectEncoder;
@@ -298,6 +300,24 @@ JSONObjectEncoder.free or free() as specified when calling this function.
 EXPORTFUNCTION char *JSON_EncodeObject(JSOBJ obj, JSONObjectEncoder *enc, char *buffer, size_t cbBuffer);
 
 
+/*
+Selects the parts of a document JSON_DecodeObject decodes. An object decoded under a projection only keeps
+the listed keys, compared by their UTF-8 bytes after unescaping; the value of each is decoded under fields,
+or whole if fields is NULL. The values of other keys are skipped without any callbacks by counting brackets
+and quotes, so they are only checked for balanced brackets and terminated strings. Each element of an array
+is decoded under the same projection as the array, other values are decoded as usual */
+typedef struct __JSONProjectionKey
+{
+  const char *name;
+  size_t length;
+  const struct __JSONProjection *fields;
+} JSONProjectionKey;
+
+typedef struct __JSONProjection
+{
+  size_t count;
+  const JSONProjectionKey *keys;
+} JSONProjection;
 
 typedef struct __JSONObjectDecoder
 {
@@ -321,8 +341,226 @@ typedef struct __JSONObjectDecoder
   char *errorOffset;
   int preciseFloat;
   void *prv;
+
+  /*
+  Optional, set to NULL to receive strings through newString.
+  If set, strings are passed as unescaped UTF-8 in [start, end) instead of being widened to wchar_t.
+  maxChar is the highest code point found in the string (at most 0x10ffff), which lets the callee pick
+  its storage up front. Escaped surrogates that don't form a pair are passed encoded as 3 byte sequences.
+
+  If escaped is 0 the string needed no unescaping and [start, end) points straight into the input buffer,
+  so it stays valid as long as the input does. Otherwise it points into the decoder's escape buffer and is
+  only valid until the callback returns */
+  JSPFN_NEWSTRINGUTF8 newStringUTF8;
+
+  /*
+  Optional, same as newStringUTF8 but only called for object key names, which tend to repeat and can be
+  cached by the callee. Works whether newStringUTF8 is set or not */
+  JSPFN_NEWSTRINGUTF8 newKeyUTF8;
+
+  /*
+  Deepest nesting of arrays and objects accepted, 0 for JSON_MAX_OBJECT_DEPTH. Open containers are kept on a
+  heap allocated stack so this isn't bound by the size of the C stack */
+  size_t maxDepth;
+
+  /*
+  Optional, decode only the parts of the document it selects. Only JSON_DecodeObject supports it */
+  const JSONProjection *projection;
+
+  /*
+  Optional, a block of escBufferLength wchar_t allocated with malloc that JSON_DecodeObject and the push decoder
+  unescape strings into instead of a buffer of their own. It's grown with realloc when a string doesn't fit and the grown block
+  is stored back, so it can be kept from call to call. The caller frees it */
+  wchar_t *escBuffer;
+  size_t escBufferLength;
+
+  /*
+  Set if the input is Latin-1, one byte per code point as in the storage of a Python str of kind
+  PyUnicode_1BYTE_KIND, rather than UTF-8. Strings are still handed on as UTF-8 */
+  int latin1;
+
+  /*
+  Optional, gets arrays whose elements are all numbers in place of newArray and arrayAddItem. type is JT_LONG
+  if values are JSINT64, for arrays of integers, or JT_DOUBLE if they are doubles, for arrays with a fraction
+  or exponent in any element and no integer beyond 2^53. Other arrays, empty ones included, are decoded as
+  usual. Only JSON_DecodeObject and JSON_DecodeLines call it */
+  JSOBJ (*newNumericArray)(void *prv, int type, const void *values, size_t count);
+
+  /*
+  Optional, set both to get every array and object whole once it's closed so it can be made at its final size,
+  instead of through newArray and arrayAddItem or newObject and objectAddKey. endArray gets the count values of
+  an array, endObject the count key names and values of an object as name, value, name, value... Both own the
+  values from then on, whether they succeed or not. Only JSON_DecodeObject, JSON_DecodeLines and
+  JSON_DecodeRecords use them, the other entry points still call newArray and newObject */
+  JSOBJ (*endArray)(void *prv, JSOBJ *values, size_t count);
+  JSOBJ (*endObject)(void *prv, JSOBJ *values, size_t count);
 } JSONObjectDecoder;
 
 EXPORTFUNCTION JSOBJ JSON_DecodeObject(JSONObjectDecoder *dec, const char *buffer, size_t cbBuffer);
 
+/*
+Decodes JSON Lines: every '\n' terminated line of buffer is a document of its own, lines holding only
+whitespace are skipped. The decoder state and its escape buffer are reused from line to line. addLine gets
+the object decoded from each line with its 1-based line number, or NULL with dec->errorStr set if the line
+is invalid, and returns nonzero to go on. Returns nonzero if every line was handed to addLine */
+typedef int (*JSPFN_ADDLINE)(void *prv, JSOBJ obj, size_t line);
+
+EXPORTFUNCTION int JSON_DecodeLines(JSONObjectDecoder *dec, const char *buffer, size_t cbBuffer, JSPFN_ADDLINE addLine);
+
+/*
+Decodes an array of objects, the records, field by field instead of into objects. addField gets the key name
+and value of each field with the 0-based index of its record and returns nonzero to go on; both are its own.
+Numbers that fit a JSINT64 or a double are passed with type JT_LONG or JT_DOUBLE at *number (a JSINT64 or a
+double) and value NULL, without a callback. Other values come from the callbacks with type JT_INVALID and
+number NULL. The document is decoded by the same code as JSON_DecodeObject, so the buffer must be followed by
+a '\0' and errors and the depth limit are the same as for the array decoded whole. Returns nonzero if the whole document was decoded, either way the number of records read is put in *prows */
+typedef int (*JSPFN_ADDFIELD)(void *prv, size_t row, JSOBJ name, int type, JSOBJ value, const void *number);
+
+EXPORTFUNCTION int JSON_DecodeRecords(JSONObjectDecoder *dec, const char *buffer, size_t cbBuffer, JSPFN_ADDFIELD addField, size_t *prows);
+
+/*
+Same contract as JSON_DecodeObject, using the two stage engine: one vectorized pass indexes the position of
+every token, then the index is walked without recursion. The index takes 4 bytes per input byte, allocated
+with dec->malloc. Inputs of 4 GB and more are rejected */
+EXPORTFUNCTION JSOBJ JSON_DecodeObjectIndexed(JSONObjectDecoder *dec, const char *buffer, size_t cbBuffer);
+
+/*
+Push decoder for input that arrives in pieces, e.g. from a socket. Makes the same callbacks as
+JSON_DecodeObject as the values complete. Chunks can be split anywhere, including inside tokens, and
+don't need to be NUL terminated. Memory use is bounded by the nesting depth and the longest string or number,
+not the size of the document.
+
+JSON_DecoderInit returns NULL with dec->errorStr set if out of memory. JSON_DecoderFeed returns 0 once the
+input turned out to be invalid, with dec->errorStr set; feeding can stop there. JSON_DecoderFinish must
+always be called, it ends the input, releases the decoder and returns the decoded object or NULL with
+dec->errorStr set. dec->errorOffset isn't meaningful with this API.
+
+Strings that end inside a chunk are passed to newStringUTF8 pointing into the chunk, others point into a
+buffer of the decoder, either way only valid during the callback */
+typedef struct __JSONPushDecoder JSONPushDecoder;
+
+EXPORTFUNCTION JSONPushDecoder *JSON_DecoderInit(JSONObjectDecoder *dec);
+EXPORTFUNCTION int JSON_DecoderFeed(JSONPushDecoder *pd, const char *chunk, size_t cbChunk);
+EXPORTFUNCTION JSOBJ JSON_DecoderFinish(JSONPushDecoder *pd);
+
+/*
+Same as JSON_DecodeObject for input that isn't followed by a '\0', e.g. a slice of a larger buffer: nothing
+outside [buffer, buffer + cbBuffer) is read. This isn't a bounds checked JSON_DecodeObject, the input is fed to
+the push decoder in one piece. Strings and numbers are still decoded in place, but the push decoder's per token
+state machine makes it 1.1 to 1.5 times slower than JSON_DecodeObject, most for arrays of numbers. Copying the
+input after a '\0' and using JSON_DecodeObject is faster when the memory for a copy isn't a concern.
+dec->projection isn't supported and dec->errorOffset isn't set */
+EXPORTFUNCTION JSOBJ JSON_DecodeObjectBounded(JSONObjectDecoder *dec, const char *buffer, size_t cbBuffer);
+
+/*
+Events of JSON_SaxParse and tokens of JSONReader */
+enum JSON_EVENTS
+{
+  JE_START_OBJECT,
+  JE_END_OBJECT,
+  JE_START_ARRAY,
+  JE_END_ARRAY,
+  JE_KEY,
+  JE_SCALAR,
+  JE_END,
+  JE_ERROR
+};
+
+/*
+Event (SAX) interface, for consumers that don't need a tree. The document is checked with the same grammar
+as JSON_DecodeObject, with the same error messages, and reported as a sequence of events, nothing is
+allocated except for nesting deeper than 64. Only numbers are read more strictly: they need digits before
+any fraction and after an exponent marker, where JSON_DecodeObject also takes "-", "-.5" or "1e". Any
+callback can be NULL to ignore the event, returning 0 from one stops parsing.
+
+Keys and scalars are passed as raw spans of the input: strings without their quotes, escape sequences
+checked but not decoded (escaped is nonzero if the span contains any) and UTF-8 not validated, numbers
+and literals as written. type is JT_UTF8, JT_LONG for numbers without fraction or exponent, JT_DOUBLE for
+other numbers, JT_TRUE, JT_FALSE or JT_NULL. All reads are bounds checked, the buffer doesn't have to be
+NUL terminated */
+typedef struct __JSONSaxHandler
+{
+  int (*startObject)(void *prv);
+  int (*endObject)(void *prv);
+  int (*startArray)(void *prv);
+  int (*endArray)(void *prv);
+  int (*key)(void *prv, const char *start, const char *end, int escaped);
+  int (*scalar)(void *prv, int type, const char *start, const char *end, int escaped);
+  JSPFN_MALLOC malloc;
+  JSPFN_FREE free;
+  JSPFN_REALLOC realloc;
+  char *errorStr;
+  char *errorOffset;
+
+  // Deepest nesting accepted, 0 for JSON_MAX_OBJECT_DEPTH
+  size_t maxDepth;
+  void *prv;
+} JSONSaxHandler;
+
+/*
+Returns nonzero if the whole document was parsed, otherwise errorStr and errorOffset are set */
+EXPORTFUNCTION int JSON_SaxParse(JSONSaxHandler *handler, const char *buffer, size_t cbBuffer);
+
+/*
+Pull reader over the same events, for hand written parsers of known messages: JSON_Reader_Next returns
+the next JE_ event and describes it in token, which can be NULL. Keys and scalars are described as for
+JSONSaxHandler, for the other events type is JT_OBJECT or JT_ARRAY and the span is the bracket.
+
+JSON_Reader_SkipValue skips the next value without reporting what's inside. Containers are skipped by
+counting brackets, their contents aren't validated beyond brackets balancing and strings being
+terminated. After a key or in an array it returns JE_SCALAR, JE_START_OBJECT or JE_START_ARRAY; where a key
+is next it skips the key and its value and returns JE_KEY with token describing the key. If the enclosing
+container or the document ends instead that event is returned and consumed like JSON_Reader_Next does.
+
+Reading can stop at any point. After JE_ERROR, JSON_Reader_Error returns the message and sets *errorOffset
+if not NULL. JSON_Reader_Init returns NULL if out of memory, JSON_Reader_Release frees the reader */
+typedef struct __JSONReader JSONReader;
+
+typedef struct __JSONToken
+{
+  int type;
+  const char *start;
+  const char *end;
+  int escaped;
+} JSONToken;
+
+EXPORTFUNCTION JSONReader *JSON_Reader_Init(const char *buffer, size_t cbBuffer, size_t maxDepth, JSPFN_MALLOC pfnMalloc, JSPFN_FREE pfnFree, JSPFN_REALLOC pfnRealloc);
+EXPORTFUNCTION int JSON_Reader_Next(JSONReader *reader, JSONToken *token);
+EXPORTFUNCTION int JSON_Reader_SkipValue(JSONReader *reader, JSONToken *token);
+EXPORTFUNCTION const char *JSON_Reader_Error(JSONReader *reader, const char **errorOffset);
+
+/*
+Returns where reading continues, just past the last token or skipped value */
+EXPORTFUNCTION const char *JSON_Reader_Offset(JSONReader *reader);
+EXPORTFUNCTION void JSON_Reader_Release(JSONReader *reader);
+
+/*
+Tape of a document for lazy access: one entry per value and key in document order, made in one pass of the
+event parser. Entries hold the JT_ type and the offsets of the text in the input, so values can be decoded
+on demand with JSON_DecodeObject on [start, end), strings including their quotes. For containers (JT_OBJECT
+or JT_ARRAY, start is the bracket) end is instead the index of the entry following the container and count
+the number of values it holds; in objects a key entry precedes each value.
+
+The grammar is checked like JSON_SaxParse does, scalars are only checked once decoded. Returns nonzero on
+success, entries is allocated with pfnMalloc and must be freed with pfnFree. Otherwise errorStr and
+errorOffset are set and nothing needs to be freed */
+typedef struct __JSONTapeEntry
+{
+  JSUINT32 type;
+  JSUINT32 start;
+  JSUINT32 end;
+  JSUINT32 count;
+} JSONTapeEntry;
+
+typedef struct __JSONTape
+{
+  JSONTapeEntry *entries;
+  size_t count;
+  size_t capacity;
+  char *errorStr;
+  char *errorOffset;
+} JSONTape;
+
+EXPORTFUNCTION int JSON_BuildTape(JSONTape *tape, const char *buffer, size_t cbBuffer, size_t maxDepth, JSPFN_MALLOC pfnMalloc, JSPFN_FREE pfnFree, JSPFN_REALLOC pfnRealloc);
+
 #endif
@@ -44,6 +44,7 @@ http://www.opensource.apple.com/source/tcl/tcl-14/tcl/license.terms
 #include <wchar.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <float.h>
 
 #ifndef TRUE
 #define TRUE 1
@@ -53,6 +54,53 @@ http://www.opensource.apple.com/source/tcl/tcl-14/tcl/license.terms
 #define NULL 0
 #endif
 
+/*
+SIMD paths are picked at compile time. SSE2 is part of the x86-64 baseline so it is used whenever the
+compiler targets it, AVX2 only when explicitly enabled (e.g. -mavx2 or -march=native) */
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define JSON_DECODE_AVX2
+#define JSON_DECODE_SSE2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define JSON_DECODE_SSE2
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+static __inline int CountTrailingZeros(JSUINT32 mask)
+{
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return (int) index;
+}
+#else
+#define CountTrailingZeros(mask) __builtin_ctz(mask)
+#endif
+
+/*
+Numbers are scanned 8 digits at a time by loading them into a 64-bit word (SWAR), which needs the first
+character in the low byte */
+#ifdef __LITTLE_ENDIAN__
+#define JSON_DECODE_SWAR
+
+#if defined(_MSC_VER) && defined(_M_X64)
+static __inline int CountTrailingZeros64(JSUINT64 mask)
+{
+  unsigned long index;
+  _BitScanForward64(&index, mask);
+  return (int) index;
+}
+#elif defined(_MSC_VER)
+static __inline int CountTrailingZeros64(JSUINT64 mask)
+{
+  return (JSUINT32) mask ? CountTrailingZeros((JSUINT32) mask) : 32 + CountTrailingZeros((JSUINT32) (mask >> 32));
+}
+#else
+#define CountTrailingZeros64(mask) __builtin_ctzll(mask)
+#endif
+#endif
+
 struct DecoderState
 {
   char *start;
@@ -61,9 +109,22 @@ struct DecoderState
   wchar_t *escEnd;
   int escHeap;
   int lastType;
-  JSUINT32 objDepth;
+  size_t maxDepth;
+
+  // Projection of the next value decoded, NULL to decode everything
+  const JSONProjection *projection;
   void *prv;
   JSONObjectDecoder *dec;
+
+  // Set while DecodeNumericArray runs, numbers are then stored here rather than handed to the callbacks
+  int rawNumbers;
+  int numberType;
+  JSINT64 numberLong;
+  double numberDouble;
+
+  // Set by JSON_DecodeRecords, the fields of the objects in the top level array are handed to it
+  JSPFN_ADDFIELD addField;
+  size_t row;
 };
 
 JSOBJ FASTCALL_MSVC decode_any( struct DecoderState *ds) FASTCALL_ATTR;
@@ -82,7 +143,878 @@ double createDouble(double intNeg, double intValue, double frcValue, int frcDeci
   return (intValue + (frcValue * g_pow10[frcDecimalCount])) * intNeg;
 }
 
-FASTCALL_ATTR JSOBJ FASTCALL_MSVC decodePreciseFloat(struct DecoderState *ds)
+/*
+The number decoders hand their result to these, which pass it on to the callbacks or, while ds->rawNumbers
+is set, store it in ds and return ds itself as a non NULL result */
+static FASTCALL_ATTR INLINE_PREFIX JSOBJ FASTCALL_MSVC NewInt(struct DecoderState *ds, JSINT32 value)
+{
+  if (ds->rawNumbers)
+  {
+    ds->numberType = JT_LONG;
+    ds->numberLong = value;
+    return (JSOBJ) ds;
+  }
+
+  return ds->dec->newInt(ds->prv, value);
+}
+
+static FASTCALL_ATTR INLINE_PREFIX JSOBJ FASTCALL_MSVC NewLong(struct DecoderState *ds, JSINT64 value)
+{
+  if (ds->rawNumbers)
+  {
+    ds->numberType = JT_LONG;
+    ds->numberLong = value;
+    return (JSOBJ) ds;
+  }
+
+  return ds->dec->newLong(ds->prv, value);
+}
+
+static FASTCALL_ATTR INLINE_PREFIX JSOBJ FASTCALL_MSVC NewUnsignedLong(struct DecoderState *ds, JSUINT64 value)
+{
+  if (ds->rawNumbers)
+  {
+    ds->numberType = JT_ULONG;
+    return (JSOBJ) ds;
+  }
+
+  return ds->dec->newUnsignedLong(ds->prv, value);
+}
+
+static FASTCALL_ATTR INLINE_PREFIX JSOBJ FASTCALL_MSVC NewDouble(struct DecoderState *ds, double value)
+{
+  if (ds->rawNumbers)
+  {
+    ds->numberType = JT_DOUBLE;
+    ds->numberDouble = value;
+    return (JSOBJ) ds;
+  }
+
+  return ds->dec->newDouble(ds->prv, value);
+}
+
+#ifdef JSON_DECODE_SWAR
+/*
+Parses the run of up to 8 digits at offset, which must have 8 readable bytes, and returns how many there
+were (0 to 8) with their value in *pvalue. The digits are moved to the top of the word so a short run reads
+as if it had leading zeros, then pairs, quads and finally the two halves are combined with multiplications */
+static FASTCALL_ATTR INLINE_PREFIX int FASTCALL_MSVC ParseDigits8(const char *offset, JSUINT32 *pvalue)
+{
+  JSUINT64 chunk;
+  JSUINT64 nonDigits;
+  int count;
+
+  memcpy(&chunk, offset, sizeof(chunk));
+
+  // Bytes '0' to '9' become 0x33 here, a byte past 0xf9 may carry into the next one but only after a non-digit
+  nonDigits = ((chunk & 0xf0f0f0f0f0f0f0f0ULL) | (((chunk + 0x0606060606060606ULL) & 0xf0f0f0f0f0f0f0f0ULL) >> 4)) ^ 0x3333333333333333ULL;
+  nonDigits = (((nonDigits & 0x7f7f7f7f7f7f7f7fULL) + 0x7f7f7f7f7f7f7f7fULL) | nonDigits) & 0x8080808080808080ULL;
+
+  count = nonDigits ? CountTrailingZeros64(nonDigits) >> 3 : 8;
+
+  if (count == 0)
+  {
+    *pvalue = 0;
+    return 0;
+  }
+
+  chunk = (chunk - 0x3030303030303030ULL) << (8 * (8 - count));
+  chunk = (chunk * 10) + (chunk >> 8);
+  chunk = (((chunk & 0x000000ff000000ffULL) * (100 + (1000000ULL << 32))) + (((chunk >> 16) & 0x000000ff000000ffULL) * (1 + (10000ULL << 32)))) >> 32;
+
+  *pvalue = (JSUINT32) chunk;
+  return count;
+}
+#endif
+
+/*
+Powers of ten from 1e-342 to 1e308 as 128-bit mantissas (high word first), normalized so the top bit is set
+and rounded down. Anything outside that range is zero or infinite as a double */
+#define POW10_MIN_EXPONENT -342
+#define POW10_MAX_EXPONENT 308
+
+static const JSUINT64 g_pow10Mantissa[][2] =
+{
+  { 0xeef453d6923bd65aULL, 0x113faa2906a13b3fULL },
+  { 0x9558b4661b6565f8ULL, 0x4ac7ca59a424c507ULL },
+  { 0xbaaee17fa23ebf76ULL, 0x5d79bcf00d2df649ULL },
+  { 0xe95a99df8ace6f53ULL, 0xf4d82c2c107973dcULL },
+  { 0x91d8a02bb6c10594ULL, 0x79071b9b8a4be869ULL },
+  { 0xb64ec836a47146f9ULL, 0x9748e2826cdee284ULL },
+  { 0xe3e27a444d8d98b7ULL, 0xfd1b1b2308169b25ULL },
+  { 0x8e6d8c6ab0787f72ULL, 0xfe30f0f5e50e20f7ULL },
+  { 0xb208ef855c969f4fULL, 0xbdbd2d335e51a935ULL },
+  { 0xde8b2b66b3bc4723ULL, 0xad2c788035e61382ULL },
+  { 0x8b16fb203055ac76ULL, 0x4c3bcb5021afcc31ULL },
+  { 0xaddcb9e83c6b1793ULL, 0xdf4abe242a1bbf3dULL },
+  { 0xd953e8624b85dd78ULL, 0xd71d6dad34a2af0dULL },
+  { 0x87d4713d6f33aa6bULL, 0x8672648c40e5ad68ULL },
+  { 0xa9c98d8ccb009506ULL, 0x680efdaf511f18c2ULL },
+  { 0xd43bf0effdc0ba48ULL, 0x0212bd1b2566def2ULL },
+  { 0x84a57695fe98746dULL, 0x014bb630f7604b57ULL },
+  { 0xa5ced43b7e3e9188ULL, 0x419ea3bd35385e2dULL },
+  { 0xcf42894a5dce35eaULL, 0x52064cac828675b9ULL },
+  { 0x818995ce7aa0e1b2ULL, 0x7343efebd1940993ULL },
+  { 0xa1ebfb4219491a1fULL, 0x1014ebe6c5f90bf8ULL },
+  { 0xca66fa129f9b60a6ULL, 0xd41a26e077774ef6ULL },
+  { 0xfd00b897478238d0ULL, 0x8920b098955522b4ULL },
+  { 0x9e20735e8cb16382ULL, 0x55b46e5f5d5535b0ULL },
+  { 0xc5a890362fddbc62ULL, 0xeb2189f734aa831dULL },
+  { 0xf712b443bbd52b7bULL, 0xa5e9ec7501d523e4ULL },
+  { 0x9a6bb0aa55653b2dULL, 0x47b233c92125366eULL },
+  { 0xc1069cd4eabe89f8ULL, 0x999ec0bb696e840aULL },
+  { 0xf148440a256e2c76ULL, 0xc00670ea43ca250dULL },
+  { 0x96cd2a865764dbcaULL, 0x380406926a5e5728ULL },
+  { 0xbc807527ed3e12bcULL, 0xc605083704f5ecf2ULL },
+  { 0xeba09271e88d976bULL, 0xf7864a44c633682eULL },
+  { 0x93445b8731587ea3ULL, 0x7ab3ee6afbe0211dULL },
+  { 0xb8157268fdae9e4cULL, 0x5960ea05bad82964ULL },
+  { 0xe61acf033d1a45dfULL, 0x6fb92487298e33bdULL },
+  { 0x8fd0c16206306babULL, 0xa5d3b6d479f8e056ULL },
+  { 0xb3c4f1ba87bc8696ULL, 0x8f48a4899877186cULL },
+  { 0xe0b62e2929aba83cULL, 0x331acdabfe94de87ULL },
+  { 0x8c71dcd9ba0b4925ULL, 0x9ff0c08b7f1d0b14ULL },
+  { 0xaf8e5410288e1b6fULL, 0x07ecf0ae5ee44dd9ULL },
+  { 0xdb71e91432b1a24aULL, 0xc9e82cd9f69d6150ULL },
+  { 0x892731ac9faf056eULL, 0xbe311c083a225cd2ULL },
+  { 0xab70fe17c79ac6caULL, 0x6dbd630a48aaf406ULL },
+  { 0xd64d3d9db981787dULL, 0x092cbbccdad5b108ULL },
+  { 0x85f0468293f0eb4eULL, 0x25bbf56008c58ea5ULL },
+  { 0xa76c582338ed2621ULL, 0xaf2af2b80af6f24eULL },
+  { 0xd1476e2c07286faaULL, 0x1af5af660db4aee1ULL },
+  { 0x82cca4db847945caULL, 0x50d98d9fc890ed4dULL },
+  { 0xa37fce126597973cULL, 0xe50ff107bab528a0ULL },
+  { 0xcc5fc196fefd7d0cULL, 0x1e53ed49a96272c8ULL },
+  { 0xff77b1fcbebcdc4fULL, 0x25e8e89c13bb0f7aULL },
+  { 0x9faacf3df73609b1ULL, 0x77b191618c54e9acULL },
+  { 0xc795830d75038c1dULL, 0xd59df5b9ef6a2417ULL },
+  { 0xf97ae3d0d2446f25ULL, 0x4b0573286b44ad1dULL },
+  { 0x9becce62836ac577ULL, 0x4ee367f9430aec32ULL },
+  { 0xc2e801fb244576d5ULL, 0x229c41f793cda73fULL },
+  { 0xf3a20279ed56d48aULL, 0x6b43527578c1110fULL },
+  { 0x9845418c345644d6ULL, 0x830a13896b78aaa9ULL },
+  { 0xbe5691ef416bd60cULL, 0x23cc986bc656d553ULL },
+  { 0xedec366b11c6cb8fULL, 0x2cbfbe86b7ec8aa8ULL },
+  { 0x94b3a202eb1c3f39ULL, 0x7bf7d71432f3d6a9ULL },
+  { 0xb9e08a83a5e34f07ULL, 0xdaf5ccd93fb0cc53ULL },
+  { 0xe858ad248f5c22c9ULL, 0xd1b3400f8f9cff68ULL },
+  { 0x91376c36d99995beULL, 0x23100809b9c21fa1ULL },
+  { 0xb58547448ffffb2dULL, 0xabd40a0c2832a78aULL },
+  { 0xe2e69915b3fff9f9ULL, 0x16c90c8f323f516cULL },
+  { 0x8dd01fad907ffc3bULL, 0xae3da7d97f6792e3ULL },
+  { 0xb1442798f49ffb4aULL, 0x99cd11cfdf41779cULL },
+  { 0xdd95317f31c7fa1dULL, 0x40405643d711d583ULL },
+  { 0x8a7d3eef7f1cfc52ULL, 0x482835ea666b2572ULL },
+  { 0xad1c8eab5ee43b66ULL, 0xda3243650005eecfULL },
+  { 0xd863b256369d4a40ULL, 0x90bed43e40076a82ULL },
+  { 0x873e4f75e2224e68ULL, 0x5a7744a6e804a291ULL },
+  { 0xa90de3535aaae202ULL, 0x711515d0a205cb36ULL },
+  { 0xd3515c2831559a83ULL, 0x0d5a5b44ca873e03ULL },
+  { 0x8412d9991ed58091ULL, 0xe858790afe9486c2ULL },
+  { 0xa5178fff668ae0b6ULL, 0x626e974dbe39a872ULL },
+  { 0xce5d73ff402d98e3ULL, 0xfb0a3d212dc8128fULL },
+  { 0x80fa687f881c7f8eULL, 0x7ce66634bc9d0b99ULL },
+  { 0xa139029f6a239f72ULL, 0x1c1fffc1ebc44e80ULL },
+  { 0xc987434744ac874eULL, 0xa327ffb266b56220ULL },
+  { 0xfbe9141915d7a922ULL, 0x4bf1ff9f0062baa8ULL },
+  { 0x9d71ac8fada6c9b5ULL, 0x6f773fc3603db4a9ULL },
+  { 0xc4ce17b399107c22ULL, 0xcb550fb4384d21d3ULL },
+  { 0xf6019da07f549b2bULL, 0x7e2a53a146606a48ULL },
+  { 0x99c102844f94e0fbULL, 0x2eda7444cbfc426dULL },
+  { 0xc0314325637a1939ULL, 0xfa911155fefb5308ULL },
+  { 0xf03d93eebc589f88ULL, 0x793555ab7eba27caULL },
+  { 0x96267c7535b763b5ULL, 0x4bc1558b2f3458deULL },
+  { 0xbbb01b9283253ca2ULL, 0x9eb1aaedfb016f16ULL },
+  { 0xea9c227723ee8bcbULL, 0x465e15a979c1cadcULL },
+  { 0x92a1958a7675175fULL, 0x0bfacd89ec191ec9ULL },
+  { 0xb749faed14125d36ULL, 0xcef980ec671f667bULL },
+  { 0xe51c79a85916f484ULL, 0x82b7e12780e7401aULL },
+  { 0x8f31cc0937ae58d2ULL, 0xd1b2ecb8b0908810ULL },
+  { 0xb2fe3f0b8599ef07ULL, 0x861fa7e6dcb4aa15ULL },
+  { 0xdfbdcece67006ac9ULL, 0x67a791e093e1d49aULL },
+  { 0x8bd6a141006042bdULL, 0xe0c8bb2c5c6d24e0ULL },
+  { 0xaecc49914078536dULL, 0x58fae9f773886e18ULL },
+  { 0xda7f5bf590966848ULL, 0xaf39a475506a899eULL },
+  { 0x888f99797a5e012dULL, 0x6d8406c952429603ULL },
+  { 0xaab37fd7d8f58178ULL, 0xc8e5087ba6d33b83ULL },
+  { 0xd5605fcdcf32e1d6ULL, 0xfb1e4a9a90880a64ULL },
+  { 0x855c3be0a17fcd26ULL, 0x5cf2eea09a55067fULL },
+  { 0xa6b34ad8c9dfc06fULL, 0xf42faa48c0ea481eULL },
+  { 0xd0601d8efc57b08bULL, 0xf13b94daf124da26ULL },
+  { 0x823c12795db6ce57ULL, 0x76c53d08d6b70858ULL },
+  { 0xa2cb1717b52481edULL, 0x54768c4b0c64ca6eULL },
+  { 0xcb7ddcdda26da268ULL, 0xa9942f5dcf7dfd09ULL },
+  { 0xfe5d54150b090b02ULL, 0xd3f93b35435d7c4cULL },
+  { 0x9efa548d26e5a6e1ULL, 0xc47bc5014a1a6dafULL },
+  { 0xc6b8e9b0709f109aULL, 0x359ab6419ca1091bULL },
+  { 0xf867241c8cc6d4c0ULL, 0xc30163d203c94b62ULL },
+  { 0x9b407691d7fc44f8ULL, 0x79e0de63425dcf1dULL },
+  { 0xc21094364dfb5636ULL, 0x985915fc12f542e4ULL },
+  { 0xf294b943e17a2bc4ULL, 0x3e6f5b7b17b2939dULL },
+  { 0x979cf3ca6cec5b5aULL, 0xa705992ceecf9c42ULL },
+  { 0xbd8430bd08277231ULL, 0x50c6ff782a838353ULL },
+  { 0xece53cec4a314ebdULL, 0xa4f8bf5635246428ULL },
+  { 0x940f4613ae5ed136ULL, 0x871b7795e136be99ULL },
+  { 0xb913179899f68584ULL, 0x28e2557b59846e3fULL },
+  { 0xe757dd7ec07426e5ULL, 0x331aeada2fe589cfULL },
+  { 0x9096ea6f3848984fULL, 0x3ff0d2c85def7621ULL },
+  { 0xb4bca50b065abe63ULL, 0x0fed077a756b53a9ULL },
+  { 0xe1ebce4dc7f16dfbULL, 0xd3e8495912c62894ULL },
+  { 0x8d3360f09cf6e4bdULL, 0x64712dd7abbbd95cULL },
+  { 0xb080392cc4349decULL, 0xbd8d794d96aacfb3ULL },
+  { 0xdca04777f541c567ULL, 0xecf0d7a0fc5583a0ULL },
+  { 0x89e42caaf9491b60ULL, 0xf41686c49db57244ULL },
+  { 0xac5d37d5b79b6239ULL, 0x311c2875c522ced5ULL },
+  { 0xd77485cb25823ac7ULL, 0x7d633293366b828bULL },
+  { 0x86a8d39ef77164bcULL, 0xae5dff9c02033197ULL },
+  { 0xa8530886b54dbdebULL, 0xd9f57f830283fdfcULL },
+  { 0xd267caa862a12d66ULL, 0xd072df63c324fd7bULL },
+  { 0x8380dea93da4bc60ULL, 0x4247cb9e59f71e6dULL },
+  { 0xa46116538d0deb78ULL, 0x52d9be85f074e608ULL },
+  { 0xcd795be870516656ULL, 0x67902e276c921f8bULL },
+  { 0x806bd9714632dff6ULL, 0x00ba1cd8a3db53b6ULL },
+  { 0xa086cfcd97bf97f3ULL, 0x80e8a40eccd228a4ULL },
+  { 0xc8a883c0fdaf7df0ULL, 0x6122cd128006b2cdULL },
+  { 0xfad2a4b13d1b5d6cULL, 0x796b805720085f81ULL },
+  { 0x9cc3a6eec6311a63ULL, 0xcbe3303674053bb0ULL },
+  { 0xc3f490aa77bd60fcULL, 0xbedbfc4411068a9cULL },
+  { 0xf4f1b4d515acb93bULL, 0xee92fb5515482d44ULL },
+  { 0x991711052d8bf3c5ULL, 0x751bdd152d4d1c4aULL },
+  { 0xbf5cd54678eef0b6ULL, 0xd262d45a78a0635dULL },
+  { 0xef340a98172aace4ULL, 0x86fb897116c87c34ULL },
+  { 0x9580869f0e7aac0eULL, 0xd45d35e6ae3d4da0ULL },
+  { 0xbae0a846d2195712ULL, 0x8974836059cca109ULL },
+  { 0xe998d258869facd7ULL, 0x2bd1a438703fc94bULL },
+  { 0x91ff83775423cc06ULL, 0x7b6306a34627ddcfULL },
+  { 0xb67f6455292cbf08ULL, 0x1a3bc84c17b1d542ULL },
+  { 0xe41f3d6a7377eecaULL, 0x20caba5f1d9e4a93ULL },
+  { 0x8e938662882af53eULL, 0x547eb47b7282ee9cULL },
+  { 0xb23867fb2a35b28dULL, 0xe99e619a4f23aa43ULL },
+  { 0xdec681f9f4c31f31ULL, 0x6405fa00e2ec94d4ULL },
+  { 0x8b3c113c38f9f37eULL, 0xde83bc408dd3dd04ULL },
+  { 0xae0b158b4738705eULL, 0x9624ab50b148d445ULL },
+  { 0xd98ddaee19068c76ULL, 0x3badd624dd9b0957ULL },
+  { 0x87f8a8d4cfa417c9ULL, 0xe54ca5d70a80e5d6ULL },
+  { 0xa9f6d30a038d1dbcULL, 0x5e9fcf4ccd211f4cULL },
+  { 0xd47487cc8470652bULL, 0x7647c3200069671fULL },
+  { 0x84c8d4dfd2c63f3bULL, 0x29ecd9f40041e073ULL },
+  { 0xa5fb0a17c777cf09ULL, 0xf468107100525890ULL },
+  { 0xcf79cc9db955c2ccULL, 0x7182148d4066eeb4ULL },
+  { 0x81ac1fe293d599bfULL, 0xc6f14cd848405530ULL },
+  { 0xa21727db38cb002fULL, 0xb8ada00e5a506a7cULL },
+  { 0xca9cf1d206fdc03bULL, 0xa6d90811f0e4851cULL },
+  { 0xfd442e4688bd304aULL, 0x908f4a166d1da663ULL },
+  { 0x9e4a9cec15763e2eULL, 0x9a598e4e043287feULL },
+  { 0xc5dd44271ad3cdbaULL, 0x40eff1e1853f29fdULL },
+  { 0xf7549530e188c128ULL, 0xd12bee59e68ef47cULL },
+  { 0x9a94dd3e8cf578b9ULL, 0x82bb74f8301958ceULL },
+  { 0xc13a148e3032d6e7ULL, 0xe36a52363c1faf01ULL },
+  { 0xf18899b1bc3f8ca1ULL, 0xdc44e6c3cb279ac1ULL },
+  { 0x96f5600f15a7b7e5ULL, 0x29ab103a5ef8c0b9ULL },
+  { 0xbcb2b812db11a5deULL, 0x7415d448f6b6f0e7ULL },
+  { 0xebdf661791d60f56ULL, 0x111b495b3464ad21ULL },
+  { 0x936b9fcebb25c995ULL, 0xcab10dd900beec34ULL },
+  { 0xb84687c269ef3bfbULL, 0x3d5d514f40eea742ULL },
+  { 0xe65829b3046b0afaULL, 0x0cb4a5a3112a5112ULL },
+  { 0x8ff71a0fe2c2e6dcULL, 0x47f0e785eaba72abULL },
+  { 0xb3f4e093db73a093ULL, 0x59ed216765690f56ULL },
+  { 0xe0f218b8d25088b8ULL, 0x306869c13ec3532cULL },
+  { 0x8c974f7383725573ULL, 0x1e414218c73a13fbULL },
+  { 0xafbd2350644eeacfULL, 0xe5d1929ef90898faULL },
+  { 0xdbac6c247d62a583ULL, 0xdf45f746b74abf39ULL },
+  { 0x894bc396ce5da772ULL, 0x6b8bba8c328eb783ULL },
+  { 0xab9eb47c81f5114fULL, 0x066ea92f3f326564ULL },
+  { 0xd686619ba27255a2ULL, 0xc80a537b0efefebdULL },
+  { 0x8613fd0145877585ULL, 0xbd06742ce95f5f36ULL },
+  { 0xa798fc4196e952e7ULL, 0x2c48113823b73704ULL },
+  { 0xd17f3b51fca3a7a0ULL, 0xf75a15862ca504c5ULL },
+  { 0x82ef85133de648c4ULL, 0x9a984d73dbe722fbULL },
+  { 0xa3ab66580d5fdaf5ULL, 0xc13e60d0d2e0ebbaULL },
+  { 0xcc963fee10b7d1b3ULL, 0x318df905079926a8ULL },
+  { 0xffbbcfe994e5c61fULL, 0xfdf17746497f7052ULL },
+  { 0x9fd561f1fd0f9bd3ULL, 0xfeb6ea8bedefa633ULL },
+  { 0xc7caba6e7c5382c8ULL, 0xfe64a52ee96b8fc0ULL },
+  { 0xf9bd690a1b68637bULL, 0x3dfdce7aa3c673b0ULL },
+  { 0x9c1661a651213e2dULL, 0x06bea10ca65c084eULL },
+  { 0xc31bfa0fe5698db8ULL, 0x486e494fcff30a62ULL },
+  { 0xf3e2f893dec3f126ULL, 0x5a89dba3c3efccfaULL },
+  { 0x986ddb5c6b3a76b7ULL, 0xf89629465a75e01cULL },
+  { 0xbe89523386091465ULL, 0xf6bbb397f1135823ULL },
+  { 0xee2ba6c0678b597fULL, 0x746aa07ded582e2cULL },
+  { 0x94db483840b717efULL, 0xa8c2a44eb4571cdcULL },
+  { 0xba121a4650e4ddebULL, 0x92f34d62616ce413ULL },
+  { 0xe896a0d7e51e1566ULL, 0x77b020baf9c81d17ULL },
+  { 0x915e2486ef32cd60ULL, 0x0ace1474dc1d122eULL },
+  { 0xb5b5ada8aaff80b8ULL, 0x0d819992132456baULL },
+  { 0xe3231912d5bf60e6ULL, 0x10e1fff697ed6c69ULL },
+  { 0x8df5efabc5979c8fULL, 0xca8d3ffa1ef463c1ULL },
+  { 0xb1736b96b6fd83b3ULL, 0xbd308ff8a6b17cb2ULL },
+  { 0xddd0467c64bce4a0ULL, 0xac7cb3f6d05ddbdeULL },
+  { 0x8aa22c0dbef60ee4ULL, 0x6bcdf07a423aa96bULL },
+  { 0xad4ab7112eb3929dULL, 0x86c16c98d2c953c6ULL },
+  { 0xd89d64d57a607744ULL, 0xe871c7bf077ba8b7ULL },
+  { 0x87625f056c7c4a8bULL, 0x11471cd764ad4972ULL },
+  { 0xa93af6c6c79b5d2dULL, 0xd598e40d3dd89bcfULL },
+  { 0xd389b47879823479ULL, 0x4aff1d108d4ec2c3ULL },
+  { 0x843610cb4bf160cbULL, 0xcedf722a585139baULL },
+  { 0xa54394fe1eedb8feULL, 0xc2974eb4ee658828ULL },
+  { 0xce947a3da6a9273eULL, 0x733d226229feea32ULL },
+  { 0x811ccc668829b887ULL, 0x0806357d5a3f525fULL },
+  { 0xa163ff802a3426a8ULL, 0xca07c2dcb0cf26f7ULL },
+  { 0xc9bcff6034c13052ULL, 0xfc89b393dd02f0b5ULL },
+  { 0xfc2c3f3841f17c67ULL, 0xbbac2078d443ace2ULL },
+  { 0x9d9ba7832936edc0ULL, 0xd54b944b84aa4c0dULL },
+  { 0xc5029163f384a931ULL, 0x0a9e795e65d4df11ULL },
+  { 0xf64335bcf065d37dULL, 0x4d4617b5ff4a16d5ULL },
+  { 0x99ea0196163fa42eULL, 0x504bced1bf8e4e45ULL },
+  { 0xc06481fb9bcf8d39ULL, 0xe45ec2862f71e1d6ULL },
+  { 0xf07da27a82c37088ULL, 0x5d767327bb4e5a4cULL },
+  { 0x964e858c91ba2655ULL, 0x3a6a07f8d510f86fULL },
+  { 0xbbe226efb628afeaULL, 0x890489f70a55368bULL },
+  { 0xeadab0aba3b2dbe5ULL, 0x2b45ac74ccea842eULL },
+  { 0x92c8ae6b464fc96fULL, 0x3b0b8bc90012929dULL },
+  { 0xb77ada0617e3bbcbULL, 0x09ce6ebb40173744ULL },
+  { 0xe55990879ddcaabdULL, 0xcc420a6a101d0515ULL },
+  { 0x8f57fa54c2a9eab6ULL, 0x9fa946824a12232dULL },
+  { 0xb32df8e9f3546564ULL, 0x47939822dc96abf9ULL },
+  { 0xdff9772470297ebdULL, 0x59787e2b93bc56f7ULL },
+  { 0x8bfbea76c619ef36ULL, 0x57eb4edb3c55b65aULL },
+  { 0xaefae51477a06b03ULL, 0xede622920b6b23f1ULL },
+  { 0xdab99e59958885c4ULL, 0xe95fab368e45ecedULL },
+  { 0x88b402f7fd75539bULL, 0x11dbcb0218ebb414ULL },
+  { 0xaae103b5fcd2a881ULL, 0xd652bdc29f26a119ULL },
+  { 0xd59944a37c0752a2ULL, 0x4be76d3346f0495fULL },
+  { 0x857fcae62d8493a5ULL, 0x6f70a4400c562ddbULL },
+  { 0xa6dfbd9fb8e5b88eULL, 0xcb4ccd500f6bb952ULL },
+  { 0xd097ad07a71f26b2ULL, 0x7e2000a41346a7a7ULL },
+  { 0x825ecc24c873782fULL, 0x8ed400668c0c28c8ULL },
+  { 0xa2f67f2dfa90563bULL, 0x728900802f0f32faULL },
+  { 0xcbb41ef979346bcaULL, 0x4f2b40a03ad2ffb9ULL },
+  { 0xfea126b7d78186bcULL, 0xe2f610c84987bfa8ULL },
+  { 0x9f24b832e6b0f436ULL, 0x0dd9ca7d2df4d7c9ULL },
+  { 0xc6ede63fa05d3143ULL, 0x91503d1c79720dbbULL },
+  { 0xf8a95fcf88747d94ULL, 0x75a44c6397ce912aULL },
+  { 0x9b69dbe1b548ce7cULL, 0xc986afbe3ee11abaULL },
+  { 0xc24452da229b021bULL, 0xfbe85badce996168ULL },
+  { 0xf2d56790ab41c2a2ULL, 0xfae27299423fb9c3ULL },
+  { 0x97c560ba6b0919a5ULL, 0xdccd879fc967d41aULL },
+  { 0xbdb6b8e905cb600fULL, 0x5400e987bbc1c920ULL },
+  { 0xed246723473e3813ULL, 0x290123e9aab23b68ULL },
+  { 0x9436c0760c86e30bULL, 0xf9a0b6720aaf6521ULL },
+  { 0xb94470938fa89bceULL, 0xf808e40e8d5b3e69ULL },
+  { 0xe7958cb87392c2c2ULL, 0xb60b1d1230b20e04ULL },
+  { 0x90bd77f3483bb9b9ULL, 0xb1c6f22b5e6f48c2ULL },
+  { 0xb4ecd5f01a4aa828ULL, 0x1e38aeb6360b1af3ULL },
+  { 0xe2280b6c20dd5232ULL, 0x25c6da63c38de1b0ULL },
+  { 0x8d590723948a535fULL, 0x579c487e5a38ad0eULL },
+  { 0xb0af48ec79ace837ULL, 0x2d835a9df0c6d851ULL },
+  { 0xdcdb1b2798182244ULL, 0xf8e431456cf88e65ULL },
+  { 0x8a08f0f8bf0f156bULL, 0x1b8e9ecb641b58ffULL },
+  { 0xac8b2d36eed2dac5ULL, 0xe272467e3d222f3fULL },
+  { 0xd7adf884aa879177ULL, 0x5b0ed81dcc6abb0fULL },
+  { 0x86ccbb52ea94baeaULL, 0x98e947129fc2b4e9ULL },
+  { 0xa87fea27a539e9a5ULL, 0x3f2398d747b36224ULL },
+  { 0xd29fe4b18e88640eULL, 0x8eec7f0d19a03aadULL },
+  { 0x83a3eeeef9153e89ULL, 0x1953cf68300424acULL },
+  { 0xa48ceaaab75a8e2bULL, 0x5fa8c3423c052dd7ULL },
+  { 0xcdb02555653131b6ULL, 0x3792f412cb06794dULL },
+  { 0x808e17555f3ebf11ULL, 0xe2bbd88bbee40bd0ULL },
+  { 0xa0b19d2ab70e6ed6ULL, 0x5b6aceaeae9d0ec4ULL },
+  { 0xc8de047564d20a8bULL, 0xf245825a5a445275ULL },
+  { 0xfb158592be068d2eULL, 0xeed6e2f0f0d56712ULL },
+  { 0x9ced737bb6c4183dULL, 0x55464dd69685606bULL },
+  { 0xc428d05aa4751e4cULL, 0xaa97e14c3c26b886ULL },
+  { 0xf53304714d9265dfULL, 0xd53dd99f4b3066a8ULL },
+  { 0x993fe2c6d07b7fabULL, 0xe546a8038efe4029ULL },
+  { 0xbf8fdb78849a5f96ULL, 0xde98520472bdd033ULL },
+  { 0xef73d256a5c0f77cULL, 0x963e66858f6d4440ULL },
+  { 0x95a8637627989aadULL, 0xdde7001379a44aa8ULL },
+  { 0xbb127c53b17ec159ULL, 0x5560c018580d5d52ULL },
+  { 0xe9d71b689dde71afULL, 0xaab8f01e6e10b4a6ULL },
+  { 0x9226712162ab070dULL, 0xcab3961304ca70e8ULL },
+  { 0xb6b00d69bb55c8d1ULL, 0x3d607b97c5fd0d22ULL },
+  { 0xe45c10c42a2b3b05ULL, 0x8cb89a7db77c506aULL },
+  { 0x8eb98a7a9a5b04e3ULL, 0x77f3608e92adb242ULL },
+  { 0xb267ed1940f1c61cULL, 0x55f038b237591ed3ULL },
+  { 0xdf01e85f912e37a3ULL, 0x6b6c46dec52f6688ULL },
+  { 0x8b61313bbabce2c6ULL, 0x2323ac4b3b3da015ULL },
+  { 0xae397d8aa96c1b77ULL, 0xabec975e0a0d081aULL },
+  { 0xd9c7dced53c72255ULL, 0x96e7bd358c904a21ULL },
+  { 0x881cea14545c7575ULL, 0x7e50d64177da2e54ULL },
+  { 0xaa242499697392d2ULL, 0xdde50bd1d5d0b9e9ULL },
+  { 0xd4ad2dbfc3d07787ULL, 0x955e4ec64b44e864ULL },
+  { 0x84ec3c97da624ab4ULL, 0xbd5af13bef0b113eULL },
+  { 0xa6274bbdd0fadd61ULL, 0xecb1ad8aeacdd58eULL },
+  { 0xcfb11ead453994baULL, 0x67de18eda5814af2ULL },
+  { 0x81ceb32c4b43fcf4ULL, 0x80eacf948770ced7ULL },
+  { 0xa2425ff75e14fc31ULL, 0xa1258379a94d028dULL },
+  { 0xcad2f7f5359a3b3eULL, 0x096ee45813a04330ULL },
+  { 0xfd87b5f28300ca0dULL, 0x8bca9d6e188853fcULL },
+  { 0x9e74d1b791e07e48ULL, 0x775ea264cf55347dULL },
+  { 0xc612062576589ddaULL, 0x95364afe032a819dULL },
+  { 0xf79687aed3eec551ULL, 0x3a83ddbd83f52204ULL },
+  { 0x9abe14cd44753b52ULL, 0xc4926a9672793542ULL },
+  { 0xc16d9a0095928a27ULL, 0x75b7053c0f178293ULL },
+  { 0xf1c90080baf72cb1ULL, 0x5324c68b12dd6338ULL },
+  { 0x971da05074da7beeULL, 0xd3f6fc16ebca5e03ULL },
+  { 0xbce5086492111aeaULL, 0x88f4bb1ca6bcf584ULL },
+  { 0xec1e4a7db69561a5ULL, 0x2b31e9e3d06c32e5ULL },
+  { 0x9392ee8e921d5d07ULL, 0x3aff322e62439fcfULL },
+  { 0xb877aa3236a4b449ULL, 0x09befeb9fad487c2ULL },
+  { 0xe69594bec44de15bULL, 0x4c2ebe687989a9b3ULL },
+  { 0x901d7cf73ab0acd9ULL, 0x0f9d37014bf60a10ULL },
+  { 0xb424dc35095cd80fULL, 0x538484c19ef38c94ULL },
+  { 0xe12e13424bb40e13ULL, 0x2865a5f206b06fb9ULL },
+  { 0x8cbccc096f5088cbULL, 0xf93f87b7442e45d3ULL },
+  { 0xafebff0bcb24aafeULL, 0xf78f69a51539d748ULL },
+  { 0xdbe6fecebdedd5beULL, 0xb573440e5a884d1bULL },
+  { 0x89705f4136b4a597ULL, 0x31680a88f8953030ULL },
+  { 0xabcc77118461cefcULL, 0xfdc20d2b36ba7c3dULL },
+  { 0xd6bf94d5e57a42bcULL, 0x3d32907604691b4cULL },
+  { 0x8637bd05af6c69b5ULL, 0xa63f9a49c2c1b10fULL },
+  { 0xa7c5ac471b478423ULL, 0x0fcf80dc33721d53ULL },
+  { 0xd1b71758e219652bULL, 0xd3c36113404ea4a8ULL },
+  { 0x83126e978d4fdf3bULL, 0x645a1cac083126e9ULL },
+  { 0xa3d70a3d70a3d70aULL, 0x3d70a3d70a3d70a3ULL },
+  { 0xccccccccccccccccULL, 0xccccccccccccccccULL },
+  { 0x8000000000000000ULL, 0x0000000000000000ULL },
+  { 0xa000000000000000ULL, 0x0000000000000000ULL },
+  { 0xc800000000000000ULL, 0x0000000000000000ULL },
+  { 0xfa00000000000000ULL, 0x0000000000000000ULL },
+  { 0x9c40000000000000ULL, 0x0000000000000000ULL },
+  { 0xc350000000000000ULL, 0x0000000000000000ULL },
+  { 0xf424000000000000ULL, 0x0000000000000000ULL },
+  { 0x9896800000000000ULL, 0x0000000000000000ULL },
+  { 0xbebc200000000000ULL, 0x0000000000000000ULL },
+  { 0xee6b280000000000ULL, 0x0000000000000000ULL },
+  { 0x9502f90000000000ULL, 0x0000000000000000ULL },
+  { 0xba43b74000000000ULL, 0x0000000000000000ULL },
+  { 0xe8d4a51000000000ULL, 0x0000000000000000ULL },
+  { 0x9184e72a00000000ULL, 0x0000000000000000ULL },
+  { 0xb5e620f480000000ULL, 0x0000000000000000ULL },
+  { 0xe35fa931a0000000ULL, 0x0000000000000000ULL },
+  { 0x8e1bc9bf04000000ULL, 0x0000000000000000ULL },
+  { 0xb1a2bc2ec5000000ULL, 0x0000000000000000ULL },
+  { 0xde0b6b3a76400000ULL, 0x0000000000000000ULL },
+  { 0x8ac7230489e80000ULL, 0x0000000000000000ULL },
+  { 0xad78ebc5ac620000ULL, 0x0000000000000000ULL },
+  { 0xd8d726b7177a8000ULL, 0x0000000000000000ULL },
+  { 0x878678326eac9000ULL, 0x0000000000000000ULL },
+  { 0xa968163f0a57b400ULL, 0x0000000000000000ULL },
+  { 0xd3c21bcecceda100ULL, 0x0000000000000000ULL },
+  { 0x84595161401484a0ULL, 0x0000000000000000ULL },
+  { 0xa56fa5b99019a5c8ULL, 0x0000000000000000ULL },
+  { 0xcecb8f27f4200f3aULL, 0x0000000000000000ULL },
+  { 0x813f3978f8940984ULL, 0x4000000000000000ULL },
+  { 0xa18f07d736b90be5ULL, 0x5000000000000000ULL },
+  { 0xc9f2c9cd04674edeULL, 0xa400000000000000ULL },
+  { 0xfc6f7c4045812296ULL, 0x4d00000000000000ULL },
+  { 0x9dc5ada82b70b59dULL, 0xf020000000000000ULL },
+  { 0xc5371912364ce305ULL, 0x6c28000000000000ULL },
+  { 0xf684df56c3e01bc6ULL, 0xc732000000000000ULL },
+  { 0x9a130b963a6c115cULL, 0x3c7f400000000000ULL },
+  { 0xc097ce7bc90715b3ULL, 0x4b9f100000000000ULL },
+  { 0xf0bdc21abb48db20ULL, 0x1e86d40000000000ULL },
+  { 0x96769950b50d88f4ULL, 0x1314448000000000ULL },
+  { 0xbc143fa4e250eb31ULL, 0x17d955a000000000ULL },
+  { 0xeb194f8e1ae525fdULL, 0x5dcfab0800000000ULL },
+  { 0x92efd1b8d0cf37beULL, 0x5aa1cae500000000ULL },
+  { 0xb7abc627050305adULL, 0xf14a3d9e40000000ULL },
+  { 0xe596b7b0c643c719ULL, 0x6d9ccd05d0000000ULL },
+  { 0x8f7e32ce7bea5c6fULL, 0xe4820023a2000000ULL },
+  { 0xb35dbf821ae4f38bULL, 0xdda2802c8a800000ULL },
+  { 0xe0352f62a19e306eULL, 0xd50b2037ad200000ULL },
+  { 0x8c213d9da502de45ULL, 0x4526f422cc340000ULL },
+  { 0xaf298d050e4395d6ULL, 0x9670b12b7f410000ULL },
+  { 0xdaf3f04651d47b4cULL, 0x3c0cdd765f114000ULL },
+  { 0x88d8762bf324cd0fULL, 0xa5880a69fb6ac800ULL },
+  { 0xab0e93b6efee0053ULL, 0x8eea0d047a457a00ULL },
+  { 0xd5d238a4abe98068ULL, 0x72a4904598d6d880ULL },
+  { 0x85a36366eb71f041ULL, 0x47a6da2b7f864750ULL },
+  { 0xa70c3c40a64e6c51ULL, 0x999090b65f67d924ULL },
+  { 0xd0cf4b50cfe20765ULL, 0xfff4b4e3f741cf6dULL },
+  { 0x82818f1281ed449fULL, 0xbff8f10e7a8921a4ULL },
+  { 0xa321f2d7226895c7ULL, 0xaff72d52192b6a0dULL },
+  { 0xcbea6f8ceb02bb39ULL, 0x9bf4f8a69f764490ULL },
+  { 0xfee50b7025c36a08ULL, 0x02f236d04753d5b4ULL },
+  { 0x9f4f2726179a2245ULL, 0x01d762422c946590ULL },
+  { 0xc722f0ef9d80aad6ULL, 0x424d3ad2b7b97ef5ULL },
+  { 0xf8ebad2b84e0d58bULL, 0xd2e0898765a7deb2ULL },
+  { 0x9b934c3b330c8577ULL, 0x63cc55f49f88eb2fULL },
+  { 0xc2781f49ffcfa6d5ULL, 0x3cbf6b71c76b25fbULL },
+  { 0xf316271c7fc3908aULL, 0x8bef464e3945ef7aULL },
+  { 0x97edd871cfda3a56ULL, 0x97758bf0e3cbb5acULL },
+  { 0xbde94e8e43d0c8ecULL, 0x3d52eeed1cbea317ULL },
+  { 0xed63a231d4c4fb27ULL, 0x4ca7aaa863ee4bddULL },
+  { 0x945e455f24fb1cf8ULL, 0x8fe8caa93e74ef6aULL },
+  { 0xb975d6b6ee39e436ULL, 0xb3e2fd538e122b44ULL },
+  { 0xe7d34c64a9c85d44ULL, 0x60dbbca87196b616ULL },
+  { 0x90e40fbeea1d3a4aULL, 0xbc8955e946fe31cdULL },
+  { 0xb51d13aea4a488ddULL, 0x6babab6398bdbe41ULL },
+  { 0xe264589a4dcdab14ULL, 0xc696963c7eed2dd1ULL },
+  { 0x8d7eb76070a08aecULL, 0xfc1e1de5cf543ca2ULL },
+  { 0xb0de65388cc8ada8ULL, 0x3b25a55f43294bcbULL },
+  { 0xdd15fe86affad912ULL, 0x49ef0eb713f39ebeULL },
+  { 0x8a2dbf142dfcc7abULL, 0x6e3569326c784337ULL },
+  { 0xacb92ed9397bf996ULL, 0x49c2c37f07965404ULL },
+  { 0xd7e77a8f87daf7fbULL, 0xdc33745ec97be906ULL },
+  { 0x86f0ac99b4e8dafdULL, 0x69a028bb3ded71a3ULL },
+  { 0xa8acd7c0222311bcULL, 0xc40832ea0d68ce0cULL },
+  { 0xd2d80db02aabd62bULL, 0xf50a3fa490c30190ULL },
+  { 0x83c7088e1aab65dbULL, 0x792667c6da79e0faULL },
+  { 0xa4b8cab1a1563f52ULL, 0x577001b891185938ULL },
+  { 0xcde6fd5e09abcf26ULL, 0xed4c0226b55e6f86ULL },
+  { 0x80b05e5ac60b6178ULL, 0x544f8158315b05b4ULL },
+  { 0xa0dc75f1778e39d6ULL, 0x696361ae3db1c721ULL },
+  { 0xc913936dd571c84cULL, 0x03bc3a19cd1e38e9ULL },
+  { 0xfb5878494ace3a5fULL, 0x04ab48a04065c723ULL },
+  { 0x9d174b2dcec0e47bULL, 0x62eb0d64283f9c76ULL },
+  { 0xc45d1df942711d9aULL, 0x3ba5d0bd324f8394ULL },
+  { 0xf5746577930d6500ULL, 0xca8f44ec7ee36479ULL },
+  { 0x9968bf6abbe85f20ULL, 0x7e998b13cf4e1ecbULL },
+  { 0xbfc2ef456ae276e8ULL, 0x9e3fedd8c321a67eULL },
+  { 0xefb3ab16c59b14a2ULL, 0xc5cfe94ef3ea101eULL },
+  { 0x95d04aee3b80ece5ULL, 0xbba1f1d158724a12ULL },
+  { 0xbb445da9ca61281fULL, 0x2a8a6e45ae8edc97ULL },
+  { 0xea1575143cf97226ULL, 0xf52d09d71a3293bdULL },
+  { 0x924d692ca61be758ULL, 0x593c2626705f9c56ULL },
+  { 0xb6e0c377cfa2e12eULL, 0x6f8b2fb00c77836cULL },
+  { 0xe498f455c38b997aULL, 0x0b6dfb9c0f956447ULL },
+  { 0x8edf98b59a373fecULL, 0x4724bd4189bd5eacULL },
+  { 0xb2977ee300c50fe7ULL, 0x58edec91ec2cb657ULL },
+  { 0xdf3d5e9bc0f653e1ULL, 0x2f2967b66737e3edULL },
+  { 0x8b865b215899f46cULL, 0xbd79e0d20082ee74ULL },
+  { 0xae67f1e9aec07187ULL, 0xecd8590680a3aa11ULL },
+  { 0xda01ee641a708de9ULL, 0xe80e6f4820cc9495ULL },
+  { 0x884134fe908658b2ULL, 0x3109058d147fdcddULL },
+  { 0xaa51823e34a7eedeULL, 0xbd4b46f0599fd415ULL },
+  { 0xd4e5e2cdc1d1ea96ULL, 0x6c9e18ac7007c91aULL },
+  { 0x850fadc09923329eULL, 0x03e2cf6bc604ddb0ULL },
+  { 0xa6539930bf6bff45ULL, 0x84db8346b786151cULL },
+  { 0xcfe87f7cef46ff16ULL, 0xe612641865679a63ULL },
+  { 0x81f14fae158c5f6eULL, 0x4fcb7e8f3f60c07eULL },
+  { 0xa26da3999aef7749ULL, 0xe3be5e330f38f09dULL },
+  { 0xcb090c8001ab551cULL, 0x5cadf5bfd3072cc5ULL },
+  { 0xfdcb4fa002162a63ULL, 0x73d9732fc7c8f7f6ULL },
+  { 0x9e9f11c4014dda7eULL, 0x2867e7fddcdd9afaULL },
+  { 0xc646d63501a1511dULL, 0xb281e1fd541501b8ULL },
+  { 0xf7d88bc24209a565ULL, 0x1f225a7ca91a4226ULL },
+  { 0x9ae757596946075fULL, 0x3375788de9b06958ULL },
+  { 0xc1a12d2fc3978937ULL, 0x0052d6b1641c83aeULL },
+  { 0xf209787bb47d6b84ULL, 0xc0678c5dbd23a49aULL },
+  { 0x9745eb4d50ce6332ULL, 0xf840b7ba963646e0ULL },
+  { 0xbd176620a501fbffULL, 0xb650e5a93bc3d898ULL },
+  { 0xec5d3fa8ce427affULL, 0xa3e51f138ab4cebeULL },
+  { 0x93ba47c980e98cdfULL, 0xc66f336c36b10137ULL },
+  { 0xb8a8d9bbe123f017ULL, 0xb80b0047445d4184ULL },
+  { 0xe6d3102ad96cec1dULL, 0xa60dc059157491e5ULL },
+  { 0x9043ea1ac7e41392ULL, 0x87c89837ad68db2fULL },
+  { 0xb454e4a179dd1877ULL, 0x29babe4598c311fbULL },
+  { 0xe16a1dc9d8545e94ULL, 0xf4296dd6fef3d67aULL },
+  { 0x8ce2529e2734bb1dULL, 0x1899e4a65f58660cULL },
+  { 0xb01ae745b101e9e4ULL, 0x5ec05dcff72e7f8fULL },
+  { 0xdc21a1171d42645dULL, 0x76707543f4fa1f73ULL },
+  { 0x899504ae72497ebaULL, 0x6a06494a791c53a8ULL },
+  { 0xabfa45da0edbde69ULL, 0x0487db9d17636892ULL },
+  { 0xd6f8d7509292d603ULL, 0x45a9d2845d3c42b6ULL },
+  { 0x865b86925b9bc5c2ULL, 0x0b8a2392ba45a9b2ULL },
+  { 0xa7f26836f282b732ULL, 0x8e6cac7768d7141eULL },
+  { 0xd1ef0244af2364ffULL, 0x3207d795430cd926ULL },
+  { 0x8335616aed761f1fULL, 0x7f44e6bd49e807b8ULL },
+  { 0xa402b9c5a8d3a6e7ULL, 0x5f16206c9c6209a6ULL },
+  { 0xcd036837130890a1ULL, 0x36dba887c37a8c0fULL },
+  { 0x802221226be55a64ULL, 0xc2494954da2c9789ULL },
+  { 0xa02aa96b06deb0fdULL, 0xf2db9baa10b7bd6cULL },
+  { 0xc83553c5c8965d3dULL, 0x6f92829494e5acc7ULL },
+  { 0xfa42a8b73abbf48cULL, 0xcb772339ba1f17f9ULL },
+  { 0x9c69a97284b578d7ULL, 0xff2a760414536efbULL },
+  { 0xc38413cf25e2d70dULL, 0xfef5138519684abaULL },
+  { 0xf46518c2ef5b8cd1ULL, 0x7eb258665fc25d69ULL },
+  { 0x98bf2f79d5993802ULL, 0xef2f773ffbd97a61ULL },
+  { 0xbeeefb584aff8603ULL, 0xaafb550ffacfd8faULL },
+  { 0xeeaaba2e5dbf6784ULL, 0x95ba2a53f983cf38ULL },
+  { 0x952ab45cfa97a0b2ULL, 0xdd945a747bf26183ULL },
+  { 0xba756174393d88dfULL, 0x94f971119aeef9e4ULL },
+  { 0xe912b9d1478ceb17ULL, 0x7a37cd5601aab85dULL },
+  { 0x91abb422ccb812eeULL, 0xac62e055c10ab33aULL },
+  { 0xb616a12b7fe617aaULL, 0x577b986b314d6009ULL },
+  { 0xe39c49765fdf9d94ULL, 0xed5a7e85fda0b80bULL },
+  { 0x8e41ade9fbebc27dULL, 0x14588f13be847307ULL },
+  { 0xb1d219647ae6b31cULL, 0x596eb2d8ae258fc8ULL },
+  { 0xde469fbd99a05fe3ULL, 0x6fca5f8ed9aef3bbULL },
+  { 0x8aec23d680043beeULL, 0x25de7bb9480d5854ULL },
+  { 0xada72ccc20054ae9ULL, 0xaf561aa79a10ae6aULL },
+  { 0xd910f7ff28069da4ULL, 0x1b2ba1518094da04ULL },
+  { 0x87aa9aff79042286ULL, 0x90fb44d2f05d0842ULL },
+  { 0xa99541bf57452b28ULL, 0x353a1607ac744a53ULL },
+  { 0xd3fa922f2d1675f2ULL, 0x42889b8997915ce8ULL },
+  { 0x847c9b5d7c2e09b7ULL, 0x69956135febada11ULL },
+  { 0xa59bc234db398c25ULL, 0x43fab9837e699095ULL },
+  { 0xcf02b2c21207ef2eULL, 0x94f967e45e03f4bbULL },
+  { 0x8161afb94b44f57dULL, 0x1d1be0eebac278f5ULL },
+  { 0xa1ba1ba79e1632dcULL, 0x6462d92a69731732ULL },
+  { 0xca28a291859bbf93ULL, 0x7d7b8f7503cfdcfeULL },
+  { 0xfcb2cb35e702af78ULL, 0x5cda735244c3d43eULL },
+  { 0x9defbf01b061adabULL, 0x3a0888136afa64a7ULL },
+  { 0xc56baec21c7a1916ULL, 0x088aaa1845b8fdd0ULL },
+  { 0xf6c69a72a3989f5bULL, 0x8aad549e57273d45ULL },
+  { 0x9a3c2087a63f6399ULL, 0x36ac54e2f678864bULL },
+  { 0xc0cb28a98fcf3c7fULL, 0x84576a1bb416a7ddULL },
+  { 0xf0fdf2d3f3c30b9fULL, 0x656d44a2a11c51d5ULL },
+  { 0x969eb7c47859e743ULL, 0x9f644ae5a4b1b325ULL },
+  { 0xbc4665b596706114ULL, 0x873d5d9f0dde1feeULL },
+  { 0xeb57ff22fc0c7959ULL, 0xa90cb506d155a7eaULL },
+  { 0x9316ff75dd87cbd8ULL, 0x09a7f12442d588f2ULL },
+  { 0xb7dcbf5354e9beceULL, 0x0c11ed6d538aeb2fULL },
+  { 0xe5d3ef282a242e81ULL, 0x8f1668c8a86da5faULL },
+  { 0x8fa475791a569d10ULL, 0xf96e017d694487bcULL },
+  { 0xb38d92d760ec4455ULL, 0x37c981dcc395a9acULL },
+  { 0xe070f78d3927556aULL, 0x85bbe253f47b1417ULL },
+  { 0x8c469ab843b89562ULL, 0x93956d7478ccec8eULL },
+  { 0xaf58416654a6babbULL, 0x387ac8d1970027b2ULL },
+  { 0xdb2e51bfe9d0696aULL, 0x06997b05fcc0319eULL },
+  { 0x88fcf317f22241e2ULL, 0x441fece3bdf81f03ULL },
+  { 0xab3c2fddeeaad25aULL, 0xd527e81cad7626c3ULL },
+  { 0xd60b3bd56a5586f1ULL, 0x8a71e223d8d3b074ULL },
+  { 0x85c7056562757456ULL, 0xf6872d5667844e49ULL },
+  { 0xa738c6bebb12d16cULL, 0xb428f8ac016561dbULL },
+  { 0xd106f86e69d785c7ULL, 0xe13336d701beba52ULL },
+  { 0x82a45b450226b39cULL, 0xecc0024661173473ULL },
+  { 0xa34d721642b06084ULL, 0x27f002d7f95d0190ULL },
+  { 0xcc20ce9bd35c78a5ULL, 0x31ec038df7b441f4ULL },
+  { 0xff290242c83396ceULL, 0x7e67047175a15271ULL },
+  { 0x9f79a169bd203e41ULL, 0x0f0062c6e984d386ULL },
+  { 0xc75809c42c684dd1ULL, 0x52c07b78a3e60868ULL },
+  { 0xf92e0c3537826145ULL, 0xa7709a56ccdf8a82ULL },
+  { 0x9bbcc7a142b17ccbULL, 0x88a66076400bb691ULL },
+  { 0xc2abf989935ddbfeULL, 0x6acff893d00ea435ULL },
+  { 0xf356f7ebf83552feULL, 0x0583f6b8c4124d43ULL },
+  { 0x98165af37b2153deULL, 0xc3727a337a8b704aULL },
+  { 0xbe1bf1b059e9a8d6ULL, 0x744f18c0592e4c5cULL },
+  { 0xeda2ee1c7064130cULL, 0x1162def06f79df73ULL },
+  { 0x9485d4d1c63e8be7ULL, 0x8addcb5645ac2ba8ULL },
+  { 0xb9a74a0637ce2ee1ULL, 0x6d953e2bd7173692ULL },
+  { 0xe8111c87c5c1ba99ULL, 0xc8fa8db6ccdd0437ULL },
+  { 0x910ab1d4db9914a0ULL, 0x1d9c9892400a22a2ULL },
+  { 0xb54d5e4a127f59c8ULL, 0x2503beb6d00cab4bULL },
+  { 0xe2a0b5dc971f303aULL, 0x2e44ae64840fd61dULL },
+  { 0x8da471a9de737e24ULL, 0x5ceaecfed289e5d2ULL },
+  { 0xb10d8e1456105dadULL, 0x7425a83e872c5f47ULL },
+  { 0xdd50f1996b947518ULL, 0xd12f124e28f77719ULL },
+  { 0x8a5296ffe33cc92fULL, 0x82bd6b70d99aaa6fULL },
+  { 0xace73cbfdc0bfb7bULL, 0x636cc64d1001550bULL },
+  { 0xd8210befd30efa5aULL, 0x3c47f7e05401aa4eULL },
+  { 0x8714a775e3e95c78ULL, 0x65acfaec34810a71ULL },
+  { 0xa8d9d1535ce3b396ULL, 0x7f1839a741a14d0dULL },
+  { 0xd31045a8341ca07cULL, 0x1ede48111209a050ULL },
+  { 0x83ea2b892091e44dULL, 0x934aed0aab460432ULL },
+  { 0xa4e4b66b68b65d60ULL, 0xf81da84d5617853fULL },
+  { 0xce1de40642e3f4b9ULL, 0x36251260ab9d668eULL },
+  { 0x80d2ae83e9ce78f3ULL, 0xc1d72b7c6b426019ULL },
+  { 0xa1075a24e4421730ULL, 0xb24cf65b8612f81fULL },
+  { 0xc94930ae1d529cfcULL, 0xdee033f26797b627ULL },
+  { 0xfb9b7cd9a4a7443cULL, 0x169840ef017da3b1ULL },
+  { 0x9d412e0806e88aa5ULL, 0x8e1f289560ee864eULL },
+  { 0xc491798a08a2ad4eULL, 0xf1a6f2bab92a27e2ULL },
+  { 0xf5b5d7ec8acb58a2ULL, 0xae10af696774b1dbULL },
+  { 0x9991a6f3d6bf1765ULL, 0xacca6da1e0a8ef29ULL },
+  { 0xbff610b0cc6edd3fULL, 0x17fd090a58d32af3ULL },
+  { 0xeff394dcff8a948eULL, 0xddfc4b4cef07f5b0ULL },
+  { 0x95f83d0a1fb69cd9ULL, 0x4abdaf101564f98eULL },
+  { 0xbb764c4ca7a4440fULL, 0x9d6d1ad41abe37f1ULL },
+  { 0xea53df5fd18d5513ULL, 0x84c86189216dc5edULL },
+  { 0x92746b9be2f8552cULL, 0x32fd3cf5b4e49bb4ULL },
+  { 0xb7118682dbb66a77ULL, 0x3fbc8c33221dc2a1ULL },
+  { 0xe4d5e82392a40515ULL, 0x0fabaf3feaa5334aULL },
+  { 0x8f05b1163ba6832dULL, 0x29cb4d87f2a7400eULL },
+  { 0xb2c71d5bca9023f8ULL, 0x743e20e9ef511012ULL },
+  { 0xdf78e4b2bd342cf6ULL, 0x914da9246b255416ULL },
+  { 0x8bab8eefb6409c1aULL, 0x1ad089b6c2f7548eULL },
+  { 0xae9672aba3d0c320ULL, 0xa184ac2473b529b1ULL },
+  { 0xda3c0f568cc4f3e8ULL, 0xc9e5d72d90a2741eULL },
+  { 0x8865899617fb1871ULL, 0x7e2fa67c7a658892ULL },
+  { 0xaa7eebfb9df9de8dULL, 0xddbb901b98feeab7ULL },
+  { 0xd51ea6fa85785631ULL, 0x552a74227f3ea565ULL },
+  { 0x8533285c936b35deULL, 0xd53a88958f87275fULL },
+  { 0xa67ff273b8460356ULL, 0x8a892abaf368f137ULL },
+  { 0xd01fef10a657842cULL, 0x2d2b7569b0432d85ULL },
+  { 0x8213f56a67f6b29bULL, 0x9c3b29620e29fc73ULL },
+  { 0xa298f2c501f45f42ULL, 0x8349f3ba91b47b8fULL },
+  { 0xcb3f2f7642717713ULL, 0x241c70a936219a73ULL },
+  { 0xfe0efb53d30dd4d7ULL, 0xed238cd383aa0110ULL },
+  { 0x9ec95d1463e8a506ULL, 0xf4363804324a40aaULL },
+  { 0xc67bb4597ce2ce48ULL, 0xb143c6053edcd0d5ULL },
+  { 0xf81aa16fdc1b81daULL, 0xdd94b7868e94050aULL },
+  { 0x9b10a4e5e9913128ULL, 0xca7cf2b4191c8326ULL },
+  { 0xc1d4ce1f63f57d72ULL, 0xfd1c2f611f63a3f0ULL },
+  { 0xf24a01a73cf2dccfULL, 0xbc633b39673c8cecULL },
+  { 0x976e41088617ca01ULL, 0xd5be0503e085d813ULL },
+  { 0xbd49d14aa79dbc82ULL, 0x4b2d8644d8a74e18ULL },
+  { 0xec9c459d51852ba2ULL, 0xddf8e7d60ed1219eULL },
+  { 0x93e1ab8252f33b45ULL, 0xcabb90e5c942b503ULL },
+  { 0xb8da1662e7b00a17ULL, 0x3d6a751f3b936243ULL },
+  { 0xe7109bfba19c0c9dULL, 0x0cc512670a783ad4ULL },
+  { 0x906a617d450187e2ULL, 0x27fb2b80668b24c5ULL },
+  { 0xb484f9dc9641e9daULL, 0xb1f9f660802dedf6ULL },
+  { 0xe1a63853bbd26451ULL, 0x5e7873f8a0396973ULL },
+  { 0x8d07e33455637eb2ULL, 0xdb0b487b6423e1e8ULL },
+  { 0xb049dc016abc5e5fULL, 0x91ce1a9a3d2cda62ULL },
+  { 0xdc5c5301c56b75f7ULL, 0x7641a140cc7810fbULL },
+  { 0x89b9b3e11b6329baULL, 0xa9e904c87fcb0a9dULL },
+  { 0xac2820d9623bf429ULL, 0x546345fa9fbdcd44ULL },
+  { 0xd732290fbacaf133ULL, 0xa97c177947ad4095ULL },
+  { 0x867f59a9d4bed6c0ULL, 0x49ed8eabcccc485dULL },
+  { 0xa81f301449ee8c70ULL, 0x5c68f256bfff5a74ULL },
+  { 0xd226fc195c6a2f8cULL, 0x73832eec6fff3111ULL },
+  { 0x83585d8fd9c25db7ULL, 0xc831fd53c5ff7eabULL },
+  { 0xa42e74f3d032f525ULL, 0xba3e7ca8b77f5e55ULL },
+  { 0xcd3a1230c43fb26fULL, 0x28ce1bd2e55f35ebULL },
+  { 0x80444b5e7aa7cf85ULL, 0x7980d163cf5b81b3ULL },
+  { 0xa0555e361951c366ULL, 0xd7e105bcc332621fULL },
+  { 0xc86ab5c39fa63440ULL, 0x8dd9472bf3fefaa7ULL },
+  { 0xfa856334878fc150ULL, 0xb14f98f6f0feb951ULL },
+  { 0x9c935e00d4b9d8d2ULL, 0x6ed1bf9a569f33d3ULL },
+  { 0xc3b8358109e84f07ULL, 0x0a862f80ec4700c8ULL },
+  { 0xf4a642e14c6262c8ULL, 0xcd27bb612758c0faULL },
+  { 0x98e7e9cccfbd7dbdULL, 0x8038d51cb897789cULL },
+  { 0xbf21e44003acdd2cULL, 0xe0470a63e6bd56c3ULL },
+  { 0xeeea5d5004981478ULL, 0x1858ccfce06cac74ULL },
+  { 0x95527a5202df0ccbULL, 0x0f37801e0c43ebc8ULL },
+  { 0xbaa718e68396cffdULL, 0xd30560258f54e6baULL },
+  { 0xe950df20247c83fdULL, 0x47c6b82ef32a2069ULL },
+  { 0x91d28b7416cdd27eULL, 0x4cdc331d57fa5441ULL },
+  { 0xb6472e511c81471dULL, 0xe0133fe4adf8e952ULL },
+  { 0xe3d8f9e563a198e5ULL, 0x58180fddd97723a6ULL },
+  { 0x8e679c2f5e44ff8fULL, 0x570f09eaa7ea7648ULL }
+};
+
+static const double g_exactPow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+/*
+Full 64x64 to 128-bit multiplication, returns the high word */
+static FASTCALL_ATTR INLINE_PREFIX JSUINT64 FASTCALL_MSVC Mul64(JSUINT64 a, JSUINT64 b, JSUINT64 *plo)
+{
+#if defined(__SIZEOF_INT128__)
+  unsigned __int128 product = (unsigned __int128) a * b;
+  *plo = (JSUINT64) product;
+  return (JSUINT64) (product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+  JSUINT64 hi;
+  *plo = _umul128(a, b, &hi);
+  return hi;
+#else
+  JSUINT64 aLo = (JSUINT32) a, aHi = a >> 32;
+  JSUINT64 bLo = (JSUINT32) b, bHi = b >> 32;
+  JSUINT64 lolo = aLo * bLo;
+  JSUINT64 hilo = aHi * bLo;
+  JSUINT64 lohi = aLo * bHi;
+  JSUINT64 cross = (lolo >> 32) + (JSUINT32) hilo + lohi;
+  *plo = (cross << 32) | (JSUINT32) lolo;
+  return aHi * bHi + (hilo >> 32) + (cross >> 32);
+#endif
+}
+
+static FASTCALL_ATTR INLINE_PREFIX int FASTCALL_MSVC CountLeadingZeros64(JSUINT64 value)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+  unsigned long index;
+  _BitScanReverse64(&index, value);
+  return 63 - (int) index;
+#elif defined(_MSC_VER)
+  unsigned long index;
+  if (value >> 32)
+  {
+    _BitScanReverse(&index, (unsigned long) (value >> 32));
+    return 31 - (int) index;
+  }
+  _BitScanReverse(&index, (unsigned long) value);
+  return 63 - (int) index;
+#else
+  return __builtin_clzll(value);
+#endif
+}
+
+/*
+Eisel-Lemire: mantissa * 10^exp10 rounded to the nearest double, from the product of the normalized mantissa
+with the 128-bit power of ten. Returns FALSE if 128 bits can't settle the rounding or the result would be
+subnormal or infinite, the caller then falls back to strtod. mantissa must not be 0 */
+static int EiselLemire(JSUINT64 mantissa, int exp10, int neg, double *pvalue)
+{
+  const JSUINT64 *pow10;
+  JSUINT64 xHi, xLo, yHi, yLo;
+  JSUINT64 mergedHi, mergedLo;
+  JSUINT64 retMantissa;
+  JSUINT64 retExp2;
+  JSUINT64 bits;
+  JSUINT64 msb;
+  int clz;
+
+  if (exp10 < POW10_MIN_EXPONENT || exp10 > POW10_MAX_EXPONENT)
+  {
+    return FALSE;
+  }
+
+  pow10 = g_pow10Mantissa[exp10 - POW10_MIN_EXPONENT];
+
+  clz = CountLeadingZeros64(mantissa);
+  mantissa <<= clz;
+
+  // 217706 / 2^16 approximates log2(10), 1023 is the exponent bias
+  retExp2 = (JSUINT64) (((217706 * exp10) >> 16) + 64 + 1023) - (JSUINT64) clz;
+
+  xHi = Mul64(mantissa, pow10[0], &xLo);
+
+  // The low bits may be off by the truncated part of the power, widen the product if that matters
+  if ((xHi & 0x1ff) == 0x1ff && xLo + mantissa < mantissa)
+  {
+    yHi = Mul64(mantissa, pow10[1], &yLo);
+    mergedHi = xHi;
+    mergedLo = xLo + yHi;
+    if (mergedLo < xLo)
+    {
+      mergedHi ++;
+    }
+
+    if ((mergedHi & 0x1ff) == 0x1ff && mergedLo + 1 == 0 && yLo + mantissa < mantissa)
+    {
+      return FALSE;
+    }
+
+    xHi = mergedHi;
+    xLo = mergedLo;
+  }
+
+  // Shift to 54 bits, one more than needed for rounding
+  msb = xHi >> 63;
+  retMantissa = xHi >> (msb + 9);
+  retExp2 -= 1 ^ msb;
+
+  // Exactly half way between two doubles, round to even can't be decided here
+  if (xLo == 0 && (xHi & 0x1ff) == 0 && (retMantissa & 3) == 1)
+  {
+    return FALSE;
+  }
+
+  retMantissa += retMantissa & 1;
+  retMantissa >>= 1;
+  if (retMantissa >> 53)
+  {
+    retMantissa >>= 1;
+    retExp2 ++;
+  }
+
+  // Zero (wrapped around) is subnormal, 0x7ff and above is infinite
+  if (retExp2 - 1 >= 0x7ff - 1)
+  {
+    return FALSE;
+  }
+
+  bits = (retExp2 << 52) | (retMantissa & 0x000fffffffffffffULL) | ((JSUINT64) neg << 63);
+  memcpy(pvalue, &bits, sizeof(bits));
+  return TRUE;
+}
+
+static JSOBJ decodePreciseFloatStrtod(struct DecoderState *ds)
 {
   char *end;
   double value;
@@ -95,8 +1027,192 @@ FASTCALL_ATTR JSOBJ FASTCALL_MSVC decodePreciseFloat(struct DecoderState *ds)
     return SetError(ds, -1, "Range error when decoding numeric as double");
   }
 
+  ds->lastType = JT_DOUBLE;
   ds->start = end;
-  return ds->dec->newDouble(ds->prv, value);
+  return NewDouble(ds, value);
+}
+
+/*
+Correctly rounded decoding of a number with a fraction or exponent. The first 19 significant digits are kept
+as an integer mantissa and the rest only move the decimal exponent. Small exact cases are a single floating
+point operation (Clinger), the others go through EiselLemire, which is checked with the mantissa rounded both
+ways when digits were dropped. strtod is left for the cases those can't decide, and for underflow and
+overflow so the range error is raised like before */
+FASTCALL_ATTR JSOBJ FASTCALL_MSVC decodePreciseFloat(struct DecoderState *ds)
+{
+  char *offset = ds->start;
+  JSUINT64 mantissa = 0;
+  int digits = 0;
+  int exp10 = 0;
+  int expValue = 0;
+  int expNeg = 0;
+  int neg = 0;
+  int truncated = 0;
+  int sawDigits = 0;
+  char *expStart;
+  double value;
+  double upper;
+#ifdef JSON_DECODE_SWAR
+  static const JSUINT32 g_pow10int[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+  JSUINT32 chunk;
+  int count;
+#endif
+
+  if (*offset == '-')
+  {
+    neg = 1;
+    offset ++;
+  }
+
+  for (;;)
+  {
+#ifdef JSON_DECODE_SWAR
+    if (digits <= 11 && (mantissa != 0 || *offset != '0') && ds->end - offset >= 8)
+    {
+      count = ParseDigits8(offset, &chunk);
+      mantissa = mantissa * g_pow10int[count] + chunk;
+      digits += count;
+      offset += count;
+      sawDigits |= count;
+      if (count == 8)
+      {
+        continue;
+      }
+    }
+#endif
+    if (*offset < '0' || *offset > '9')
+    {
+      break;
+    }
+
+    sawDigits = 1;
+    if (mantissa == 0 && *offset == '0')
+    {
+      // Leading zeros aren't significant
+    }
+    else
+    if (digits < 19)
+    {
+      mantissa = mantissa * 10 + (JSUINT64) (*offset - '0');
+      digits ++;
+    }
+    else
+    {
+      truncated |= *offset != '0';
+      exp10 ++;
+    }
+    offset ++;
+  }
+
+  if (*offset == '.')
+  {
+    offset ++;
+
+    for (;;)
+    {
+#ifdef JSON_DECODE_SWAR
+      if (digits <= 11 && (mantissa != 0 || *offset != '0') && ds->end - offset >= 8)
+      {
+        count = ParseDigits8(offset, &chunk);
+        mantissa = mantissa * g_pow10int[count] + chunk;
+        digits += count;
+        exp10 -= count;
+        offset += count;
+        sawDigits |= count;
+        if (count == 8)
+        {
+          continue;
+        }
+      }
+#endif
+      if (*offset < '0' || *offset > '9')
+      {
+        break;
+      }
+
+      sawDigits = 1;
+      if (mantissa == 0 && *offset == '0')
+      {
+        exp10 --;
+      }
+      else
+      if (digits < 19)
+      {
+        mantissa = mantissa * 10 + (JSUINT64) (*offset - '0');
+        digits ++;
+        exp10 --;
+      }
+      else
+      {
+        truncated |= *offset != '0';
+      }
+      offset ++;
+    }
+  }
+
+  if (!sawDigits)
+  {
+    return decodePreciseFloatStrtod(ds);
+  }
+
+  // Like strtod an 'e' without digits after it isn't part of the number
+  if (*offset == 'e' || *offset == 'E')
+  {
+    expStart = offset;
+    offset ++;
+
+    if (*offset == '-' || *offset == '+')
+    {
+      expNeg = *offset == '-';
+      offset ++;
+    }
+
+    if (*offset < '0' || *offset > '9')
+    {
+      offset = expStart;
+    }
+
+    while (*offset >= '0' && *offset <= '9')
+    {
+      // Past this the result is 0 or infinite anyway
+      if (expValue < 100000)
+      {
+        expValue = expValue * 10 + (*offset - '0');
+      }
+      offset ++;
+    }
+
+    exp10 += expNeg ? -expValue : expValue;
+  }
+
+  if (mantissa == 0)
+  {
+    value = neg ? -0.0 : 0.0;
+  }
+  else
+#if !defined(FLT_EVAL_METHOD) || FLT_EVAL_METHOD == 0
+  if (!truncated && mantissa <= (1ULL << 53) && exp10 >= -22 && exp10 <= 22)
+  {
+    // Both operands are exact so the single rounding is the correct one
+    value = (double) mantissa;
+    value = exp10 < 0 ? value / g_exactPow10[-exp10] : value * g_exactPow10[exp10];
+    value = neg ? -value : value;
+  }
+  else
+#endif
+  if (!EiselLemire(mantissa, exp10, neg, &value))
+  {
+    return decodePreciseFloatStrtod(ds);
+  }
+  else
+  if (truncated && (!EiselLemire(mantissa + 1, exp10, neg, &upper) || upper != value))
+  {
+    return decodePreciseFloatStrtod(ds);
+  }
+
+  ds->lastType = JT_DOUBLE;
+  ds->start = offset;
+  return NewDouble(ds, value);
 }
 
 FASTCALL_ATTR JSOBJ FASTCALL_MSVC decode_numeric (struct DecoderState *ds)
@@ -111,6 +1227,12 @@ FASTCALL_ATTR JSOBJ FASTCALL_MSVC decode_numeric (struct DecoderState *ds)
   double expNeg;
   double expValue;
   char *offset = ds->start;
+#ifdef JSON_DECODE_SWAR
+  static const JSUINT32 g_pow10int[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+  JSUINT64 frcDigits;
+  JSUINT32 chunk;
+  int count;
+#endif
 
   JSUINT64 overflowLimit = LLONG_MAX;
 
@@ -124,6 +1246,22 @@ FASTCALL_ATTR JSOBJ FASTCALL_MSVC decode_numeric (struct DecoderState *ds)
   // Scan integer part
   intValue = 0;
 
+#ifdef JSON_DECODE_SWAR
+  // Up to 16 digits can't overflow, the scalar loop below checks the rest
+  while (mantSize <= 8 && ds->end - offset >= 8)
+  {
+    count = ParseDigits8(offset, &chunk);
+    intValue = intValue * g_pow10int[count] + chunk;
+    offset += count;
+    mantSize += count;
+
+    if (count < 8)
+    {
+      break;
+    }
+  }
+#endif
+
   while (1)
   {
     chr = (int) (unsigned char) *(offset);
@@ -187,15 +1325,15 @@ BREAK_INT_LOOP:
 
   if (intNeg == 1 && (intValue & 0x8000000000000000ULL) != 0)
   {
-    return ds->dec->newUnsignedLong(ds->prv, intValue);
+    return NewUnsignedLong(ds, intValue);
   }
   else if ((intValue >> 31))
   {
-    return ds->dec->newLong(ds->prv, (JSINT64) (intValue * (JSINT64) intNeg));
+    return NewLong(ds, (JSINT64) (intValue * (JSINT64) intNeg));
   }
   else
   {
-    return ds->dec->newInt(ds->prv, (JSINT32) (intValue * intNeg));
+    return NewInt(ds, (JSINT32) (intValue * intNeg));
   }
 
 DECODE_FRACTION:
@@ -207,6 +1345,31 @@ DECODE_FRACTION:
 
   // Scan fraction part
   frcValue = 0.0;
+
+#ifdef JSON_DECODE_SWAR
+  // The digits are collected as an integer, which is exact below 2^53 so the result matches the loop below
+  frcDigits = 0;
+  while (ds->end - offset >= 8)
+  {
+    count = ParseDigits8(offset, &chunk);
+
+    if (decimalCount + count > JSON_DOUBLE_MAX_DECIMALS)
+    {
+      break;
+    }
+
+    frcDigits = frcDigits * g_pow10int[count] + chunk;
+    offset += count;
+    decimalCount += count;
+
+    if (count < 8)
+    {
+      break;
+    }
+  }
+  frcValue = (double) frcDigits;
+#endif
+
   for (;;)
   {
     chr = (int) (unsigned char) *(offset);
@@ -250,7 +1413,7 @@ BREAK_FRC_LOOP:
   //FIXME: Check for arithemtic overflow here
   ds->lastType = JT_DOUBLE;
   ds->start = offset;
-  return ds->dec->newDouble (ds->prv, createDouble( (double) intNeg, (double) intValue, frcValue, decimalCount));
+  return NewDouble(ds, createDouble( (double) intNeg, (double) intValue, frcValue, decimalCount));
 
 DECODE_EXPONENT:
   if (ds->dec->preciseFloat)
@@ -306,7 +1469,7 @@ BREAK_EXP_LOOP:
   //FIXME: Check for arithemtic overflow here
   ds->lastType = JT_DOUBLE;
   ds->start = offset;
-  return ds->dec->newDouble (ds->prv, createDouble( (double) intNeg, (double) intValue , frcValue, decimalCount) * pow(10.0, expValue * expNeg));
+  return NewDouble(ds, createDouble( (double) intNeg, (double) intValue , frcValue, decimalCount) * pow(10.0, expValue * expNeg));
 }
 
 FASTCALL_ATTR JSOBJ FASTCALL_MSVC decode_true ( struct DecoderState *ds)
@@ -375,6 +1538,55 @@ FASTCALL_ATTR void FASTCALL_MSVC SkipWhitespace(struct DecoderState *ds)
 {
   char *offset = ds->start;
 
+  /*
+  Compact input has no whitespace at all and the default separators of most encoders only add a single
+  space, so settle those cases before loading anything wide */
+  switch (*offset)
+  {
+    case ' ':
+    case '\t':
+    case '\r':
+    case '\n':
+      offset ++;
+      break;
+
+    default:
+      return;
+  }
+
+  switch (*offset)
+  {
+    case ' ':
+    case '\t':
+    case '\r':
+    case '\n':
+      break;
+
+    default:
+      ds->start = offset;
+      return;
+  }
+
+#ifdef JSON_DECODE_SSE2
+  // Indented input, skip the rest of the run a vector at a time
+  while (ds->end - offset >= 16)
+  {
+    __m128i chunk = _mm_loadu_si128((const __m128i *) offset);
+    __m128i space = _mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))),
+      _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'))));
+    JSUINT32 mask = ~((JSUINT32) _mm_movemask_epi8(space)) & 0xffff;
+
+    if (mask)
+    {
+      ds->start = offset + CountTrailingZeros(mask);
+      return;
+    }
+
+    offset += 16;
+  }
+#endif
+
   for (;;)
   {
     switch (*offset)
@@ -422,63 +1634,476 @@ static const JSUINT8 g_decoderLookup[256] =
   /* 0xf0 */ 4, 4, 4, 4, 4, 4, 4, 4, DS_UTFLENERROR, DS_UTFLENERROR, DS_UTFLENERROR, DS_UTFLENERROR, DS_UTFLENERROR, DS_UTFLENERROR, DS_UTFLENERROR, DS_UTFLENERROR,
 };
 
-FASTCALL_ATTR JSOBJ FASTCALL_MSVC decode_string ( struct DecoderState *ds)
+/*
+Same as g_decoderLookup for Latin-1 input, where every byte is a code point of its own. Bytes >= 0x80 take
+the path of stray continuation bytes, which passes them on as the code point of the same value */
+static const JSUINT8 g_decoderLookupLatin1[256] =
 {
-  JSUTF16 sur[2] = { 0 };
-  int iSur = 0;
-  int index;
-  wchar_t *escOffset;
-  wchar_t *escStart;
-  size_t escLen = (ds->escEnd - ds->escStart);
-  JSUINT8 *inputOffset;
+  /* 0x00 */ DS_ISNULL, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  /* 0x10 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  /* 0x20 */ 1, 1, DS_ISQUOTE, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  /* 0x30 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  /* 0x40 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  /* 0x50 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, DS_ISESCAPE, 1, 1, 1,
+  /* 0x60 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  /* 0x70 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  /* 0x80 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  /* 0x90 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  /* 0xa0 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  /* 0xb0 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  /* 0xc0 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  /* 0xd0 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  /* 0xe0 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+  /* 0xf0 */ 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+};
+
+#ifdef JSON_DECODE_SSE2
+/*
+Marks the bytes the string decoders have to look at themselves: '"', '\\', control characters (which
+includes the NUL sentinel) and anything >= 0x80. The signed compare against 0x20 catches both of the
+latter ranges at once */
+static INLINE_PREFIX JSUINT32 StringSpecialMask16(__m128i chunk)
+{
+  __m128i special = _mm_or_si128(
+    _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\"')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\'))),
+    _mm_cmplt_epi8(chunk, _mm_set1_epi8(0x20)));
+
+  return (JSUINT32) _mm_movemask_epi8(special);
+}
+
+#ifdef JSON_DECODE_AVX2
+static INLINE_PREFIX JSUINT32 StringSpecialMask32(__m256i chunk)
+{
+  __m256i special = _mm256_or_si256(
+    _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\"')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\\'))),
+    _mm256_cmpgt_epi8(_mm256_set1_epi8(0x20), chunk));
+
+  return (JSUINT32) _mm256_movemask_epi8(special);
+}
+#endif
+
+/*
+Widens the run of plain ASCII starting at inputOffset into escOffset a vector at a time and returns the
+number of bytes consumed, stopping at the first byte StringSpecialMask16 marks. Only whole vectors before
+inputEnd are loaded, but they are always stored whole, so escOffset must have room for
+inputEnd - inputOffset wchar_t */
+static FASTCALL_ATTR INLINE_PREFIX size_t FASTCALL_MSVC ScanStringRun(const JSUINT8 *inputOffset, const JSUINT8 *inputEnd, wchar_t *escOffset)
+{
+  const JSUINT8 *runStart = inputOffset;
+  JSUINT32 mask;
+
+#ifdef JSON_DECODE_AVX2
+  while (inputEnd - inputOffset >= 32)
+  {
+    mask = StringSpecialMask32(_mm256_loadu_si256((const __m256i *) inputOffset));
+
+#if WCHAR_MAX == 0xffff
+    _mm256_storeu_si256((__m256i *) (escOffset + 0), _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (inputOffset + 0))));
+    _mm256_storeu_si256((__m256i *) (escOffset + 16), _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *) (inputOffset + 16))));
+#else
+    _mm256_storeu_si256((__m256i *) (escOffset + 0), _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (inputOffset + 0))));
+    _mm256_storeu_si256((__m256i *) (escOffset + 8), _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (inputOffset + 8))));
+    _mm256_storeu_si256((__m256i *) (escOffset + 16), _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (inputOffset + 16))));
+    _mm256_storeu_si256((__m256i *) (escOffset + 24), _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (inputOffset + 24))));
+#endif
+
+    if (mask)
+    {
+      return (size_t) (inputOffset - runStart) + CountTrailingZeros(mask);
+    }
+
+    inputOffset += 32;
+    escOffset += 32;
+  }
+#endif
+
+  while (inputEnd - inputOffset >= 16)
+  {
+    __m128i chunk = _mm_loadu_si128((const __m128i *) inputOffset);
+    __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_unpacklo_epi8(chunk, zero);
+    __m128i hi = _mm_unpackhi_epi8(chunk, zero);
+
+    mask = StringSpecialMask16(chunk);
+
+#if WCHAR_MAX == 0xffff
+    _mm_storeu_si128((__m128i *) (escOffset + 0), lo);
+    _mm_storeu_si128((__m128i *) (escOffset + 8), hi);
+#else
+    _mm_storeu_si128((__m128i *) (escOffset + 0), _mm_unpacklo_epi16(lo, zero));
+    _mm_storeu_si128((__m128i *) (escOffset + 4), _mm_unpackhi_epi16(lo, zero));
+    _mm_storeu_si128((__m128i *) (escOffset + 8), _mm_unpacklo_epi16(hi, zero));
+    _mm_storeu_si128((__m128i *) (escOffset + 12), _mm_unpackhi_epi16(hi, zero));
+#endif
+
+    if (mask)
+    {
+      return (size_t) (inputOffset - runStart) + CountTrailingZeros(mask);
+    }
+
+    inputOffset += 16;
+    escOffset += 16;
+  }
+
+  return (size_t) (inputOffset - runStart);
+}
+
+/*
+Same as ScanStringRun but copies the run as is for decode_string_utf8. escOffset must have room for
+inputEnd - inputOffset bytes */
+static FASTCALL_ATTR INLINE_PREFIX size_t FASTCALL_MSVC ScanStringRunUTF8(const JSUINT8 *inputOffset, const JSUINT8 *inputEnd, char *escOffset)
+{
+  const JSUINT8 *runStart = inputOffset;
+  JSUINT32 mask;
+
+#ifdef JSON_DECODE_AVX2
+  while (inputEnd - inputOffset >= 32)
+  {
+    __m256i chunk = _mm256_loadu_si256((const __m256i *) inputOffset);
+    mask = StringSpecialMask32(chunk);
+    _mm256_storeu_si256((__m256i *) escOffset, chunk);
+
+    if (mask)
+    {
+      return (size_t) (inputOffset - runStart) + CountTrailingZeros(mask);
+    }
+
+    inputOffset += 32;
+    escOffset += 32;
+  }
+#endif
+
+  while (inputEnd - inputOffset >= 16)
+  {
+    __m128i chunk = _mm_loadu_si128((const __m128i *) inputOffset);
+    mask = StringSpecialMask16(chunk);
+    _mm_storeu_si128((__m128i *) escOffset, chunk);
+
+    if (mask)
+    {
+      return (size_t) (inputOffset - runStart) + CountTrailingZeros(mask);
+    }
+
+    inputOffset += 16;
+    escOffset += 16;
+  }
+
+  return (size_t) (inputOffset - runStart);
+}
+
+/*
+Same as ScanStringRunUTF8 without copying, for strings handed on in place */
+static FASTCALL_ATTR INLINE_PREFIX size_t FASTCALL_MSVC ScanStringClean(const JSUINT8 *inputOffset, const JSUINT8 *inputEnd)
+{
+  const JSUINT8 *runStart = inputOffset;
+  JSUINT32 mask;
+
+#ifdef JSON_DECODE_AVX2
+  while (inputEnd - inputOffset >= 32)
+  {
+    mask = StringSpecialMask32(_mm256_loadu_si256((const __m256i *) inputOffset));
+
+    if (mask)
+    {
+      return (size_t) (inputOffset - runStart) + CountTrailingZeros(mask);
+    }
+
+    inputOffset += 32;
+  }
+#endif
+
+  while (inputEnd - inputOffset >= 16)
+  {
+    mask = StringSpecialMask16(_mm_loadu_si128((const __m128i *) inputOffset));
+
+    if (mask)
+    {
+      return (size_t) (inputOffset - runStart) + CountTrailingZeros(mask);
+    }
+
+    inputOffset += 16;
+  }
+
+  return (size_t) (inputOffset - runStart);
+}
+#endif
+
+/*
+Returns the end of the string starting after an opening quote at offset, i.e. its closing quote, or NULL if
+it isn't terminated. Escape sequences are stepped over without being checked */
+static const char *SkipString(const char *offset, const char *end)
+{
+  for (;;)
+  {
+#ifdef JSON_DECODE_SSE2
+    while (end - offset >= 16)
+    {
+      __m128i chunk = _mm_loadu_si128((const __m128i *) offset);
+      JSUINT32 mask = (JSUINT32) _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\"')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\'))));
+
+      if (mask)
+      {
+        offset += CountTrailingZeros(mask);
+        break;
+      }
+      offset += 16;
+    }
+#endif
+
+    while (offset < end && *offset != '\"' && *offset != '\\')
+    {
+      offset ++;
+    }
+
+    if (offset == end)
+    {
+      return NULL;
+    }
+
+    if (*offset == '\"')
+    {
+      return offset;
+    }
+
+    if (end - offset < 2)
+    {
+      return NULL;
+    }
+    offset += 2;
+  }
+}
+
+/*
+Grows the escape buffer to hold at least newSize wchar_t. The contents are not preserved. A heap buffer at
+least doubles so a run of growing strings only reallocates a few times */
+static int ReserveEscapeBuffer(struct DecoderState *ds, size_t newSize)
+{
+  size_t escLen = (ds->escEnd - ds->escStart);
+  wchar_t *escStart;
+
+  if (newSize <= escLen)
+  {
+    return TRUE;
+  }
+
+  if (newSize > (SIZE_MAX / sizeof(wchar_t)))
+  {
+    SetError(ds, -1, "Could not reserve memory block");
+    return FALSE;
+  }
+
+  if (ds->escHeap)
+  {
+    if (newSize / 2 < escLen && escLen <= (SIZE_MAX / sizeof(wchar_t)) / 2)
+    {
+      newSize = escLen * 2;
+    }
+    escStart = (wchar_t *) ds->dec->realloc(ds->escStart, newSize * sizeof(wchar_t));
+  }
+  else
+  {
+    escStart = (wchar_t *) ds->dec->malloc(newSize * sizeof(wchar_t));
+  }
+
+  if (!escStart)
+  {
+    // On failure a heap buffer is still owned by ds and released by JSON_DecodeObject
+    SetError(ds, -1, "Could not reserve memory block");
+    return FALSE;
+  }
+
+  ds->escStart = escStart;
+  ds->escEnd = ds->escStart + newSize;
+  ds->escHeap = 1;
+  return TRUE;
+}
+
+/*
+Returns the end of the string being decoded, scanning from offset: just past its closing quote or the end of
+the input if it isn't terminated. The escape buffer is sized to it rather than to the rest of the input */
+static const char *StringEnd(struct DecoderState *ds, const char *offset)
+{
+  const char *end = SkipString(offset, ds->end);
+  return end ? end + 1 : ds->end;
+}
+
+/*
+Appends code point ucs to escOffset as UTF-8, surrogates included, and returns the new end */
+static FASTCALL_ATTR INLINE_PREFIX char * FASTCALL_MSVC AppendUTF8(char *escOffset, JSUTF32 ucs)
+{
+  if (ucs < 0x80)
+  {
+    *(escOffset++) = (char) ucs;
+  }
+  else
+  if (ucs < 0x800)
+  {
+    *(escOffset++) = (char) (0xc0 | (ucs >> 6));
+    *(escOffset++) = (char) (0x80 | (ucs & 0x3f));
+  }
+  else
+  if (ucs < 0x10000)
+  {
+    *(escOffset++) = (char) (0xe0 | (ucs >> 12));
+    *(escOffset++) = (char) (0x80 | ((ucs >> 6) & 0x3f));
+    *(escOffset++) = (char) (0x80 | (ucs & 0x3f));
+  }
+  else
+  {
+    *(escOffset++) = (char) (0xf0 | (ucs >> 18));
+    *(escOffset++) = (char) (0x80 | ((ucs >> 12) & 0x3f));
+    *(escOffset++) = (char) (0x80 | ((ucs >> 6) & 0x3f));
+    *(escOffset++) = (char) (0x80 | (ucs & 0x3f));
+  }
+
+  return escOffset;
+}
+
+/*
+Checks the multibyte sequence of length bytes at inputOffset the way decode_string does and stores the code
+point in *pucs. Returns 0 with the error set if it is invalid, 1 if it is well formed and 2 if it is only
+accepted because the continuation byte check is lenient (it tests the top bit alone), in which case it has to
+be re-encoded to be valid UTF-8. Code points above U+10FFFF are rejected since maxChar is meant to size the
+caller's storage */
+static FASTCALL_ATTR INLINE_PREFIX int FASTCALL_MSVC ReadUTF8Sequence(struct DecoderState *ds, const JSUINT8 *inputOffset, int length, JSUTF32 *pucs)
+{
+  static const JSUTF32 leadMask[5] = { 0, 0, 0x1f, 0x0f, 0x07 };
+  static const JSUTF32 minValue[5] = { 0, 0, 0x80, 0x800, 0x10000 };
+  JSUTF32 ucs = inputOffset[0] & leadMask[length];
+  JSUINT8 lenient = 0;
   JSUINT8 oct;
+  int index;
+
+  for (index = 1; index < length; index ++)
+  {
+    oct = inputOffset[index];
+
+    if ((oct & 0x80) != 0x80)
+    {
+      SetError(ds, -1, "Invalid octet in UTF-8 sequence when decoding 'string'");
+      return 0;
+    }
+
+    ucs = (ucs << 6) | (oct & 0x3f);
+    lenient |= oct & 0x40;
+  }
+
+  if (ucs < minValue[length])
+  {
+    switch (length)
+    {
+      case 2: SetError (ds, -1, "Overlong 2 byte UTF-8 sequence detected when decoding 'string'"); break;
+      case 3: SetError (ds, -1, "Overlong 3 byte UTF-8 sequence detected when encoding string"); break;
+      default: SetError (ds, -1, "Overlong 4 byte UTF-8 sequence detected when decoding 'string'"); break;
+    }
+    return 0;
+  }
+
+  if (ucs > 0x10ffff)
+  {
+    SetError (ds, -1, "Code point out of range in UTF-8 sequence when decoding 'string'");
+    return 0;
+  }
+
+  *pucs = ucs;
+  return lenient ? 2 : 1;
+}
+
+/*
+String decoder used when the caller provides newStringUTF8 (or newKeyUTF8 for key names), which gets the result.
+Most strings need no unescaping, so the first loop only validates and tracks maxChar and hands the consumer
+the span of the input buffer itself. Once something turns up that has to be rewritten (an escape sequence or
+malformed UTF-8 that decode_string tolerates) the part scanned so far is copied into the escape buffer, used
+as a byte buffer, and the second loop unescapes the rest into it. Decoded characters are re-encoded there, so
+the output is canonical UTF-8. It is at most twice the input (a stray continuation byte becomes a 2 byte
+sequence) */
+FASTCALL_ATTR JSOBJ FASTCALL_MSVC decode_string_utf8 ( struct DecoderState *ds, JSPFN_NEWSTRINGUTF8 newStringUTF8)
+{
+  JSUTF16 sur[2] = { 0 };
+  int iSur = 0;
+  int index;
+  int chrClass;
+  char *escStart;
+  char *escOffset;
+  JSUINT8 *inputOffset;
+  JSUINT8 *inputEnd = (JSUINT8 *) ds->end;
   JSUTF32 ucs;
+  JSUTF32 maxChar = 0;
+  const JSUINT8 *lookup = ds->dec->latin1 ? g_decoderLookupLatin1 : g_decoderLookup;
   ds->lastType = JT_INVALID;
   ds->start ++;
 
-  if ( (size_t) (ds->end - ds->start) > escLen)
+  inputOffset = (JSUINT8 *) ds->start;
+
+  for (;;)
   {
-    size_t newSize = (ds->end - ds->start);
+#ifdef JSON_DECODE_SSE2
+    inputOffset += ScanStringClean(inputOffset, inputEnd);
+#endif
 
-    if (ds->escHeap)
+    switch (chrClass = lookup[(JSUINT8)(*inputOffset)])
     {
-      if (newSize > (SIZE_MAX / sizeof(wchar_t)))
+      case DS_ISNULL:
+      {
+        return SetError(ds, -1, "Unmatched ''\"' when when decoding 'string'");
+      }
+      case DS_ISQUOTE:
       {
-        return SetError(ds, -1, "Could not reserve memory block");
+        ds->lastType = JT_UTF8;
+        escStart = ds->start;
+        ds->start = (char *) inputOffset + 1;
+        return newStringUTF8(ds->prv, escStart, (char *) inputOffset, maxChar, FALSE);
       }
-      escStart = (wchar_t *)ds->dec->realloc(ds->escStart, newSize * sizeof(wchar_t));
-      if (!escStart)
+      case DS_UTFLENERROR:
       {
-        ds->dec->free(ds->escStart);
-        return SetError(ds, -1, "Could not reserve memory block");
+        return SetError (ds, -1, "Invalid UTF-8 sequence length when decoding 'string'");
       }
-      ds->escStart = escStart;
-    }
-    else
-    {
-      wchar_t *oldStart = ds->escStart;
-      if (newSize > (SIZE_MAX / sizeof(wchar_t)))
+      case DS_ISESCAPE:
+      {
+        goto DECODE_ESCAPED;
+      }
+      case 1:
       {
-        return SetError(ds, -1, "Could not reserve memory block");
+        if (*inputOffset >= 0x80)
+        {
+          goto DECODE_ESCAPED;
+        }
+        inputOffset ++;
+        break;
       }
-      ds->escStart = (wchar_t *) ds->dec->malloc(newSize * sizeof(wchar_t));
-      if (!ds->escStart)
+      default:
       {
-        return SetError(ds, -1, "Could not reserve memory block");
+        switch (ReadUTF8Sequence(ds, inputOffset, chrClass, &ucs))
+        {
+          case 0: return NULL;
+          case 2: goto DECODE_ESCAPED;
+        }
+
+        inputOffset += chrClass;
+        if (ucs > maxChar)
+        {
+          maxChar = ucs;
+        }
+        break;
       }
-      ds->escHeap = 1;
-      memcpy(ds->escStart, oldStart, escLen * sizeof(wchar_t));
     }
+  }
 
-    ds->escEnd = ds->escStart + newSize;
+DECODE_ESCAPED:
+  inputEnd = (JSUINT8 *) StringEnd(ds, (char *) inputOffset);
+
+  if (!ReserveEscapeBuffer(ds, (2 * ((char *) inputEnd - ds->start) + sizeof(wchar_t) - 1) / sizeof(wchar_t)))
+  {
+    return NULL;
   }
 
-  escOffset = ds->escStart;
-  inputOffset = (JSUINT8 *) ds->start;
+  escStart = (char *) ds->escStart;
+  memcpy(escStart, ds->start, (char *) inputOffset - ds->start);
+  escOffset = escStart + ((char *) inputOffset - ds->start);
 
   for (;;)
   {
-    switch (g_decoderLookup[(JSUINT8)(*inputOffset)])
+    switch (chrClass = lookup[(JSUINT8)(*inputOffset)])
     {
       case DS_ISNULL:
       {
@@ -489,7 +2114,7 @@ FASTCALL_ATTR JSOBJ FASTCALL_MSVC decode_string ( struct DecoderState *ds)
         ds->lastType = JT_UTF8;
         inputOffset ++;
         ds->start += ( (char *) inputOffset - (ds->start));
-        return ds->dec->newString(ds->prv, ds->escStart, escOffset);
+        return newStringUTF8(ds->prv, escStart, escOffset, maxChar, TRUE);
       }
       case DS_UTFLENERROR:
       {
@@ -499,18 +2124,17 @@ FASTCALL_ATTR JSOBJ FASTCALL_MSVC decode_string ( struct DecoderState *ds)
         inputOffset ++;
         switch (*inputOffset)
         {
-          case '\\': *(escOffset++) = L'\\'; inputOffset++; continue;
-          case '\"': *(escOffset++) = L'\"'; inputOffset++; continue;
-          case '/':  *(escOffset++) = L'/';  inputOffset++; continue;
-          case 'b':  *(escOffset++) = L'\b'; inputOffset++; continue;
-          case 'f':  *(escOffset++) = L'\f'; inputOffset++; continue;
-          case 'n':  *(escOffset++) = L'\n'; inputOffset++; continue;
-          case 'r':  *(escOffset++) = L'\r'; inputOffset++; continue;
-          case 't':  *(escOffset++) = L'\t'; inputOffset++; continue;
+          case '\\': *(escOffset++) = '\\'; inputOffset++; continue;
+          case '\"': *(escOffset++) = '\"'; inputOffset++; continue;
+          case '/':  *(escOffset++) = '/';  inputOffset++; continue;
+          case 'b':  *(escOffset++) = '\b'; inputOffset++; continue;
+          case 'f':  *(escOffset++) = '\f'; inputOffset++; continue;
+          case 'n':  *(escOffset++) = '\n'; inputOffset++; continue;
+          case 'r':  *(escOffset++) = '\r'; inputOffset++; continue;
+          case 't':  *(escOffset++) = '\t'; inputOffset++; continue;
 
           case 'u':
           {
-            int index;
             inputOffset ++;
 
             for (index = 0; index < 4; index ++)
@@ -563,8 +2187,7 @@ FASTCALL_ATTR JSOBJ FASTCALL_MSVC decode_string ( struct DecoderState *ds)
                 iSur ++;
                 break;
               }
-              (*escOffset++) = (wchar_t) sur[iSur];
-              iSur = 0;
+              ucs = (JSUTF32) sur[iSur];
             }
             else
             {
@@ -573,14 +2196,15 @@ FASTCALL_ATTR JSOBJ FASTCALL_MSVC decode_string ( struct DecoderState *ds)
               {
                 return SetError (ds, -1, "Unpaired high surrogate when decoding 'string'");
               }
-#if WCHAR_MAX == 0xffff
-              (*escOffset++) = (wchar_t) sur[0];
-              (*escOffset++) = (wchar_t) sur[1];
-#else
-              (*escOffset++) = (wchar_t) 0x10000 + (((sur[0] - 0xd800) << 10) | (sur[1] - 0xdc00));
-#endif
+              ucs = 0x10000 + (((sur[0] - 0xd800) << 10) | (sur[1] - 0xdc00));
               iSur = 0;
             }
+
+            escOffset = AppendUTF8(escOffset, ucs);
+            if (ucs > maxChar)
+            {
+              maxChar = ucs;
+            }
           break;
         }
 
@@ -591,13 +2215,221 @@ FASTCALL_ATTR JSOBJ FASTCALL_MSVC decode_string ( struct DecoderState *ds)
 
       case 1:
       {
-        *(escOffset++) = (wchar_t) (*inputOffset++);
-        break;
-      }
-
-      case 2:
-      {
-        ucs = (*inputOffset++) & 0x1f;
+        if (*inputOffset >= 0x80)
+        {
+          // Stray continuation byte, passed on as the code point of the same value like decode_string does
+          ucs = (JSUTF32) (*inputOffset++);
+          escOffset = AppendUTF8(escOffset, ucs);
+          if (ucs > maxChar)
+          {
+            maxChar = ucs;
+          }
+          break;
+        }
+
+        *(escOffset++) = (char) (*inputOffset++);
+#ifdef JSON_DECODE_SSE2
+        {
+          size_t run = ScanStringRunUTF8(inputOffset, inputEnd, escOffset);
+          inputOffset += run;
+          escOffset += run;
+        }
+#endif
+        break;
+      }
+
+      default:
+      {
+        switch (ReadUTF8Sequence(ds, inputOffset, chrClass, &ucs))
+        {
+          case 0:
+          {
+            return NULL;
+          }
+          case 1:
+          {
+            memcpy(escOffset, inputOffset, chrClass);
+            escOffset += chrClass;
+            break;
+          }
+          default:
+          {
+            escOffset = AppendUTF8(escOffset, ucs);
+            break;
+          }
+        }
+
+        inputOffset += chrClass;
+        if (ucs > maxChar)
+        {
+          maxChar = ucs;
+        }
+        break;
+      }
+    }
+  }
+}
+
+FASTCALL_ATTR JSOBJ FASTCALL_MSVC decode_string ( struct DecoderState *ds)
+{
+  JSUTF16 sur[2] = { 0 };
+  int iSur = 0;
+  int index;
+  wchar_t *escOffset;
+  JSUINT8 *inputOffset;
+  JSUINT8 *inputEnd = (JSUINT8 *) ds->end;
+  JSUINT8 oct;
+  JSUTF32 ucs;
+  const JSUINT8 *lookup;
+
+  if (ds->dec->newStringUTF8)
+  {
+    return decode_string_utf8(ds, ds->dec->newStringUTF8);
+  }
+
+  lookup = ds->dec->latin1 ? g_decoderLookupLatin1 : g_decoderLookup;
+
+  ds->lastType = JT_INVALID;
+  ds->start ++;
+  inputEnd = (JSUINT8 *) StringEnd(ds, ds->start);
+
+  if (!ReserveEscapeBuffer(ds, (char *) inputEnd - ds->start))
+  {
+    return NULL;
+  }
+
+  escOffset = ds->escStart;
+  inputOffset = (JSUINT8 *) ds->start;
+
+  for (;;)
+  {
+    switch (lookup[(JSUINT8)(*inputOffset)])
+    {
+      case DS_ISNULL:
+      {
+        return SetError(ds, -1, "Unmatched ''\"' when when decoding 'string'");
+      }
+      case DS_ISQUOTE:
+      {
+        ds->lastType = JT_UTF8;
+        inputOffset ++;
+        ds->start += ( (char *) inputOffset - (ds->start));
+        return ds->dec->newString(ds->prv, ds->escStart, escOffset);
+      }
+      case DS_UTFLENERROR:
+      {
+        return SetError (ds, -1, "Invalid UTF-8 sequence length when decoding 'string'");
+      }
+      case DS_ISESCAPE:
+        inputOffset ++;
+        switch (*inputOffset)
+        {
+          case '\\': *(escOffset++) = L'\\'; inputOffset++; continue;
+          case '\"': *(escOffset++) = L'\"'; inputOffset++; continue;
+          case '/':  *(escOffset++) = L'/';  inputOffset++; continue;
+          case 'b':  *(escOffset++) = L'\b'; inputOffset++; continue;
+          case 'f':  *(escOffset++) = L'\f'; inputOffset++; continue;
+          case 'n':  *(escOffset++) = L'\n'; inputOffset++; continue;
+          case 'r':  *(escOffset++) = L'\r'; inputOffset++; continue;
+          case 't':  *(escOffset++) = L'\t'; inputOffset++; continue;
+
+          case 'u':
+          {
+            int index;
+            inputOffset ++;
+
+            for (index = 0; index < 4; index ++)
+            {
+              switch (*inputOffset)
+              {
+                case '\0': return SetError (ds, -1, "Unterminated unicode escape sequence when decoding 'string'");
+                default: return SetError (ds, -1, "Unexpected character in unicode escape sequence when decoding 'string'");
+
+                case '0':
+                case '1':
+                case '2':
+                case '3':
+                case '4':
+                case '5':
+                case '6':
+                case '7':
+                case '8':
+                case '9':
+                  sur[iSur] = (sur[iSur] << 4) + (JSUTF16) (*inputOffset - '0');
+                  break;
+
+                case 'a':
+                case 'b':
+                case 'c':
+                case 'd':
+                case 'e':
+                case 'f':
+                  sur[iSur] = (sur[iSur] << 4) + 10 + (JSUTF16) (*inputOffset - 'a');
+                  break;
+
+                case 'A':
+                case 'B':
+                case 'C':
+                case 'D':
+                case 'E':
+                case 'F':
+                  sur[iSur] = (sur[iSur] << 4) + 10 + (JSUTF16) (*inputOffset - 'A');
+                  break;
+              }
+
+              inputOffset ++;
+            }
+
+            if (iSur == 0)
+            {
+              if((sur[iSur] & 0xfc00) == 0xd800)
+              {
+                // First of a surrogate pair, continue parsing
+                iSur ++;
+                break;
+              }
+              (*escOffset++) = (wchar_t) sur[iSur];
+              iSur = 0;
+            }
+            else
+            {
+              // Decode pair
+              if ((sur[1] & 0xfc00) != 0xdc00)
+              {
+                return SetError (ds, -1, "Unpaired high surrogate when decoding 'string'");
+              }
+#if WCHAR_MAX == 0xffff
+              (*escOffset++) = (wchar_t) sur[0];
+              (*escOffset++) = (wchar_t) sur[1];
+#else
+              (*escOffset++) = (wchar_t) 0x10000 + (((sur[0] - 0xd800) << 10) | (sur[1] - 0xdc00));
+#endif
+              iSur = 0;
+            }
+          break;
+        }
+
+        case '\0': return SetError(ds, -1, "Unterminated escape sequence when decoding 'string'");
+        default: return SetError(ds, -1, "Unrecognized escape sequence when decoding 'string'");
+      }
+      break;
+
+      case 1:
+      {
+        *(escOffset++) = (wchar_t) (*inputOffset++);
+#ifdef JSON_DECODE_SSE2
+        {
+          size_t run = ScanStringRun(inputOffset, inputEnd, escOffset);
+          inputOffset += run;
+          escOffset += run;
+        }
+#endif
+        break;
+      }
+
+      case 2:
+      {
+        ucs = (*inputOffset++) & 0x1f;
         ucs <<= 6;
         if (((*inputOffset) & 0x80) != 0x80)
         {
@@ -672,161 +2504,586 @@ FASTCALL_ATTR JSOBJ FASTCALL_MSVC decode_string ( struct DecoderState *ds)
   }
 }
 
-FASTCALL_ATTR JSOBJ FASTCALL_MSVC decode_array(struct DecoderState *ds)
+/*
+Skips the container whose opening bracket *poffset points at by counting brackets, stepping over strings.
+Nothing inside is validated beyond brackets balancing and strings being terminated, the closing bracket
+must match the opening one. Returns nonzero with *poffset just past the closing bracket, otherwise zero
+with *poffset at the failure and *perror set */
+static int SkipContainer(const char **poffset, const char *end, const char **perror)
 {
-  JSOBJ itemValue;
-  JSOBJ newObj;
-  int len;
-  ds->objDepth++;
-  if (ds->objDepth > JSON_MAX_OBJECT_DEPTH) {
-    return SetError(ds, -1, "Reached object decoding depth limit");
-  }
+  const char *offset = *poffset;
+  char close = *offset == '{' ? '}' : ']';
+  size_t depth = 1;
 
-  newObj = ds->dec->newArray(ds->prv);
-  len = 0;
-
-  ds->lastType = JT_INVALID;
-  ds->start ++;
+  offset ++;
 
   for (;;)
   {
-    SkipWhitespace(ds);
-
-    if ((*ds->start) == ']')
+#ifdef JSON_DECODE_SSE2
+    while (end - offset >= 16)
     {
-      ds->objDepth--;
-      if (len == 0)
+      __m128i chunk = _mm_loadu_si128((const __m128i *) offset);
+      __m128i brackets = _mm_or_si128(
+          _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('[')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8(']'))),
+          _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('{')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('}'))));
+      JSUINT32 mask = (JSUINT32) _mm_movemask_epi8(_mm_or_si128(brackets, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\"'))));
+
+      if (mask)
       {
-        ds->start ++;
-        return newObj;
+        offset += CountTrailingZeros(mask);
+        break;
       }
-
-      ds->dec->releaseObject(ds->prv, newObj);
-      return SetError(ds, -1, "Unexpected character found when decoding array value (1)");
+      offset += 16;
     }
+#endif
 
-    itemValue = decode_any(ds);
+    while (offset < end && *offset != '\"' && *offset != '[' && *offset != ']' && *offset != '{' && *offset != '}')
+    {
+      offset ++;
+    }
 
-    if (itemValue == NULL)
+    if (offset == end)
     {
-      ds->dec->releaseObject(ds->prv, newObj);
-      return NULL;
+      break;
     }
 
-    ds->dec->arrayAddItem (ds->prv, newObj, itemValue);
+    switch (*offset)
+    {
+      case '\"':
+      {
+        if (!(offset = SkipString(offset + 1, end)))
+        {
+          *poffset = end;
+          *perror = "Unmatched ''\"' when when decoding 'string'";
+          return FALSE;
+        }
+        break;
+      }
 
-    SkipWhitespace(ds);
+      case '[':
+      case '{':
+        depth ++;
+        break;
 
-    switch (*(ds->start++))
-    {
-    case ']':
-    {
-      ds->objDepth--;
-      return newObj;
+      default:
+      {
+        if (--depth == 0)
+        {
+          if (*offset != close)
+          {
+            break;
+          }
+          *poffset = offset + 1;
+          return TRUE;
+        }
+      }
     }
-    case ',':
-      break;
 
-    default:
-      ds->dec->releaseObject(ds->prv, newObj);
-      return SetError(ds, -1, "Unexpected character found when decoding array value (2)");
+    if (depth == 0)
+    {
+      break;
     }
-
-    len ++;
+    offset ++;
   }
+
+  *poffset = offset;
+  *perror = close == '}' ? "Unexpected character in found when decoding object value" : "Unexpected character found when decoding array value (2)";
+  return FALSE;
 }
 
-FASTCALL_ATTR JSOBJ FASTCALL_MSVC decode_object( struct DecoderState *ds)
+/*
+Steps over the value at ds->start without decoding it, for keys left out by a projection. Like
+SkipContainer scalars are only delimited, not validated */
+static int SkipValue(struct DecoderState *ds)
 {
-  JSOBJ itemName;
-  JSOBJ itemValue;
-  JSOBJ newObj;
+  const char *offset;
+  const char *error;
 
-  ds->objDepth++;
-  if (ds->objDepth > JSON_MAX_OBJECT_DEPTH) {
-    return SetError(ds, -1, "Reached object decoding depth limit");
-  }
-
-  newObj = ds->dec->newObject(ds->prv);
-
-  ds->start ++;
+  SkipWhitespace(ds);
+  offset = ds->start;
 
-  for (;;)
+  switch (*offset)
   {
-    SkipWhitespace(ds);
-
-    if ((*ds->start) == '}')
+    case '{':
+    case '[':
     {
-      ds->objDepth--;
-      ds->start ++;
-      return newObj;
+      if (!SkipContainer(&offset, ds->end, &error))
+      {
+        ds->start = (char *) offset;
+        SetError(ds, -1, error);
+        return FALSE;
+      }
+      break;
     }
 
-    ds->lastType = JT_INVALID;
-    itemName = decode_any(ds);
-
-    if (itemName == NULL)
+    case '\"':
     {
-      ds->dec->releaseObject(ds->prv, newObj);
-      return NULL;
+      if (!(offset = SkipString(offset + 1, ds->end)))
+      {
+        ds->start = ds->end;
+        SetError(ds, -1, "Unmatched ''\"' when when decoding 'string'");
+        return FALSE;
+      }
+      offset ++;
+      break;
     }
 
-    if (ds->lastType != JT_UTF8)
+    default:
     {
-      ds->dec->releaseObject(ds->prv, newObj);
-      ds->dec->releaseObject(ds->prv, itemName);
-      return SetError(ds, -1, "Key name of object must be 'string' when decoding 'object'");
-    }
-
-    SkipWhitespace(ds);
+      while (offset < ds->end && *offset != ',' && *offset != '}' && *offset != ']' && *offset != ' ' && *offset != '\t' && *offset != '\r' && *offset != '\n')
+      {
+        offset ++;
+      }
 
-    if (*(ds->start++) != ':')
-    {
-      ds->dec->releaseObject(ds->prv, newObj);
-      ds->dec->releaseObject(ds->prv, itemName);
-      return SetError(ds, -1, "No ':' found when decoding object value");
+      if (offset == ds->start)
+      {
+        SetError(ds, -1, "Expected object or value");
+        return FALSE;
+      }
     }
+  }
 
-    SkipWhitespace(ds);
-
-    itemValue = decode_any(ds);
+  ds->start = (char *) offset;
+  return TRUE;
+}
 
-    if (itemValue == NULL)
-    {
-      ds->dec->releaseObject(ds->prv, newObj);
-      ds->dec->releaseObject(ds->prv, itemName);
-      return NULL;
+struct KeySpan
+{
+  char *start;
+  char *end;
+  JSUTF32 maxChar;
+  int escaped;
+};
+
+static JSOBJ KeySpan_set(void *prv, char *start, char *end, JSUTF32 maxChar, int escaped)
+{
+  struct KeySpan *span = (struct KeySpan *) prv;
+
+  span->start = start;
+  span->end = end;
+  span->maxChar = maxChar;
+  span->escaped = escaped;
+  return span;
+}
+
+/*
+Decodes the key name at ds->start if projection selects it, otherwise steps over it and its value. Returns
+the key, or NULL with *pskipped set if it was skipped, or NULL on error. The key is unescaped into a
+KeySpan first to compare it, then handed to newKeyUTF8, or decoded again if there is none */
+static JSOBJ DecodeProjectedKey(struct DecoderState *ds, const JSONProjection *projection, int *pskipped)
+{
+  struct KeySpan span;
+  char *keyStart = ds->start;
+  void *prv = ds->prv;
+  size_t length;
+  size_t index;
+
+  ds->prv = &span;
+  if (!decode_string_utf8(ds, KeySpan_set))
+  {
+    ds->prv = prv;
+    return NULL;
+  }
+  ds->prv = prv;
+
+  length = (size_t) (span.end - span.start);
+
+  for (index = 0; index < projection->count; index ++)
+  {
+    const JSONProjectionKey *key = &projection->keys[index];
+
+    if (key->length == length && memcmp(key->name, span.start, length) == 0)
+    {
+      ds->projection = key->fields;
+
+      if (ds->dec->newKeyUTF8)
+      {
+        return ds->dec->newKeyUTF8(ds->prv, span.start, span.end, span.maxChar, span.escaped);
+      }
+
+      ds->start = keyStart;
+      return decode_string(ds);
     }
+  }
 
-    ds->dec->objectAddKey (ds->prv, newObj, itemName, itemValue);
+  SkipWhitespace(ds);
 
-    SkipWhitespace(ds);
+  if (*(ds->start++) != ':')
+  {
+    return SetError(ds, -1, "No ':' found when decoding object value");
+  }
 
-    switch (*(ds->start++))
+  if (!SkipValue(ds))
+  {
+    return NULL;
+  }
+
+  *pskipped = TRUE;
+  return NULL;
+}
+
+struct DecoderFrame
+{
+  JSOBJ obj;
+  JSOBJ name;
+  int isObject;
+  // Set for the records array of JSON_DecodeRecords and its objects, which are never made
+  int records;
+  const JSONProjection *projection;
+  // Where the values of the container start on the value stack, when endArray and endObject are used
+  size_t base;
+};
+
+#define JSON_STACK_FRAMES 64
+
+struct DecoderStack
+{
+  struct DecoderFrame *frames;
+  size_t depth;
+  size_t capacity;
+  int heap;
+  struct DecoderFrame local[JSON_STACK_FRAMES];
+};
+
+static void DecoderStack_init(struct DecoderStack *stack)
+{
+  stack->frames = stack->local;
+  stack->depth = 0;
+  stack->capacity = JSON_STACK_FRAMES;
+  stack->heap = 0;
+}
+
+/*
+Releases whatever is left on the stack after an error, the containers were not handed to their parents yet */
+static void DecoderStack_release(struct DecoderState *ds, struct DecoderStack *stack)
+{
+  while (stack->depth > 0)
+  {
+    struct DecoderFrame *frame = &stack->frames[--stack->depth];
+
+    if (frame->name)
     {
-      case '}':
+      ds->dec->releaseObject(ds->prv, frame->name);
+    }
+    if (frame->obj)
+    {
+      ds->dec->releaseObject(ds->prv, frame->obj);
+    }
+  }
+
+  if (stack->heap)
+  {
+    ds->dec->free(stack->frames);
+  }
+}
+
+/*
+Makes room for one more container, the caller stores it in the returned frame. Checked before the container
+is created so going past the depth limit doesn't create it, like the recursive decoder did */
+static struct DecoderFrame *DecoderStack_push(struct DecoderState *ds, struct DecoderStack *stack, int isObject)
+{
+  struct DecoderFrame *frame;
+
+  if (stack->depth >= ds->maxDepth)
+  {
+    SetError(ds, -1, "Reached object decoding depth limit");
+    return NULL;
+  }
+
+  if (stack->depth == stack->capacity)
+  {
+    size_t newCapacity = stack->capacity * 2;
+
+    if (stack->heap)
+    {
+      frame = (struct DecoderFrame *) ds->dec->realloc(stack->frames, newCapacity * sizeof(struct DecoderFrame));
+    }
+    else
+    {
+      frame = (struct DecoderFrame *) ds->dec->malloc(newCapacity * sizeof(struct DecoderFrame));
+      if (frame)
       {
-        ds->objDepth--;
-        return newObj;
+        memcpy(frame, stack->frames, stack->depth * sizeof(struct DecoderFrame));
       }
-      case ',':
+    }
+
+    if (!frame)
+    {
+      SetError(ds, -1, "Could not reserve memory block");
+      return NULL;
+    }
+
+    stack->frames = frame;
+    stack->capacity = newCapacity;
+    stack->heap = 1;
+  }
+
+  frame = &stack->frames[stack->depth++];
+  frame->obj = NULL;
+  frame->name = NULL;
+  frame->isObject = isObject;
+  frame->records = FALSE;
+  frame->projection = ds->projection;
+  return frame;
+}
+
+#define JSON_STACK_VALUES 256
+
+/*
+Values of the open containers, key names before the values in objects, when the caller builds containers
+with endArray and endObject. Each container's values start at the base of its frame */
+struct ValueStack
+{
+  JSOBJ *values;
+  size_t count;
+  size_t capacity;
+  int heap;
+  JSOBJ local[JSON_STACK_VALUES];
+};
+
+static void ValueStack_init(struct ValueStack *stack)
+{
+  stack->values = stack->local;
+  stack->count = 0;
+  stack->capacity = JSON_STACK_VALUES;
+  stack->heap = 0;
+}
+
+static void ValueStack_release(struct DecoderState *ds, struct ValueStack *stack)
+{
+  while (stack->count > 0)
+  {
+    ds->dec->releaseObject(ds->prv, stack->values[--stack->count]);
+  }
+
+  if (stack->heap)
+  {
+    ds->dec->free(stack->values);
+  }
+}
+
+/*
+Pushes value, or releases it if there's no room */
+static int ValueStack_push(struct DecoderState *ds, struct ValueStack *stack, JSOBJ value)
+{
+  JSOBJ *values;
+
+  if (stack->count == stack->capacity)
+  {
+    if (stack->heap)
+    {
+      values = (JSOBJ *) ds->dec->realloc(stack->values, stack->capacity * 2 * sizeof(JSOBJ));
+    }
+    else
+    {
+      values = (JSOBJ *) ds->dec->malloc(stack->capacity * 2 * sizeof(JSOBJ));
+      if (values)
+      {
+        memcpy(values, stack->local, sizeof(stack->local));
+      }
+    }
+
+    if (!values)
+    {
+      ds->dec->releaseObject(ds->prv, value);
+      SetError(ds, -1, "Could not reserve memory block");
+      return FALSE;
+    }
+
+    stack->values = values;
+    stack->capacity *= 2;
+    stack->heap = 1;
+  }
+
+  stack->values[stack->count++] = value;
+  return TRUE;
+}
+
+#define JSON_NUMERIC_ARRAY_LOCAL 128
+
+union NumericValue
+{
+  JSINT64 longValue;
+  double doubleValue;
+};
+
+/*
+Decodes the array at ds->start, just past the '[' and its white space, if its elements are all numbers and
+hands them to newNumericArray in one go: JSINT64 if they are all integers that fit, double if any has a
+fraction or exponent, as long as every integer in it converts exactly. Returns 0 with ds->start as it was for
+other arrays, which are then decoded as usual and so report any error in them the usual way. Otherwise
+returns 1 with the array, or NULL on error, in *pvalue */
+static int DecodeNumericArray(struct DecoderState *ds, JSOBJ *pvalue)
+{
+  union NumericValue local[JSON_NUMERIC_ARRAY_LOCAL];
+  union NumericValue *values = local;
+  union NumericValue *newValues;
+  size_t count = 0;
+  size_t capacity = JSON_NUMERIC_ARRAY_LOCAL;
+  size_t index;
+  char *start = ds->start;
+  int type = JT_INVALID;
+  int ret = 0;
+
+  ds->rawNumbers = TRUE;
+
+  for (;;)
+  {
+    if (!decode_numeric(ds) || ds->numberType == JT_ULONG)
+    {
+      break;
+    }
+
+    if (ds->numberType == JT_LONG && type == JT_DOUBLE)
+    {
+      if (ds->numberLong < -(1LL << 53) || ds->numberLong > (1LL << 53))
+      {
         break;
+      }
+      ds->numberType = JT_DOUBLE;
+      ds->numberDouble = (double) ds->numberLong;
+    }
+    else
+    if (ds->numberType == JT_DOUBLE && type == JT_LONG)
+    {
+      for (index = 0; index < count; index ++)
+      {
+        if (values[index].longValue < -(1LL << 53) || values[index].longValue > (1LL << 53))
+        {
+          break;
+        }
+        values[index].doubleValue = (double) values[index].longValue;
+      }
 
-      default:
-        ds->dec->releaseObject(ds->prv, newObj);
-        return SetError(ds, -1, "Unexpected character in found when decoding object value");
+      if (index < count)
+      {
+        break;
+      }
+    }
+    type = ds->numberType;
+
+    if (count == capacity)
+    {
+      if (values == local)
+      {
+        newValues = (union NumericValue *) ds->dec->malloc(capacity * 2 * sizeof(union NumericValue));
+        if (newValues)
+        {
+          memcpy(newValues, local, sizeof(local));
+        }
+      }
+      else
+      {
+        newValues = (union NumericValue *) ds->dec->realloc(values, capacity * 2 * sizeof(union NumericValue));
+      }
+
+      if (!newValues)
+      {
+        break;
+      }
+      values = newValues;
+      capacity *= 2;
+    }
+
+    if (type == JT_LONG)
+    {
+      values[count++].longValue = ds->numberLong;
+    }
+    else
+    {
+      values[count++].doubleValue = ds->numberDouble;
+    }
+
+    SkipWhitespace(ds);
+
+    if (*ds->start == ']')
+    {
+      ds->start ++;
+
+      if (!(*pvalue = ds->dec->newNumericArray(ds->prv, type, values, count)))
+      {
+        SetError(ds, -1, "Could not reserve memory block");
+      }
+      ret = 1;
+      break;
+    }
+
+    if (*ds->start != ',')
+    {
+      break;
     }
+
+    ds->start ++;
+    SkipWhitespace(ds);
+
+    if (*ds->start != '-' && (*ds->start < '0' || *ds->start > '9'))
+    {
+      break;
+    }
+  }
+
+  if (!ret)
+  {
+    ds->start = start;
+    ds->dec->errorStr = NULL;
+    ds->dec->errorOffset = NULL;
+  }
+
+  ds->rawNumbers = FALSE;
+
+  if (values != local)
+  {
+    ds->dec->free(values);
+  }
+  return ret;
+}
+
+/*
+Decodes a number in a record, which is left in ds with ds returned unless it's an unsigned integer past
+JSINT64, that one is decoded again through the callbacks */
+static JSOBJ DecodeRecordNumber(struct DecoderState *ds)
+{
+  char *start = ds->start;
+  JSOBJ value;
+
+  ds->rawNumbers = TRUE;
+  value = decode_numeric(ds);
+  ds->rawNumbers = FALSE;
+
+  if (value && ds->numberType == JT_ULONG)
+  {
+    ds->start = start;
+    value = decode_numeric(ds);
   }
+  return value;
 }
 
+/*
+Decodes one value, containers included. Instead of recursing for every array and object, open containers
+are kept on an explicit stack that grows on the heap, so nesting costs no C stack and the depth limit is
+only a runtime setting. With endArray and endObject the values of open containers are kept on a stack as well,
+and each container is made in one go once it's closed */
 FASTCALL_ATTR JSOBJ FASTCALL_MSVC decode_any(struct DecoderState *ds)
 {
+  struct DecoderStack stack;
+  struct DecoderFrame *frame = NULL;
+  struct ValueStack values;
+  int buffered = ds->dec->endArray != NULL;
+  size_t count;
+  int pushed;
+  JSOBJ value;
+
+  DecoderStack_init(&stack);
+  ValueStack_init(&values);
+
+VALUE:
   for (;;)
   {
     switch (*ds->start)
     {
       case '\"':
-        return decode_string (ds);
+        value = decode_string (ds);
+        break;
       case '0':
       case '1':
       case '2':
@@ -838,70 +3095,2225 @@ FASTCALL_ATTR JSOBJ FASTCALL_MSVC decode_any(struct DecoderState *ds)
       case '8':
       case '9':
       case '-':
-        return decode_numeric (ds);
+        value = decode_numeric (ds);
+        break;
+
+      case 't': value = decode_true (ds); break;
+      case 'f': value = decode_false (ds); break;
+      case 'n': value = decode_null (ds); break;
+
+      case '[':
+      {
+        if (!(frame = DecoderStack_push(ds, &stack, FALSE)))
+        {
+          goto ERROR;
+        }
+
+        ds->lastType = JT_INVALID;
+        ds->start ++;
+        SkipWhitespace(ds);
+
+        if (ds->addField && stack.depth == 1)
+        {
+          frame->records = TRUE;
+
+          if ((*ds->start) == ']')
+          {
+            ds->start ++;
+            goto CLOSE;
+          }
+          goto RECORD;
+        }
+
+        if (ds->dec->newNumericArray && (*ds->start == '-' || (*ds->start >= '0' && *ds->start <= '9')) &&
+            DecodeNumericArray(ds, &frame->obj))
+        {
+          if (!frame->obj)
+          {
+            goto ERROR;
+          }
+          goto CLOSE;
+        }
+
+        frame->base = values.count;
+        if (!buffered)
+        {
+          frame->obj = ds->dec->newArray(ds->prv);
+        }
+
+        if ((*ds->start) == ']')
+        {
+          ds->start ++;
+          goto CLOSE;
+        }
+        continue;
+      }
+
+      case '{':
+      {
+        if (!(frame = DecoderStack_push(ds, &stack, TRUE)))
+        {
+          goto ERROR;
+        }
 
-      case '[': return decode_array (ds);
-      case '{': return decode_object (ds);
-      case 't': return decode_true (ds);
-      case 'f': return decode_false (ds);
-      case 'n': return decode_null (ds);
+        frame->base = values.count;
+        if (!buffered)
+        {
+          frame->obj = ds->dec->newObject(ds->prv);
+        }
+        ds->start ++;
+        goto KEY;
+      }
 
       case ' ':
       case '\t':
       case '\r':
       case '\n':
         // White space
-        ds->start ++;
-        break;
+        SkipWhitespace(ds);
+        continue;
 
       default:
-        return SetError(ds, -1, "Expected object or value");
+        SetError(ds, -1, "Expected object or value");
+        goto ERROR;
     }
+
+    if (value == NULL)
+    {
+      goto ERROR;
+    }
+    break;
   }
-}
 
-JSOBJ JSON_DecodeObject(JSONObjectDecoder *dec, const char *buffer, size_t cbBuffer)
-{
-  /*
-  FIXME: Base the size of escBuffer of that of cbBuffer so that the unicode escaping doesn't run into the wall each time */
-  struct DecoderState ds;
-  wchar_t escBuffer[(JSON_MAX_STACK_BUFFER_SIZE / sizeof(wchar_t))];
-  JSOBJ ret;
+ADD_VALUE:
+  // frame is the innermost open container, NULL at the top level
+  if (frame == NULL)
+  {
+    if (stack.heap)
+    {
+      ds->dec->free(stack.frames);
+    }
+    if (values.heap)
+    {
+      ds->dec->free(values.values);
+    }
+    return value;
+  }
 
-  ds.start = (char *) buffer;
-  ds.end = ds.start + cbBuffer;
+  SkipWhitespace(ds);
 
-  ds.escStart = escBuffer;
-  ds.escEnd = ds.escStart + (JSON_MAX_STACK_BUFFER_SIZE / sizeof(wchar_t));
-  ds.escHeap = 0;
+  if (frame->isObject)
+  {
+    if (frame->records)
+    {
+      // ds stands in for a number left in it by DecodeRecordNumber
+      if (value == (JSOBJ) ds)
+      {
+        pushed = ds->addField(ds->prv, ds->row, frame->name, ds->numberType, NULL,
+                              ds->numberType == JT_LONG ? (const void *) &ds->numberLong : (const void *) &ds->numberDouble);
+      }
+      else
+      {
+        pushed = ds->addField(ds->prv, ds->row, frame->name, JT_INVALID, value, NULL);
+      }
+      frame->name = NULL;
+
+      if (!pushed)
+      {
+        goto ERROR;
+      }
+    }
+    else
+    if (buffered)
+    {
+      pushed = ValueStack_push(ds, &values, frame->name);
+      frame->name = NULL;
+
+      if (!pushed)
+      {
+        ds->dec->releaseObject(ds->prv, value);
+        goto ERROR;
+      }
+
+      if (!ValueStack_push(ds, &values, value))
+      {
+        goto ERROR;
+      }
+    }
+    else
+    {
+      ds->dec->objectAddKey (ds->prv, frame->obj, frame->name, value);
+      frame->name = NULL;
+    }
+
+    switch (*(ds->start++))
+    {
+      case '}': goto CLOSE;
+      case ',': goto KEY;
+
+      default:
+        SetError(ds, -1, "Unexpected character in found when decoding object value");
+        goto ERROR;
+    }
+  }
+
+  if (frame->records)
+  {
+    // A record was closed, its fields went to addField
+    ds->row ++;
+  }
+  else
+  if (!buffered)
+  {
+    ds->dec->arrayAddItem (ds->prv, frame->obj, value);
+  }
+  else
+  if (!ValueStack_push(ds, &values, value))
+  {
+    goto ERROR;
+  }
+
+  switch (*(ds->start++))
+  {
+    case ']': goto CLOSE;
+    case ',':
+    {
+      SkipWhitespace(ds);
+
+      if ((*ds->start) == ']')
+      {
+        SetError(ds, -1, "Unexpected character found when decoding array value (1)");
+        goto ERROR;
+      }
+
+      if (frame->records)
+      {
+        goto RECORD;
+      }
+
+      ds->projection = frame->projection;
+      goto VALUE;
+    }
+
+    default:
+      SetError(ds, -1, "Unexpected character found when decoding array value (2)");
+      goto ERROR;
+  }
+
+CLOSE:
+  value = frame->obj;
+  frame->obj = NULL;
+
+  if (frame->records)
+  {
+    // Records and their array aren't made, ds stands in for them
+    value = (JSOBJ) ds;
+  }
+  else
+  // When buffered only arrays of numbers are made up front, the rest are made here from the value stack
+  if (buffered && !value)
+  {
+    count = values.count - frame->base;
+    values.count = frame->base;
+
+    if (frame->isObject)
+    {
+      value = ds->dec->endObject(ds->prv, values.values + frame->base, count / 2);
+    }
+    else
+    {
+      value = ds->dec->endArray(ds->prv, values.values + frame->base, count);
+    }
+
+    if (!value)
+    {
+      SetError(ds, -1, "Could not reserve memory block");
+      goto ERROR;
+    }
+  }
+
+  frame = --stack.depth ? frame - 1 : NULL;
+  goto ADD_VALUE;
+
+KEY:
+  // A '}' is accepted right after a ',' as well
+  SkipWhitespace(ds);
+
+  if ((*ds->start) == '}')
+  {
+    ds->start ++;
+    goto CLOSE;
+  }
+
+  if ((*ds->start) != '\"')
+  {
+    SetError(ds, -1, "Key name of object must be 'string' when decoding 'object'");
+    goto ERROR;
+  }
+
+  ds->lastType = JT_INVALID;
+
+  if (frame->projection)
+  {
+    int skipped = FALSE;
+
+    if (!(frame->name = DecodeProjectedKey(ds, frame->projection, &skipped)))
+    {
+      if (!skipped)
+      {
+        goto ERROR;
+      }
+
+      SkipWhitespace(ds);
+
+      switch (*(ds->start++))
+      {
+        case '}': goto CLOSE;
+        case ',': goto KEY;
+
+        default:
+          SetError(ds, -1, "Unexpected character in found when decoding object value");
+          goto ERROR;
+      }
+    }
+  }
+  else
+  {
+    frame->name = ds->dec->newKeyUTF8 ? decode_string_utf8(ds, ds->dec->newKeyUTF8) : decode_string(ds);
+  }
+
+  if (frame->name == NULL)
+  {
+    goto ERROR;
+  }
+
+  SkipWhitespace(ds);
+
+  if (*(ds->start++) != ':')
+  {
+    SetError(ds, -1, "No ':' found when decoding object value");
+    goto ERROR;
+  }
+
+  if (frame->records)
+  {
+    SkipWhitespace(ds);
+
+    if (*ds->start == '-' || (*ds->start >= '0' && *ds->start <= '9'))
+    {
+      if (!(value = DecodeRecordNumber(ds)))
+      {
+        goto ERROR;
+      }
+      goto ADD_VALUE;
+    }
+  }
+  goto VALUE;
+
+RECORD:
+  // The elements of the records array must be objects, they're decoded like others but their fields go to addField
+  if ((*ds->start) != '{')
+  {
+    SetError(ds, -1, "Expected object when decoding record");
+    goto ERROR;
+  }
+
+  if (!(frame = DecoderStack_push(ds, &stack, TRUE)))
+  {
+    goto ERROR;
+  }
+
+  frame->records = TRUE;
+  ds->start ++;
+  goto KEY;
+
+ERROR:
+  DecoderStack_release(ds, &stack);
+  ValueStack_release(ds, &values);
+  return NULL;
+}
+
+/*
+Decodes the document between ds->start and ds->end, which must be followed by a '\0' */
+static JSOBJ DecodeDocument(struct DecoderState *ds)
+{
+  JSONObjectDecoder *dec = ds->dec;
+  JSOBJ ret;
+
+  dec->errorStr = NULL;
+  dec->errorOffset = NULL;
+  ds->projection = dec->projection;
+
+  ret = decode_any (ds);
+
+  if (!(dec->errorStr))
+  {
+    if ((ds->end - ds->start) > 0)
+    {
+      SkipWhitespace(ds);
+    }
+
+    if (ds->start != ds->end && ret)
+    {
+      dec->releaseObject(ds->prv, ret);
+      return SetError(ds, -1, "Trailing data");
+    }
+  }
+
+  return ret;
+}
+
+JSOBJ JSON_DecodeObject(JSONObjectDecoder *dec, const char *buffer, size_t cbBuffer)
+{
+  struct DecoderState ds;
+  wchar_t escBuffer[(JSON_MAX_STACK_BUFFER_SIZE / sizeof(wchar_t))];
+  JSOBJ ret;
+
+  ds.start = (char *) buffer;
+  ds.end = ds.start + cbBuffer;
+
+  if (dec->escBuffer)
+  {
+    ds.escStart = dec->escBuffer;
+    ds.escEnd = ds.escStart + dec->escBufferLength;
+    ds.escHeap = 1;
+  }
+  else
+  {
+    ds.escStart = escBuffer;
+    ds.escEnd = ds.escStart + (JSON_MAX_STACK_BUFFER_SIZE / sizeof(wchar_t));
+    ds.escHeap = 0;
+  }
   ds.prv = dec->prv;
   ds.dec = dec;
-  ds.dec->errorStr = NULL;
-  ds.dec->errorOffset = NULL;
-  ds.objDepth = 0;
+  ds.maxDepth = dec->maxDepth ? dec->maxDepth : JSON_MAX_OBJECT_DEPTH;
+  ds.rawNumbers = FALSE;
+  ds.addField = NULL;
+
+  ret = DecodeDocument(&ds);
+
+  if (dec->escBuffer)
+  {
+    dec->escBuffer = ds.escStart;
+    dec->escBufferLength = ds.escEnd - ds.escStart;
+  }
+  else
+  if (ds.escHeap)
+  {
+    dec->free(ds.escStart);
+  }
+
+  return ret;
+}
+
+int JSON_DecodeLines(JSONObjectDecoder *dec, const char *buffer, size_t cbBuffer, JSPFN_ADDLINE addLine)
+{
+  struct DecoderState ds;
+  wchar_t escBuffer[(JSON_MAX_STACK_BUFFER_SIZE / sizeof(wchar_t))];
+  const char *lineStart = buffer;
+  const char *lineEnd;
+  const char *end = buffer + cbBuffer;
+  const char *offset;
+  // Lines are copied here to get the '\0' the decoder stops at
+  char *lineBuffer = NULL;
+  size_t lineCapacity = 0;
+  size_t lineLength;
+  size_t line = 0;
+  int ok = TRUE;
 
+  ds.escStart = escBuffer;
+  ds.escEnd = ds.escStart + (JSON_MAX_STACK_BUFFER_SIZE / sizeof(wchar_t));
+  ds.escHeap = 0;
+  ds.prv = dec->prv;
   ds.dec = dec;
+  ds.maxDepth = dec->maxDepth ? dec->maxDepth : JSON_MAX_OBJECT_DEPTH;
+  ds.rawNumbers = FALSE;
+  ds.addField = NULL;
+
+  for (; ok && lineStart < end; lineStart = lineEnd + 1)
+  {
+    JSOBJ obj;
+
+    if (!(lineEnd = (const char *) memchr(lineStart, '\n', end - lineStart)))
+    {
+      lineEnd = end;
+    }
+
+    line ++;
+
+    for (offset = lineStart; offset < lineEnd && (*offset == ' ' || *offset == '\t' || *offset == '\r'); offset ++);
+
+    if (offset == lineEnd)
+    {
+      continue;
+    }
+
+    lineLength = (size_t) (lineEnd - lineStart);
+
+    if (lineLength >= lineCapacity)
+    {
+      char *newBuffer = (char *) (lineBuffer ? dec->realloc(lineBuffer, lineLength * 2 + 1) : dec->malloc(lineLength * 2 + 1));
+
+      if (!newBuffer)
+      {
+        dec->errorStr = (char *) "Could not reserve memory block";
+        dec->errorOffset = (char *) lineStart;
+        ok = FALSE;
+        break;
+      }
+
+      lineBuffer = newBuffer;
+      lineCapacity = lineLength * 2 + 1;
+    }
+
+    memcpy(lineBuffer, lineStart, lineLength);
+    lineBuffer[lineLength] = '\0';
+
+    ds.start = lineBuffer;
+    ds.end = lineBuffer + lineLength;
+
+    obj = DecodeDocument(&ds);
 
-  ret = decode_any (&ds);
+    if (dec->errorStr)
+    {
+      // Point into the input rather than the copy
+      dec->errorOffset = (char *) lineStart + (dec->errorOffset - lineBuffer);
+    }
+
+    ok = addLine(ds.prv, obj, line);
+  }
 
   if (ds.escHeap)
   {
     dec->free(ds.escStart);
   }
 
-  if (!(dec->errorStr))
+  if (lineBuffer)
+  {
+    dec->free(lineBuffer);
+  }
+
+  return ok;
+}
+
+int JSON_DecodeRecords(JSONObjectDecoder *dec, const char *buffer, size_t cbBuffer, JSPFN_ADDFIELD addField, size_t *prows)
+{
+  struct DecoderState ds;
+  wchar_t escBuffer[(JSON_MAX_STACK_BUFFER_SIZE / sizeof(wchar_t))];
+  int ok = FALSE;
+
+  ds.start = (char *) buffer;
+  ds.end = ds.start + cbBuffer;
+  ds.escStart = escBuffer;
+  ds.escEnd = ds.escStart + (JSON_MAX_STACK_BUFFER_SIZE / sizeof(wchar_t));
+  ds.escHeap = 0;
+  ds.prv = dec->prv;
+  ds.dec = dec;
+  ds.maxDepth = dec->maxDepth ? dec->maxDepth : JSON_MAX_OBJECT_DEPTH;
+  ds.projection = NULL;
+  ds.rawNumbers = FALSE;
+  ds.addField = addField;
+  ds.row = 0;
+  dec->errorStr = NULL;
+  dec->errorOffset = NULL;
+
+  SkipWhitespace(&ds);
+
+  // decode_any hands the fields to addField once it's inside the array and returns ds for it
+  if (*ds.start != '[')
+  {
+    SetError(&ds, -1, "Expected array of objects when decoding records");
+  }
+  else
+  if (decode_any(&ds))
   {
-    if ((ds.end - ds.start) > 0)
+    SkipWhitespace(&ds);
+
+    if (ds.start != ds.end)
+    {
+      SetError(&ds, -1, "Trailing data");
+    }
+    else
     {
-      SkipWhitespace(&ds);
+      ok = TRUE;
     }
+  }
+
+  if (ds.escHeap)
+  {
+    dec->free(ds.escStart);
+  }
+
+  *prows = ds.row;
+  return ok;
+}
+
+/*
+Second decoder engine, in the style of simdjson. Stage 1 makes a single branch-light pass over the input
+and records the offset of every token: the structural characters {}[]:, outside strings, the opening quote
+of each string and the first character of each other scalar. Stage 2 walks that index with an explicit
+container stack, using the same scalar decoders and callbacks as decode_any, so both engines build the same
+objects and fail on the same input */
+
+/*
+Per 64 byte block masks of the characters stage 1 is interested in, bit n is byte n */
+struct BlockMasks
+{
+  JSUINT64 quote;
+  JSUINT64 backslash;
+  JSUINT64 structural;
+  JSUINT64 whitespace;
+};
+
+static FASTCALL_ATTR INLINE_PREFIX void FASTCALL_MSVC BuildBlockMasks(const JSUINT8 *block, struct BlockMasks *masks)
+{
+#ifdef JSON_DECODE_SSE2
+  int index;
+
+  masks->quote = masks->backslash = masks->structural = masks->whitespace = 0;
+
+  for (index = 0; index < 64; index += 16)
+  {
+    __m128i chunk = _mm_loadu_si128((const __m128i *) (block + index));
+    // '[' and ']' are '{' and '}' without the 0x20 bit
+    __m128i folded = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+    __m128i structural = _mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{')), _mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))),
+      _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(':')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8(','))));
+    __m128i whitespace = _mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))),
+      _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'))));
+
+    masks->quote |= (JSUINT64) (JSUINT32) _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\"'))) << index;
+    masks->backslash |= (JSUINT64) (JSUINT32) _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\'))) << index;
+    masks->structural |= (JSUINT64) (JSUINT32) _mm_movemask_epi8(structural) << index;
+    masks->whitespace |= (JSUINT64) (JSUINT32) _mm_movemask_epi8(whitespace) << index;
+  }
+#else
+  int index;
+
+  masks->quote = masks->backslash = masks->structural = masks->whitespace = 0;
 
-    if (ds.start != ds.end && ret)
+  for (index = 0; index < 64; index ++)
+  {
+    JSUINT64 bit = 1ULL << index;
+
+    switch (block[index])
     {
-      dec->releaseObject(ds.prv, ret);
-      return SetError(&ds, -1, "Trailing data");
+      case '\"': masks->quote |= bit; break;
+      case '\\': masks->backslash |= bit; break;
+      case '{': case '}': case '[': case ']': case ':': case ',': masks->structural |= bit; break;
+      case ' ': case '\t': case '\r': case '\n': masks->whitespace |= bit; break;
     }
   }
+#endif
+}
+
+/*
+Characters preceded by an odd number of backslashes. *pcarry tells whether the first character of the block
+is escaped by the end of the previous one */
+static FASTCALL_ATTR INLINE_PREFIX JSUINT64 FASTCALL_MSVC FindEscaped(JSUINT64 backslash, JSUINT64 *pcarry)
+{
+  const JSUINT64 evenBits = 0x5555555555555555ULL;
+  JSUINT64 followsEscape;
+  JSUINT64 oddStarts;
+  JSUINT64 evenStarts;
+
+  backslash &= ~*pcarry;
+  followsEscape = (backslash << 1) | *pcarry;
+  oddStarts = backslash & ~evenBits & ~followsEscape;
+
+  // Adding a run's start to the run carries past its end, the parity of the end position gives the run length
+  evenStarts = oddStarts + backslash;
+  *pcarry = evenStarts < oddStarts;
+
+  return (evenBits ^ (evenStarts << 1)) & followsEscape;
+}
+
+/*
+Stage 1. Fills positions with the offset of every token and ends it with cbBuffer. positions needs room
+for cbBuffer + 1 entries. Returns the number of tokens */
+static size_t BuildStructuralIndex(const char *buffer, size_t cbBuffer, JSUINT32 *positions)
+{
+  JSUINT8 tail[64];
+  const JSUINT8 *block;
+  struct BlockMasks masks;
+  JSUINT64 escapeCarry = 0;
+  JSUINT64 inStringCarry = 0;
+  JSUINT64 scalarCarry = 0;
+  JSUINT64 quotes;
+  JSUINT64 inString;
+  JSUINT64 scalar;
+  JSUINT64 tokens;
+  size_t count = 0;
+  size_t offset;
+
+  for (offset = 0; offset < cbBuffer; offset += 64)
+  {
+    if (cbBuffer - offset >= 64)
+    {
+      block = (const JSUINT8 *) buffer + offset;
+    }
+    else
+    {
+      memset(tail, ' ', sizeof(tail));
+      memcpy(tail, buffer + offset, cbBuffer - offset);
+      block = tail;
+    }
+
+    BuildBlockMasks(block, &masks);
+
+    quotes = masks.quote & ~FindEscaped(masks.backslash, &escapeCarry);
+
+    // Prefix xor of the quotes, set from an opening quote up to but not including its closing quote
+    inString = quotes;
+    inString ^= inString << 1;
+    inString ^= inString << 2;
+    inString ^= inString << 4;
+    inString ^= inString << 8;
+    inString ^= inString << 16;
+    inString ^= inString << 32;
+    inString ^= inStringCarry;
+    inStringCarry = (JSUINT64) ((JSINT64) inString >> 63);
+
+    scalar = ~(masks.structural | masks.whitespace | quotes | inString);
+    tokens = (masks.structural & ~inString) | (quotes & inString) | (scalar & ~((scalar << 1) | scalarCarry));
+    scalarCarry = scalar >> 63;
+
+    while (tokens)
+    {
+      positions[count++] = (JSUINT32) (offset + CountTrailingZeros64(tokens));
+      tokens &= tokens - 1;
+    }
+  }
+
+  positions[count] = (JSUINT32) cbBuffer;
+  return count;
+}
+
+static JSOBJ decode_scalar(struct DecoderState *ds)
+{
+  switch (*ds->start)
+  {
+    case '\"':
+      return decode_string (ds);
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7':
+    case '8':
+    case '9':
+    case '-':
+      return decode_numeric (ds);
+
+    case 't': return decode_true (ds);
+    case 'f': return decode_false (ds);
+    case 'n': return decode_null (ds);
+
+    default:
+      return SetError(ds, -1, "Expected object or value");
+  }
+}
+
+/*
+Stage 2 */
+static JSOBJ decode_indexed(struct DecoderState *ds, const JSUINT32 *positions, size_t count)
+{
+  struct DecoderStack stack;
+  struct DecoderFrame *frame = NULL;
+  char *buffer = ds->start;
+  JSOBJ value;
+  size_t index = 0;
+
+  DecoderStack_init(&stack);
+
+  if (count == 0)
+  {
+    return SetError(ds, -1, "Expected object or value");
+  }
+
+VALUE:
+  ds->start = buffer + positions[index];
+
+  switch (*ds->start)
+  {
+    case '[':
+    {
+      if (!(frame = DecoderStack_push(ds, &stack, FALSE)))
+      {
+        goto ERROR;
+      }
+
+      frame->obj = ds->dec->newArray(ds->prv);
+      ds->start = buffer + positions[++index];
+
+      if (*ds->start == ']')
+      {
+        index ++;
+        goto CLOSE;
+      }
+      goto VALUE;
+    }
+
+    case '{':
+    {
+      if (!(frame = DecoderStack_push(ds, &stack, TRUE)))
+      {
+        goto ERROR;
+      }
+
+      frame->obj = ds->dec->newObject(ds->prv);
+      index ++;
+      goto KEY;
+    }
+
+    default:
+    {
+      ds->lastType = JT_INVALID;
+      value = decode_scalar(ds);
+
+      if (value == NULL)
+      {
+        goto ERROR;
+      }
+
+      // Scalars must run up to the next token, e.g. "12ab" leaves a pseudo token at 'a'
+      SkipWhitespace(ds);
+      if (ds->start != buffer + positions[++index])
+      {
+        ds->dec->releaseObject(ds->prv, value);
+        SetError(ds, -1, "Unexpected character found after value");
+        goto ERROR;
+      }
+      goto ADD_VALUE;
+    }
+  }
+
+ADD_VALUE:
+  if (stack.depth == 0)
+  {
+    if (index != count)
+    {
+      ds->start = buffer + positions[index] + 1;
+      ds->dec->releaseObject(ds->prv, value);
+      SetError(ds, -1, "Trailing data");
+      goto ERROR;
+    }
+
+    if (stack.heap)
+    {
+      ds->dec->free(stack.frames);
+    }
+    ds->start = buffer + positions[count];
+    return value;
+  }
+
+  frame = &stack.frames[stack.depth - 1];
+  ds->start = buffer + positions[index] + 1;
+
+  if (frame->isObject)
+  {
+    ds->dec->objectAddKey(ds->prv, frame->obj, frame->name, value);
+    frame->name = NULL;
+
+    switch (buffer[positions[index++]])
+    {
+      case ',': goto KEY;
+      case '}': goto CLOSE;
+      default:
+        SetError(ds, -1, "Unexpected character in found when decoding object value");
+        goto ERROR;
+    }
+  }
+
+  ds->dec->arrayAddItem(ds->prv, frame->obj, value);
+
+  switch (buffer[positions[index++]])
+  {
+    case ',':
+    {
+      if (buffer[positions[index]] == ']')
+      {
+        ds->start = buffer + positions[index] + 1;
+        SetError(ds, -1, "Unexpected character found when decoding array value (1)");
+        goto ERROR;
+      }
+      goto VALUE;
+    }
+    case ']': goto CLOSE;
+    default:
+      SetError(ds, -1, "Unexpected character found when decoding array value (2)");
+      goto ERROR;
+  }
+
+CLOSE:
+  value = frame->obj;
+  frame->obj = NULL;
+  stack.depth --;
+  goto ADD_VALUE;
+
+KEY:
+  // Like decode_any a '}' is accepted right after a ','
+  ds->start = buffer + positions[index];
+
+  if (*ds->start == '}')
+  {
+    index ++;
+    goto CLOSE;
+  }
+
+  if (*ds->start != '\"')
+  {
+    ds->start ++;
+    SetError(ds, -1, "Key name of object must be 'string' when decoding 'object'");
+    goto ERROR;
+  }
+
+  ds->lastType = JT_INVALID;
+  frame->name = ds->dec->newKeyUTF8 ? decode_string_utf8(ds, ds->dec->newKeyUTF8) : decode_string(ds);
+
+  if (frame->name == NULL)
+  {
+    goto ERROR;
+  }
+
+  SkipWhitespace(ds);
+  if (ds->start != buffer + positions[++index] || *ds->start != ':')
+  {
+    ds->start ++;
+    SetError(ds, -1, "No ':' found when decoding object value");
+    goto ERROR;
+  }
+
+  index ++;
+  goto VALUE;
+
+ERROR:
+  DecoderStack_release(ds, &stack);
+  return NULL;
+}
+
+JSOBJ JSON_DecodeObjectIndexed(JSONObjectDecoder *dec, const char *buffer, size_t cbBuffer)
+{
+  struct DecoderState ds;
+  wchar_t escBuffer[(JSON_MAX_STACK_BUFFER_SIZE / sizeof(wchar_t))];
+  JSUINT32 *positions;
+  size_t count;
+  JSOBJ ret;
+
+  ds.start = (char *) buffer;
+  ds.end = ds.start + cbBuffer;
+
+  ds.escStart = escBuffer;
+  ds.escEnd = ds.escStart + (JSON_MAX_STACK_BUFFER_SIZE / sizeof(wchar_t));
+  ds.escHeap = 0;
+  ds.prv = dec->prv;
+  ds.dec = dec;
+  ds.dec->errorStr = NULL;
+  ds.dec->errorOffset = NULL;
+  ds.maxDepth = dec->maxDepth ? dec->maxDepth : JSON_MAX_OBJECT_DEPTH;
+  ds.projection = NULL;
+  ds.rawNumbers = FALSE;
+  ds.addField = NULL;
+
+  if (cbBuffer >= 0xffffffffU)
+  {
+    return SetError(&ds, -1, "Input too large for the structural index");
+  }
+
+  positions = (JSUINT32 *) dec->malloc((cbBuffer + 1) * sizeof(JSUINT32));
+
+  if (!positions)
+  {
+    return SetError(&ds, -1, "Could not reserve memory block");
+  }
+
+  count = BuildStructuralIndex(buffer, cbBuffer, positions);
+  ret = decode_indexed(&ds, positions, count);
+
+  dec->free(positions);
+
+  if (ds.escHeap)
+  {
+    dec->free(ds.escStart);
+  }
 
   return ret;
 }
+
+/*
+Push decoder. The input arrives in chunks, so instead of scanning ahead the decoder keeps the state of the
+grammar between feeds along with the container stack. Structural characters are a single byte and handled
+as they come. Strings and other scalars are decoded in place by the regular decoders when they end inside
+the chunk, those that run into the end of the chunk are collected in a carry buffer and decoded from there
+once complete. Memory use is bounded by the nesting depth and the longest single token */
+
+enum PUSH_STATES
+{
+  PS_VALUE,           // Any value
+  PS_VALUE_OR_CLOSE,  // After '['
+  PS_ARRAY_VALUE,     // After ',' in an array
+  PS_KEY_OR_CLOSE,    // After '{' or ',' in an object
+  PS_COLON,
+  PS_AFTER_VALUE,
+  PS_DONE
+};
+
+enum PUSH_TOKENS
+{
+  PT_NONE,
+  PT_STRING,
+  PT_SCALAR
+};
+
+struct __JSONPushDecoder
+{
+  struct DecoderState ds;
+  struct DecoderStack stack;
+  struct DecoderFrame *frame;
+  int state;
+  int token;
+  int escaped;
+  int failed;
+  char *carry;
+  size_t carryLength;
+  size_t carryCapacity;
+  JSOBJ ret;
+};
+
+/*
+Finds the closing quote of a string in [start, end). *pescaped says whether start is preceded by an
+unpaired backslash, it's updated for the end of the range when there's no closing quote and NULL is
+returned */
+static const char *FindStringEnd(const char *start, const char *end, int *pescaped)
+{
+  const char *scan = start;
+  const char *quote;
+  const char *run;
+
+  for (;;)
+  {
+    quote = (const char *) memchr(scan, '\"', end - scan);
+    run = quote ? quote : end;
+
+    while (run > start && run[-1] == '\\')
+    {
+      run --;
+    }
+
+    // A run of backslashes reaching start is one longer if the first one is escaped by the previous range
+    if (((quote ? quote : end) - run + (run == start && *pescaped)) & 1)
+    {
+      if (!quote)
+      {
+        *pescaped = TRUE;
+        return NULL;
+      }
+      scan = quote + 1;
+      continue;
+    }
+
+    if (!quote)
+    {
+      *pescaped = FALSE;
+    }
+    return quote;
+  }
+}
+
+static const char *FindScalarEnd(const char *start, const char *end)
+{
+  for (; start < end; start ++)
+  {
+    switch (*start)
+    {
+      case ' ': case '\t': case '\r': case '\n':
+      case '{': case '}': case '[': case ']': case ':': case ',': case '\"':
+        return start;
+    }
+  }
+  return end;
+}
+
+static int PushDecoder_carry(JSONPushDecoder *pd, const char *start, const char *end)
+{
+  size_t length = (size_t) (end - start);
+  char *carry;
+
+  if (pd->carryLength + length + 1 > pd->carryCapacity)
+  {
+    size_t newCapacity = pd->carryCapacity ? pd->carryCapacity : 256;
+
+    while (newCapacity < pd->carryLength + length + 1)
+    {
+      newCapacity *= 2;
+    }
+
+    carry = (char *) (pd->carry ? pd->ds.dec->realloc(pd->carry, newCapacity) : pd->ds.dec->malloc(newCapacity));
+    if (!carry)
+    {
+      SetError(&pd->ds, -1, "Could not reserve memory block");
+      return FALSE;
+    }
+
+    pd->carry = carry;
+    pd->carryCapacity = newCapacity;
+  }
+
+  memcpy(pd->carry + pd->carryLength, start, length);
+  pd->carryLength += length;
+  pd->carry[pd->carryLength] = '\0';
+  return TRUE;
+}
+
+static int PushDecoder_addValue(JSONPushDecoder *pd, JSOBJ value)
+{
+  struct DecoderFrame *frame = pd->frame;
+
+  if (frame == NULL)
+  {
+    pd->ret = value;
+    pd->state = PS_DONE;
+    return TRUE;
+  }
+
+  if (frame->isObject)
+  {
+    pd->ds.dec->objectAddKey(pd->ds.prv, frame->obj, frame->name, value);
+    frame->name = NULL;
+  }
+  else
+  {
+    pd->ds.dec->arrayAddItem(pd->ds.prv, frame->obj, value);
+  }
+
+  pd->state = PS_AFTER_VALUE;
+  return TRUE;
+}
+
+static int PushDecoder_close(JSONPushDecoder *pd)
+{
+  JSOBJ value = pd->frame->obj;
+
+  pd->frame->obj = NULL;
+  pd->frame = --pd->stack.depth ? pd->frame - 1 : NULL;
+  return PushDecoder_addValue(pd, value);
+}
+
+static int PushDecoder_open(JSONPushDecoder *pd, int isObject)
+{
+  struct DecoderFrame *frame = DecoderStack_push(&pd->ds, &pd->stack, isObject);
+
+  if (!frame)
+  {
+    return FALSE;
+  }
+
+  frame->obj = isObject ? pd->ds.dec->newObject(pd->ds.prv) : pd->ds.dec->newArray(pd->ds.prv);
+  pd->frame = frame;
+  pd->state = isObject ? PS_KEY_OR_CLOSE : PS_VALUE_OR_CLOSE;
+  return TRUE;
+}
+
+/*
+Handles the character at offset, which doesn't start a token. At the end of the input it is '\0'. The errors are the
+ones decode_any reports for the same input */
+static int PushDecoder_structural(JSONPushDecoder *pd, const char *offset)
+{
+  pd->ds.start = (char *) offset + 1;
+
+  switch (pd->state)
+  {
+    case PS_VALUE:
+    case PS_VALUE_OR_CLOSE:
+    case PS_ARRAY_VALUE:
+    {
+      switch (*offset)
+      {
+        case '[': return PushDecoder_open(pd, FALSE);
+        case '{': return PushDecoder_open(pd, TRUE);
+        case ']':
+        {
+          if (pd->state == PS_VALUE_OR_CLOSE)
+          {
+            return PushDecoder_close(pd);
+          }
+          if (pd->state == PS_ARRAY_VALUE)
+          {
+            SetError(&pd->ds, -1, "Unexpected character found when decoding array value (1)");
+            return FALSE;
+          }
+          break;
+        }
+      }
+
+      SetError(&pd->ds, -1, "Expected object or value");
+      return FALSE;
+    }
+
+    case PS_KEY_OR_CLOSE:
+    {
+      if (*offset == '}')
+      {
+        return PushDecoder_close(pd);
+      }
+
+      SetError(&pd->ds, -1, "Key name of object must be 'string' when decoding 'object'");
+      return FALSE;
+    }
+
+    case PS_COLON:
+    {
+      if (*offset == ':')
+      {
+        pd->state = PS_VALUE;
+        return TRUE;
+      }
+
+      SetError(&pd->ds, -1, "No ':' found when decoding object value");
+      return FALSE;
+    }
+
+    case PS_AFTER_VALUE:
+    {
+      if (pd->frame->isObject)
+      {
+        switch (*offset)
+        {
+          case ',': pd->state = PS_KEY_OR_CLOSE; return TRUE;
+          case '}': return PushDecoder_close(pd);
+        }
+
+        SetError(&pd->ds, -1, "Unexpected character in found when decoding object value");
+        return FALSE;
+      }
+
+      switch (*offset)
+      {
+        case ',': pd->state = PS_ARRAY_VALUE; return TRUE;
+        case ']': return PushDecoder_close(pd);
+      }
+
+      SetError(&pd->ds, -1, "Unexpected character found when decoding array value (2)");
+      return FALSE;
+    }
+
+    default:
+    {
+      SetError(&pd->ds, -1, "Trailing data");
+      return FALSE;
+    }
+  }
+}
+
+/*
+Decodes the complete token in [start, end), the byte at end must be readable and not part of it. Returns
+where decoding stopped or NULL on error, anything left of the token is handed to PushDecoder_structural
+by the caller so it fails the way decode_any would */
+static const char *PushDecoder_decodeToken(JSONPushDecoder *pd, const char *start, const char *end)
+{
+  struct DecoderState *ds = &pd->ds;
+  JSOBJ value;
+
+  ds->start = (char *) start;
+  ds->end = (char *) end;
+  ds->lastType = JT_INVALID;
+
+  if (pd->state == PS_KEY_OR_CLOSE)
+  {
+    pd->frame->name = ds->dec->newKeyUTF8 ? decode_string_utf8(ds, ds->dec->newKeyUTF8) : decode_string(ds);
+
+    if (pd->frame->name == NULL)
+    {
+      return NULL;
+    }
+
+    pd->state = PS_COLON;
+    return ds->start;
+  }
+
+  value = decode_scalar(ds);
+
+  if (value == NULL || !PushDecoder_addValue(pd, value))
+  {
+    return NULL;
+  }
+
+  return ds->start;
+}
+
+/*
+Decodes the token that was carried over, which is complete. Returns FALSE on error */
+static int PushDecoder_decodeCarry(JSONPushDecoder *pd)
+{
+  const char *stop;
+
+  pd->token = PT_NONE;
+  stop = PushDecoder_decodeToken(pd, pd->carry, pd->carry + pd->carryLength);
+
+  if (stop == NULL)
+  {
+    return FALSE;
+  }
+
+  // What's left of the token is unexpected in any state, e.g. "ab" after a number in "12ab"
+  return stop == pd->carry + pd->carryLength || PushDecoder_structural(pd, stop);
+}
+
+/*
+Starts the token at offset, either decoding it right away or carrying it over to the next feed. Returns
+where to continue or NULL on error */
+static const char *PushDecoder_startToken(JSONPushDecoder *pd, const char *offset, const char *end)
+{
+  const char *tokenEnd;
+
+  pd->escaped = FALSE;
+
+  if (*offset == '\"')
+  {
+    // A string can be decoded in place even if its closing quote is the last byte of the chunk
+    tokenEnd = FindStringEnd(offset + 1, end, &pd->escaped);
+    if (tokenEnd)
+    {
+      return PushDecoder_decodeToken(pd, offset, tokenEnd + 1);
+    }
+    pd->token = PT_STRING;
+  }
+  else
+  {
+    // Scalar decoders look at the byte after the token
+    tokenEnd = FindScalarEnd(offset, end);
+    if (tokenEnd < end)
+    {
+      return PushDecoder_decodeToken(pd, offset, tokenEnd);
+    }
+    pd->token = PT_SCALAR;
+  }
+
+  pd->carryLength = 0;
+  return PushDecoder_carry(pd, offset, end) ? end : NULL;
+}
+
+/*
+Adds the start of the next chunk to the carried token, and decodes it once complete. Returns where to
+continue or NULL on error */
+static const char *PushDecoder_continueToken(JSONPushDecoder *pd, const char *offset, const char *end)
+{
+  const char *tokenEnd;
+  int complete;
+
+  if (pd->token == PT_STRING)
+  {
+    tokenEnd = FindStringEnd(offset, end, &pd->escaped);
+    complete = tokenEnd != NULL;
+    tokenEnd = complete ? tokenEnd + 1 : end;
+  }
+  else
+  {
+    tokenEnd = FindScalarEnd(offset, end);
+    complete = tokenEnd < end;
+  }
+
+  if (!PushDecoder_carry(pd, offset, tokenEnd))
+  {
+    return NULL;
+  }
+
+  if (complete && !PushDecoder_decodeCarry(pd))
+  {
+    return NULL;
+  }
+
+  return tokenEnd;
+}
+
+JSONPushDecoder *JSON_DecoderInit(JSONObjectDecoder *dec)
+{
+  JSONPushDecoder *pd = (JSONPushDecoder *) dec->malloc(sizeof(JSONPushDecoder));
+
+  dec->errorStr = NULL;
+  dec->errorOffset = NULL;
+
+  if (!pd)
+  {
+    dec->errorStr = (char *) "Could not reserve memory block";
+    return NULL;
+  }
+
+  memset(&pd->ds, 0, sizeof(pd->ds));
+  if (dec->escBuffer)
+  {
+    pd->ds.escStart = dec->escBuffer;
+    pd->ds.escEnd = pd->ds.escStart + dec->escBufferLength;
+    pd->ds.escHeap = 1;
+  }
+  pd->ds.prv = dec->prv;
+  pd->ds.dec = dec;
+  pd->ds.maxDepth = dec->maxDepth ? dec->maxDepth : JSON_MAX_OBJECT_DEPTH;
+
+  DecoderStack_init(&pd->stack);
+  pd->frame = NULL;
+  pd->state = PS_VALUE;
+  pd->token = PT_NONE;
+  pd->escaped = FALSE;
+  pd->failed = FALSE;
+  pd->carry = NULL;
+  pd->carryLength = 0;
+  pd->carryCapacity = 0;
+  pd->ret = NULL;
+  return pd;
+}
+
+int JSON_DecoderFeed(JSONPushDecoder *pd, const char *chunk, size_t cbChunk)
+{
+  const char *offset = chunk;
+  const char *end = chunk + cbChunk;
+
+  if (pd->failed)
+  {
+    return FALSE;
+  }
+
+  if (pd->token != PT_NONE && !(offset = PushDecoder_continueToken(pd, offset, end)))
+  {
+    pd->failed = TRUE;
+    return FALSE;
+  }
+
+  while (offset < end)
+  {
+    switch (*offset)
+    {
+      case ' ':
+      case '\t':
+      case '\r':
+      case '\n':
+        offset ++;
+        continue;
+
+      case '{':
+      case '}':
+      case '[':
+      case ']':
+      case ':':
+      case ',':
+        break;
+
+      default:
+      {
+        if (pd->state == PS_VALUE || pd->state == PS_VALUE_OR_CLOSE || pd->state == PS_ARRAY_VALUE || (pd->state == PS_KEY_OR_CLOSE && *offset == '\"'))
+        {
+          if (!(offset = PushDecoder_startToken(pd, offset, end)))
+          {
+            pd->failed = TRUE;
+            return FALSE;
+          }
+          continue;
+        }
+        break;
+      }
+    }
+
+    if (!PushDecoder_structural(pd, offset))
+    {
+      pd->failed = TRUE;
+      return FALSE;
+    }
+    offset ++;
+  }
+
+  return TRUE;
+}
+
+JSOBJ JSON_DecoderFinish(JSONPushDecoder *pd)
+{
+  JSONObjectDecoder *dec = pd->ds.dec;
+  JSOBJ ret;
+
+  if (!pd->failed && pd->token != PT_NONE)
+  {
+    // An unterminated string fails on the terminating '\0' of the carry buffer
+    pd->failed = !PushDecoder_decodeCarry(pd);
+  }
+
+  if (!pd->failed && pd->state != PS_DONE)
+  {
+    pd->failed = !PushDecoder_structural(pd, "");
+  }
+
+  ret = pd->ret;
+
+  if (pd->failed && ret)
+  {
+    dec->releaseObject(pd->ds.prv, ret);
+    ret = NULL;
+  }
+
+  DecoderStack_release(&pd->ds, &pd->stack);
+
+  if (pd->carry)
+  {
+    dec->free(pd->carry);
+  }
+
+  if (dec->escBuffer)
+  {
+    dec->escBuffer = pd->ds.escStart;
+    dec->escBufferLength = pd->ds.escEnd - pd->ds.escStart;
+  }
+  else
+  if (pd->ds.escHeap)
+  {
+    dec->free(pd->ds.escStart);
+  }
+
+  dec->free(pd);
+  return ret;
+}
+
+JSOBJ JSON_DecodeObjectBounded(JSONObjectDecoder *dec, const char *buffer, size_t cbBuffer)
+{
+  JSONPushDecoder *pd = JSON_DecoderInit(dec);
+
+  if (!pd)
+  {
+    return NULL;
+  }
+
+  JSON_DecoderFeed(pd, buffer, cbBuffer);
+  return JSON_DecoderFinish(pd);
+}
+
+/*
+Event parser behind JSON_SaxParse and JSONReader. It checks the same grammar as decode_any (PUSH_STATES) but only
+tokenizes: strings and other scalars are located and handed on as raw spans of the input, nothing is
+unescaped or converted. All reads are bounds checked so the input doesn't need a terminating NUL */
+
+#define EVENT_PARSER_LOCAL_DEPTH 64
+
+struct EventParser
+{
+  const char *start;
+  const char *end;
+  int state;
+
+  // Span of the last key or scalar, strings without their quotes
+  const char *tokenStart;
+  const char *tokenEnd;
+  int tokenType;
+  int escaped;
+
+  const char *errorStr;
+  const char *errorOffset;
+
+  // One byte per open container, 1 for objects
+  JSUINT8 *containers;
+  size_t depth;
+  size_t capacity;
+  size_t maxDepth;
+  JSPFN_MALLOC malloc;
+  JSPFN_FREE free;
+  JSPFN_REALLOC realloc;
+  JSUINT8 local[EVENT_PARSER_LOCAL_DEPTH];
+};
+
+static void EventParser_init(struct EventParser *ep, const char *buffer, size_t cbBuffer, size_t maxDepth, JSPFN_MALLOC pfnMalloc, JSPFN_FREE pfnFree, JSPFN_REALLOC pfnRealloc)
+{
+  ep->start = buffer;
+  ep->end = buffer + cbBuffer;
+  ep->state = PS_VALUE;
+  ep->tokenStart = ep->tokenEnd = NULL;
+  ep->tokenType = JT_INVALID;
+  ep->escaped = FALSE;
+  ep->errorStr = NULL;
+  ep->errorOffset = NULL;
+  ep->containers = ep->local;
+  ep->depth = 0;
+  ep->capacity = EVENT_PARSER_LOCAL_DEPTH;
+  ep->maxDepth = maxDepth ? maxDepth : JSON_MAX_OBJECT_DEPTH;
+  ep->malloc = pfnMalloc;
+  ep->free = pfnFree;
+  ep->realloc = pfnRealloc;
+}
+
+static void EventParser_release(struct EventParser *ep)
+{
+  if (ep->containers != ep->local)
+  {
+    ep->free(ep->containers);
+  }
+  ep->containers = ep->local;
+}
+
+static int EventParser_error(struct EventParser *ep, const char *offset, const char *message)
+{
+  ep->errorStr = message;
+  ep->errorOffset = offset;
+  ep->start = offset;
+  return JE_ERROR;
+}
+
+static int EventParser_push(struct EventParser *ep, const char *offset, int isObject)
+{
+  JSUINT8 *containers;
+
+  if (ep->depth >= ep->maxDepth)
+  {
+    return EventParser_error(ep, offset, "Reached object decoding depth limit");
+  }
+
+  if (ep->depth == ep->capacity)
+  {
+    if (ep->containers == ep->local)
+    {
+      containers = (JSUINT8 *) ep->malloc(ep->capacity * 2);
+      if (containers)
+      {
+        memcpy(containers, ep->local, ep->depth);
+      }
+    }
+    else
+    {
+      containers = (JSUINT8 *) ep->realloc(ep->containers, ep->capacity * 2);
+    }
+
+    if (!containers)
+    {
+      return EventParser_error(ep, offset, "Could not reserve memory block");
+    }
+
+    ep->containers = containers;
+    ep->capacity *= 2;
+  }
+
+  ep->containers[ep->depth++] = (JSUINT8) isObject;
+  ep->start = offset + 1;
+  ep->state = isObject ? PS_KEY_OR_CLOSE : PS_VALUE_OR_CLOSE;
+  return isObject ? JE_START_OBJECT : JE_START_ARRAY;
+}
+
+static int EventParser_pop(struct EventParser *ep, const char *offset)
+{
+  int isObject = ep->containers[--ep->depth];
+
+  ep->start = offset + 1;
+  ep->state = ep->depth ? PS_AFTER_VALUE : PS_DONE;
+  return isObject ? JE_END_OBJECT : JE_END_ARRAY;
+}
+
+/*
+Finds the closing quote of the string starting after the opening quote at offset. Escape sequences are
+checked but left as they are, *pescaped tells whether there were any. Returns NULL with the error set if
+the string is malformed or unterminated */
+static const char *EventParser_scanString(struct EventParser *ep, const char *offset, int *pescaped)
+{
+  const char *end = ep->end;
+  int index;
+
+  *pescaped = FALSE;
+
+  for (;;)
+  {
+#ifdef JSON_DECODE_SSE2
+    while (end - offset >= 16)
+    {
+      __m128i chunk = _mm_loadu_si128((const __m128i *) offset);
+      JSUINT32 mask = (JSUINT32) _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\"')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\\'))));
+
+      if (mask)
+      {
+        offset += CountTrailingZeros(mask);
+        break;
+      }
+      offset += 16;
+    }
+#endif
+
+    while (offset < end && *offset != '\"' && *offset != '\\')
+    {
+      offset ++;
+    }
+
+    if (offset == end)
+    {
+      EventParser_error(ep, offset, "Unmatched ''\"' when when decoding 'string'");
+      return NULL;
+    }
+
+    if (*offset == '\"')
+    {
+      return offset;
+    }
+
+    *pescaped = TRUE;
+
+    if (++offset == end)
+    {
+      EventParser_error(ep, offset, "Unterminated escape sequence when decoding 'string'");
+      return NULL;
+    }
+
+    switch (*offset)
+    {
+      case '\\': case '\"': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+        offset ++;
+        break;
+
+      case 'u':
+      {
+        offset ++;
+        for (index = 0; index < 4; index ++, offset ++)
+        {
+          if (offset == end)
+          {
+            EventParser_error(ep, offset, "Unterminated unicode escape sequence when decoding 'string'");
+            return NULL;
+          }
+
+          if (!((*offset >= '0' && *offset <= '9') || ((*offset | 0x20) >= 'a' && (*offset | 0x20) <= 'f')))
+          {
+            EventParser_error(ep, offset, "Unexpected character in unicode escape sequence when decoding 'string'");
+            return NULL;
+          }
+        }
+        break;
+      }
+
+      default:
+        EventParser_error(ep, offset, "Unrecognized escape sequence when decoding 'string'");
+        return NULL;
+    }
+  }
+}
+
+/*
+Finds the end of the number at offset, which starts with '-' or a digit. Like decode_numeric there may be
+no digits after a decimal point, an exponent needs digits to be part of the number */
+static const char *EventParser_scanNumber(struct EventParser *ep, const char *offset, int *ptype)
+{
+  const char *end = ep->end;
+  const char *digits;
+  const char *exponent;
+
+  *ptype = JT_LONG;
+
+  if (*offset == '-')
+  {
+    offset ++;
+  }
+
+  for (digits = offset; offset < end && *offset >= '0' && *offset <= '9'; offset ++);
+
+  if (offset == digits)
+  {
+    EventParser_error(ep, offset, "Expected object or value");
+    return NULL;
+  }
+
+  if (offset < end && *offset == '.')
+  {
+    *ptype = JT_DOUBLE;
+    for (offset ++; offset < end && *offset >= '0' && *offset <= '9'; offset ++);
+  }
+
+  if (offset < end && (*offset == 'e' || *offset == 'E'))
+  {
+    exponent = offset + 1;
+
+    if (exponent < end && (*exponent == '+' || *exponent == '-'))
+    {
+      exponent ++;
+    }
+
+    if (exponent < end && *exponent >= '0' && *exponent <= '9')
+    {
+      *ptype = JT_DOUBLE;
+      for (offset = exponent; offset < end && *offset >= '0' && *offset <= '9'; offset ++);
+    }
+  }
+
+  return offset;
+}
+
+/*
+Returns the next event, for JE_KEY and JE_SCALAR the token fields describe it */
+static int EventParser_next(struct EventParser *ep)
+{
+  const char *offset = ep->start;
+  const char *end = ep->end;
+  const char *tokenEnd;
+  int type;
+
+  for (;;)
+  {
+    while (offset < end && (*offset == ' ' || *offset == '\t' || *offset == '\r' || *offset == '\n'))
+    {
+      offset ++;
+    }
+
+    if (offset == end)
+    {
+      ep->start = offset;
+
+      switch (ep->state)
+      {
+        case PS_DONE: return JE_END;
+        case PS_KEY_OR_CLOSE: return EventParser_error(ep, offset, "Key name of object must be 'string' when decoding 'object'");
+        case PS_COLON: return EventParser_error(ep, offset, "No ':' found when decoding object value");
+        case PS_AFTER_VALUE:
+          return EventParser_error(ep, offset, ep->containers[ep->depth - 1] ? "Unexpected character in found when decoding object value" : "Unexpected character found when decoding array value (2)");
+        default: return EventParser_error(ep, offset, "Expected object or value");
+      }
+    }
+
+    switch (ep->state)
+    {
+      case PS_DONE:
+        return EventParser_error(ep, offset, "Trailing data");
+
+      case PS_COLON:
+      {
+        if (*offset != ':')
+        {
+          return EventParser_error(ep, offset, "No ':' found when decoding object value");
+        }
+        ep->state = PS_VALUE;
+        offset ++;
+        continue;
+      }
+
+      case PS_AFTER_VALUE:
+      {
+        if (ep->containers[ep->depth - 1])
+        {
+          switch (*offset)
+          {
+            case ',': ep->state = PS_KEY_OR_CLOSE; offset ++; continue;
+            case '}': return EventParser_pop(ep, offset);
+          }
+          return EventParser_error(ep, offset, "Unexpected character in found when decoding object value");
+        }
+
+        switch (*offset)
+        {
+          case ',': ep->state = PS_ARRAY_VALUE; offset ++; continue;
+          case ']': return EventParser_pop(ep, offset);
+        }
+        return EventParser_error(ep, offset, "Unexpected character found when decoding array value (2)");
+      }
+
+      case PS_KEY_OR_CLOSE:
+      {
+        // Like decode_any a '}' is accepted right after a ','
+        if (*offset == '}')
+        {
+          return EventParser_pop(ep, offset);
+        }
+
+        if (*offset != '\"')
+        {
+          return EventParser_error(ep, offset, "Key name of object must be 'string' when decoding 'object'");
+        }
+
+        if (!(tokenEnd = EventParser_scanString(ep, offset + 1, &ep->escaped)))
+        {
+          return JE_ERROR;
+        }
+
+        ep->tokenStart = offset + 1;
+        ep->tokenEnd = tokenEnd;
+        ep->tokenType = JT_UTF8;
+        ep->start = tokenEnd + 1;
+        ep->state = PS_COLON;
+        return JE_KEY;
+      }
+
+      default:
+      {
+        switch (*offset)
+        {
+          case '{': return EventParser_push(ep, offset, TRUE);
+          case '[': return EventParser_push(ep, offset, FALSE);
+
+          case ']':
+          {
+            if (ep->state == PS_VALUE_OR_CLOSE)
+            {
+              return EventParser_pop(ep, offset);
+            }
+            return EventParser_error(ep, offset, ep->state == PS_ARRAY_VALUE ? "Unexpected character found when decoding array value (1)" : "Expected object or value");
+          }
+
+          case '\"':
+          {
+            if (!(tokenEnd = EventParser_scanString(ep, offset + 1, &ep->escaped)))
+            {
+              return JE_ERROR;
+            }
+            ep->tokenStart = offset + 1;
+            ep->tokenEnd = tokenEnd;
+            ep->start = tokenEnd + 1;
+            type = JT_UTF8;
+            break;
+          }
+
+          case '-':
+          case '0':
+          case '1':
+          case '2':
+          case '3':
+          case '4':
+          case '5':
+          case '6':
+          case '7':
+          case '8':
+          case '9':
+          {
+            if (!(tokenEnd = EventParser_scanNumber(ep, offset, &type)))
+            {
+              return JE_ERROR;
+            }
+            ep->tokenStart = offset;
+            ep->tokenEnd = ep->start = tokenEnd;
+            ep->escaped = FALSE;
+            break;
+          }
+
+          case 't':
+          case 'f':
+          case 'n':
+          {
+            const char *literal = *offset == 't' ? "true" : *offset == 'f' ? "false" : "null";
+            size_t length = strlen(literal);
+
+            if ((size_t) (end - offset) < length || memcmp(offset, literal, length) != 0)
+            {
+              return EventParser_error(ep, offset, *offset == 't' ? "Unexpected character found when decoding 'true'" : *offset == 'f' ? "Unexpected character found when decoding 'false'" : "Unexpected character found when decoding 'null'");
+            }
+
+            type = *offset == 't' ? JT_TRUE : *offset == 'f' ? JT_FALSE : JT_NULL;
+            ep->tokenStart = offset;
+            ep->tokenEnd = ep->start = offset + length;
+            ep->escaped = FALSE;
+            break;
+          }
+
+          default:
+            return EventParser_error(ep, offset, "Expected object or value");
+        }
+
+        ep->tokenType = type;
+        ep->state = ep->depth ? PS_AFTER_VALUE : PS_DONE;
+        return JE_SCALAR;
+      }
+    }
+  }
+}
+
+int JSON_SaxParse(JSONSaxHandler *handler, const char *buffer, size_t cbBuffer)
+{
+  struct EventParser ep;
+  void *prv = handler->prv;
+  int ok;
+
+  EventParser_init(&ep, buffer, cbBuffer, handler->maxDepth, handler->malloc, handler->free, handler->realloc);
+  handler->errorStr = NULL;
+  handler->errorOffset = NULL;
+
+  for (;;)
+  {
+    switch (EventParser_next(&ep))
+    {
+      case JE_START_OBJECT: ok = !handler->startObject || handler->startObject(prv); break;
+      case JE_END_OBJECT: ok = !handler->endObject || handler->endObject(prv); break;
+      case JE_START_ARRAY: ok = !handler->startArray || handler->startArray(prv); break;
+      case JE_END_ARRAY: ok = !handler->endArray || handler->endArray(prv); break;
+      case JE_KEY: ok = !handler->key || handler->key(prv, ep.tokenStart, ep.tokenEnd, ep.escaped); break;
+      case JE_SCALAR: ok = !handler->scalar || handler->scalar(prv, ep.tokenType, ep.tokenStart, ep.tokenEnd, ep.escaped); break;
+
+      case JE_END:
+      {
+        EventParser_release(&ep);
+        return TRUE;
+      }
+
+      default:
+      {
+        handler->errorStr = (char *) ep.errorStr;
+        handler->errorOffset = (char *) ep.errorOffset;
+        EventParser_release(&ep);
+        return FALSE;
+      }
+    }
+
+    if (!ok)
+    {
+      handler->errorStr = (char *) "Stopped by the handler";
+      handler->errorOffset = (char *) ep.start;
+      EventParser_release(&ep);
+      return FALSE;
+    }
+  }
+}
+
+/*
+Completes skipping the value that started with event, for containers that is everything up to and
+including the closing bracket */
+static int EventParser_skip(struct EventParser *ep, int event)
+{
+  const char *offset;
+  const char *error;
+
+  if (event != JE_START_OBJECT && event != JE_START_ARRAY)
+  {
+    return event;
+  }
+
+  offset = ep->start - 1;
+
+  if (!SkipContainer(&offset, ep->end, &error))
+  {
+    return EventParser_error(ep, offset, error);
+  }
+
+  ep->depth --;
+  ep->start = offset;
+  ep->state = ep->depth ? PS_AFTER_VALUE : PS_DONE;
+  return event;
+}
+
+struct __JSONReader
+{
+  struct EventParser ep;
+};
+
+static int JSONReader_token(JSONReader *reader, int event, JSONToken *token)
+{
+  struct EventParser *ep = &reader->ep;
+
+  if (!token)
+  {
+    return event;
+  }
+
+  switch (event)
+  {
+    case JE_KEY:
+    case JE_SCALAR:
+    {
+      token->type = ep->tokenType;
+      token->start = ep->tokenStart;
+      token->end = ep->tokenEnd;
+      token->escaped = ep->escaped;
+      return event;
+    }
+
+    case JE_START_OBJECT:
+    case JE_END_OBJECT:
+    case JE_START_ARRAY:
+    case JE_END_ARRAY:
+    {
+      token->type = (event == JE_START_OBJECT || event == JE_END_OBJECT) ? JT_OBJECT : JT_ARRAY;
+      token->start = ep->start - 1;
+      token->end = ep->start;
+      token->escaped = FALSE;
+      return event;
+    }
+
+    default:
+    {
+      token->type = JT_INVALID;
+      token->start = token->end = ep->start;
+      token->escaped = FALSE;
+      return event;
+    }
+  }
+}
+
+JSONReader *JSON_Reader_Init(const char *buffer, size_t cbBuffer, size_t maxDepth, JSPFN_MALLOC pfnMalloc, JSPFN_FREE pfnFree, JSPFN_REALLOC pfnRealloc)
+{
+  JSONReader *reader = (JSONReader *) pfnMalloc(sizeof(JSONReader));
+
+  if (reader)
+  {
+    EventParser_init(&reader->ep, buffer, cbBuffer, maxDepth, pfnMalloc, pfnFree, pfnRealloc);
+  }
+  return reader;
+}
+
+int JSON_Reader_Next(JSONReader *reader, JSONToken *token)
+{
+  if (reader->ep.errorStr)
+  {
+    return JSONReader_token(reader, JE_ERROR, token);
+  }
+  return JSONReader_token(reader, EventParser_next(&reader->ep), token);
+}
+
+int JSON_Reader_SkipValue(JSONReader *reader, JSONToken *token)
+{
+  struct EventParser *ep = &reader->ep;
+  int event;
+
+  if (ep->errorStr)
+  {
+    return JSONReader_token(reader, JE_ERROR, token);
+  }
+
+  event = EventParser_next(ep);
+
+  if (event == JE_KEY)
+  {
+    JSONReader_token(reader, event, token);
+
+    if (EventParser_skip(ep, EventParser_next(ep)) == JE_ERROR)
+    {
+      return JSONReader_token(reader, JE_ERROR, token);
+    }
+    return event;
+  }
+
+  if (event == JE_START_OBJECT || event == JE_START_ARRAY)
+  {
+    JSONReader_token(reader, event, token);
+    return EventParser_skip(ep, event) == JE_ERROR ? JSONReader_token(reader, JE_ERROR, token) : event;
+  }
+
+  return JSONReader_token(reader, event, token);
+}
+
+const char *JSON_Reader_Error(JSONReader *reader, const char **errorOffset)
+{
+  if (errorOffset)
+  {
+    *errorOffset = reader->ep.errorOffset;
+  }
+  return reader->ep.errorStr;
+}
+
+const char *JSON_Reader_Offset(JSONReader *reader)
+{
+  return reader->ep.start;
+}
+
+void JSON_Reader_Release(JSONReader *reader)
+{
+  JSPFN_FREE pfnFree = reader->ep.free;
+
+  EventParser_release(&reader->ep);
+  pfnFree(reader);
+}
+
+int JSON_BuildTape(JSONTape *tape, const char *buffer, size_t cbBuffer, size_t maxDepth, JSPFN_MALLOC pfnMalloc, JSPFN_FREE pfnFree, JSPFN_REALLOC pfnRealloc)
+{
+  struct EventParser ep;
+  JSONTapeEntry *entry;
+  // Innermost open container, whose end field links to the one enclosing it until it's closed
+  JSUINT32 open = (JSUINT32) -1;
+  int event;
+
+  tape->entries = NULL;
+  tape->count = 0;
+  tape->capacity = 0;
+  tape->errorStr = NULL;
+  tape->errorOffset = NULL;
+
+  if (cbBuffer >= 0xffffffffU)
+  {
+    tape->errorStr = (char *) "Input too large for the tape";
+    return FALSE;
+  }
+
+  EventParser_init(&ep, buffer, cbBuffer, maxDepth, pfnMalloc, pfnFree, pfnRealloc);
+
+  for (;;)
+  {
+    event = EventParser_next(&ep);
+
+    switch (event)
+    {
+      case JE_END:
+      {
+        EventParser_release(&ep);
+        return TRUE;
+      }
+
+      case JE_ERROR:
+      {
+        tape->errorStr = (char *) ep.errorStr;
+        tape->errorOffset = (char *) ep.errorOffset;
+        goto ERROR;
+      }
+
+      case JE_END_OBJECT:
+      case JE_END_ARRAY:
+      {
+        entry = &tape->entries[open];
+        open = entry->end;
+        entry->end = (JSUINT32) tape->count;
+        continue;
+      }
+    }
+
+    if (tape->count == tape->capacity)
+    {
+      size_t newCapacity = tape->capacity ? tape->capacity * 2 : cbBuffer / 8 + 16;
+
+      entry = (JSONTapeEntry *) (tape->entries ? pfnRealloc(tape->entries, newCapacity * sizeof(JSONTapeEntry)) : pfnMalloc(newCapacity * sizeof(JSONTapeEntry)));
+      if (!entry)
+      {
+        tape->errorStr = (char *) "Could not reserve memory block";
+        tape->errorOffset = (char *) ep.start;
+        goto ERROR;
+      }
+
+      tape->entries = entry;
+      tape->capacity = newCapacity;
+    }
+
+    if (event != JE_KEY && open != (JSUINT32) -1)
+    {
+      tape->entries[open].count ++;
+    }
+
+    entry = &tape->entries[tape->count];
+    entry->count = 0;
+
+    if (event == JE_START_OBJECT || event == JE_START_ARRAY)
+    {
+      entry->type = event == JE_START_OBJECT ? JT_OBJECT : JT_ARRAY;
+      entry->start = (JSUINT32) (ep.start - 1 - buffer);
+      entry->end = open;
+      open = (JSUINT32) tape->count;
+    }
+    else
+    {
+      entry->type = (JSUINT32) ep.tokenType;
+      entry->start = (JSUINT32) (ep.tokenStart - buffer);
+      entry->end = (JSUINT32) (ep.tokenEnd - buffer);
+
+      if (ep.tokenType == JT_UTF8)
+      {
+        entry->start --;
+        entry->end ++;
+      }
+    }
+
+    tape->count ++;
+  }
+
+ERROR:
+  EventParser_release(&ep);
+
+  if (tape->entries)
+  {
+    pfnFree(tape->entries);
+    tape->entries = NULL;
+  }
+  tape->count = 0;
+  return FALSE;
+}
@@ -73,6 +73,10 @@ The extra 2 bytes are for the quotes around the string
 */
 #define RESERVE_STRING(_len) (2 + ((_len) * 6))
 
+/*
+Separator or closing bracket, newline and indentation written around the items of a container */
+#define RESERVE_INDENT(_enc, _level) (3 + ((_enc)->indent > 0 ? (size_t) (_level) * (_enc)->indent : 0))
+
 static const double g_pow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000, 10000000000, 100000000000, 1000000000000, 10000000000000, 100000000000000, 1000000000000000};
 static const char g_hexChars[] = "0123456789abcdef";
 static const char g_escapeChars[] = "0123456789\\b\\t\\n\\f\\r\\\"\\\\\\/";
@@ -788,6 +792,14 @@ void encode(JSOBJ obj, JSONObjectEncoder *enc, const char *name, size_t cbName)
 
         while (enc->iterNext(obj, &tc))
         {
+          Buffer_Reserve(enc, RESERVE_INDENT(enc, enc->level + 1));
+          if (enc->errorMsg)
+          {
+            enc->iterEnd(obj, &tc);
+            enc->endTypeContext(obj, &tc);
+            return;
+          }
+
           if (count > 0)
           {
             Buffer_AppendCharUnchecked (enc, ',');
@@ -806,6 +818,13 @@ void encode(JSOBJ obj, JSONObjectEncoder *enc, const char *name, size_t cbName)
       }
 
       enc->iterEnd(obj, &tc);
+      Buffer_Reserve(enc, RESERVE_INDENT(enc, enc->level));
+      if (enc->errorMsg)
+      {
+        enc->endTypeContext(obj, &tc);
+        return;
+      }
+
       Buffer_AppendIndentNewlineUnchecked (enc);
       Buffer_AppendIndentUnchecked (enc, enc->level);
       Buffer_AppendCharUnchecked (enc, ']');
@@ -821,6 +840,14 @@ void encode(JSOBJ obj, JSONObjectEncoder *enc, const char *name, size_t cbName)
 
     while (enc->iterNext(obj, &tc))
     {
+      Buffer_Reserve(enc, RESERVE_INDENT(enc, enc->level + 1));
+      if (enc->errorMsg)
+      {
+        enc->iterEnd(obj, &tc);
+        enc->endTypeContext(obj, &tc);
+        return;
+      }
+
       if (count > 0)
       {
         Buffer_AppendCharUnchecked (enc, ',');
@@ -840,6 +867,13 @@ void encode(JSOBJ obj, JSONObjectEncoder *enc, const char *name, size_t cbName)
     }
 
     enc->iterEnd(obj, &tc);
+    Buffer_Reserve(enc, RESERVE_INDENT(enc, enc->level));
+    if (enc->errorMsg)
+    {
+      enc->endTypeContext(obj, &tc);
+      return;
+    }
+
     Buffer_AppendIndentNewlineUnchecked (enc);
     Buffer_AppendIndentUnchecked (enc, enc->level);
     Buffer_AppendCharUnchecked (enc, '}');
@@ -37,12 +37,36 @@ http://www.opensource.apple.com/source/tcl/tcl-14/tcl/license.terms
 */
 
 #include "py_defines.h"
+#include "pythread.h"
 #include <ultrajson.h>
 
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define JSON_MAP_FILES
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
+
 
 //#define PRINTMARK() fprintf(stderr, "%s: MARK(%d)\n", __FILE__, __LINE__)
 #define PRINTMARK()
 
+// array.array('q', [0]) and array.array('d', [0.0]), repeated to size for typed_arrays
+static PyObject* g_longArray = NULL;
+static PyObject* g_doubleArray = NULL;
+
+#ifdef JSON_MAP_FILES
+// io.FileIO and io.BufferedReader, the only file objects load maps instead of calling read()
+static PyObject* g_fileIOType = NULL;
+static PyObject* g_bufferedReaderType = NULL;
+#endif
+
 void Object_objectAddKey(void *prv, JSOBJ obj, JSOBJ name, JSOBJ value)
 {
   PyDict_SetItem (obj, name, value);
@@ -63,6 +87,208 @@ JSOBJ Object_newString(void *prv, wchar_t *start, wchar_t *end)
   return PyUnicode_FromWideChar (start, (end - start));
 }
 
+#if PY_VERSION_HEX >= 0x03030000
+static Py_UCS4 Object_nextCodePoint(const unsigned char **pptr)
+{
+  const unsigned char *ptr = *pptr;
+
+  if (ptr[0] < 0x80)
+  {
+    *pptr = ptr + 1;
+    return ptr[0];
+  }
+  else
+  if (ptr[0] < 0xe0)
+  {
+    *pptr = ptr + 2;
+    return ((ptr[0] & 0x1f) << 6) | (ptr[1] & 0x3f);
+  }
+  else
+  if (ptr[0] < 0xf0)
+  {
+    *pptr = ptr + 3;
+    return ((ptr[0] & 0x0f) << 12) | ((ptr[1] & 0x3f) << 6) | (ptr[2] & 0x3f);
+  }
+
+  *pptr = ptr + 4;
+  return ((ptr[0] & 0x07) << 18) | ((ptr[1] & 0x3f) << 12) | ((ptr[2] & 0x3f) << 6) | (ptr[3] & 0x3f);
+}
+
+/*
+The decoder has already validated the UTF-8 and found the widest character, so the compact string is
+allocated with its final kind and filled in a single pass, straight from the input buffer unless the
+string was escaped */
+JSOBJ Object_newStringUTF8(void *prv, char *start, char *end, JSUTF32 maxChar, int escaped)
+{
+  const unsigned char *ptr = (const unsigned char *) start;
+  const unsigned char *ptrEnd = (const unsigned char *) end;
+  Py_ssize_t len;
+  Py_ssize_t index;
+  PyObject *ret;
+
+  if (maxChar < 0x80)
+  {
+    ret = PyUnicode_New(end - start, 127);
+    if (ret)
+    {
+      memcpy(PyUnicode_1BYTE_DATA(ret), start, end - start);
+    }
+    return ret;
+  }
+
+  // Every byte that isn't a continuation byte starts a character
+  for (len = 0; ptr < ptrEnd; ptr ++)
+  {
+    len += ((*ptr & 0xc0) != 0x80);
+  }
+
+  ret = PyUnicode_New(len, maxChar);
+  if (!ret)
+  {
+    return NULL;
+  }
+
+  ptr = (const unsigned char *) start;
+
+  /*
+  Text in most scripts mixes 1 and 2 byte sequences (e.g. spaces between words), those loops select the
+  result instead of branching on the sequence length. The last character is decoded separately since the
+  lookahead byte would be past the end after a trailing 1 byte sequence */
+  switch (PyUnicode_KIND(ret))
+  {
+    case PyUnicode_1BYTE_KIND:
+    {
+      // Below U+0100 there are only 1 and 2 byte sequences
+      Py_UCS1 *data = PyUnicode_1BYTE_DATA(ret);
+
+      for (index = 0; index < len - 1; index ++)
+      {
+        Py_UCS1 lead = ptr[0];
+        Py_UCS1 wide = (Py_UCS1) (((lead & 0x1f) << 6) | (ptr[1] & 0x3f));
+        int isWide = lead >> 7;
+
+        data[index] = isWide ? wide : lead;
+        ptr += 1 + isWide;
+      }
+
+      data[index] = (Py_UCS1) Object_nextCodePoint(&ptr);
+      break;
+    }
+
+    case PyUnicode_2BYTE_KIND:
+    {
+      Py_UCS2 *data = PyUnicode_2BYTE_DATA(ret);
+
+      if (maxChar < 0x800)
+      {
+        // Only 1 and 2 byte sequences, which covers most non-CJK scripts
+        for (index = 0; index < len - 1; index ++)
+        {
+          Py_UCS2 lead = ptr[0];
+          Py_UCS2 wide = (Py_UCS2) (((lead & 0x1f) << 6) | (ptr[1] & 0x3f));
+          int isWide = lead >> 7;
+
+          data[index] = isWide ? wide : lead;
+          ptr += 1 + isWide;
+        }
+
+        data[index] = (Py_UCS2) Object_nextCodePoint(&ptr);
+        break;
+      }
+
+      for (index = 0; index < len; index ++)
+      {
+        data[index] = (Py_UCS2) Object_nextCodePoint(&ptr);
+      }
+      break;
+    }
+
+    default:
+    {
+      Py_UCS4 *data = PyUnicode_4BYTE_DATA(ret);
+      for (index = 0; index < len; index ++)
+      {
+        data[index] = Object_nextCodePoint(&ptr);
+      }
+      break;
+    }
+  }
+
+  return ret;
+}
+
+/*
+Per call cache of object key names. Record arrays repeat the same few keys over and over, so short ASCII
+keys are looked up by their raw bytes in a small direct mapped table and the string (with its hash already
+computed) is reused instead of building a new one for every occurrence. A colliding key simply replaces the
+slot, which keeps the cache bounded whatever the input looks like. Keys aren't interned, interned strings are
+immortal from Python 3.12 on and documents keyed by ids would grow the interpreter without bound */
+#define KEY_CACHE_SIZE 256
+#define KEY_CACHE_MAX_LENGTH 64
+
+typedef struct __KeyCache
+{
+  PyObject *keys[KEY_CACHE_SIZE];
+} KeyCache;
+
+static void KeyCache_release(KeyCache *cache)
+{
+  int index;
+
+  for (index = 0; index < KEY_CACHE_SIZE; index ++)
+  {
+    Py_XDECREF(cache->keys[index]);
+  }
+}
+
+JSOBJ Object_newKeyUTF8(void *prv, char *start, char *end, JSUTF32 maxChar, int escaped)
+{
+  KeyCache *cache = (KeyCache *) prv;
+  size_t len = (size_t) (end - start);
+  const unsigned char *ptr;
+  unsigned int hash;
+  PyObject **slot;
+  PyObject *ret;
+
+  if (maxChar >= 0x80 || len > KEY_CACHE_MAX_LENGTH)
+  {
+    return Object_newStringUTF8(prv, start, end, maxChar, escaped);
+  }
+
+  // FNV-1a over the key bytes, which are few
+  hash = 2166136261U;
+  for (ptr = (const unsigned char *) start; ptr < (const unsigned char *) end; ptr ++)
+  {
+    hash = (hash ^ *ptr) * 16777619U;
+  }
+
+  slot = &cache->keys[(hash ^ (hash >> 16)) & (KEY_CACHE_SIZE - 1)];
+
+  if (*slot && (size_t) PyUnicode_GET_LENGTH(*slot) == len && memcmp(PyUnicode_1BYTE_DATA(*slot), start, len) == 0)
+  {
+    Py_INCREF(*slot);
+    return *slot;
+  }
+
+  ret = Object_newStringUTF8(prv, start, end, maxChar, escaped);
+  if (!ret)
+  {
+    return NULL;
+  }
+
+  if (PyObject_Hash(ret) == -1)
+  {
+    Py_DECREF(ret);
+    return NULL;
+  }
+
+  Py_XDECREF(*slot);
+  Py_INCREF(ret);
+  *slot = ret;
+  return ret;
+}
+#endif
+
 JSOBJ Object_newTrue(void *prv)
 {
   Py_RETURN_TRUE;
@@ -108,20 +334,104 @@ JSOBJ Object_newDouble(void *prv, double value)
   return PyFloat_FromDouble(value);
 }
 
+#if PY_VERSION_HEX >= 0x03030000
+/*
+Arrays of numbers decoded with typed_arrays, as an array.array of type 'q' or 'd' holding a copy of values */
+static JSOBJ Object_newNumericArray(void *prv, int type, const void *values, size_t count)
+{
+  PyObject *ret = PySequence_Repeat(type == JT_LONG ? g_longArray : g_doubleArray, (Py_ssize_t) count);
+  Py_buffer view;
+
+  if (!ret)
+  {
+    return NULL;
+  }
+
+  if (PyObject_GetBuffer(ret, &view, PyBUF_WRITABLE) < 0)
+  {
+    Py_DECREF(ret);
+    return NULL;
+  }
+
+  memcpy(view.buf, values, count * sizeof(JSINT64));
+  PyBuffer_Release(&view);
+  return ret;
+}
+#endif
+
 static void Object_releaseObject(void *prv, JSOBJ obj)
 {
   Py_DECREF( ((PyObject *)obj));
 }
 
-static char *g_kwlist[] = {"obj", "precise_float", NULL};
+static void Object_releaseValues(JSOBJ *values, size_t count)
+{
+  while (count > 0)
+  {
+    Py_DECREF( (PyObject *) values[--count]);
+  }
+}
 
-PyObject* JSONToObj(PyObject* self, PyObject *args, PyObject *kwargs)
+/*
+Lists and dicts are made at their final size once the decoder has all of their values */
+static JSOBJ Object_endArray(void *prv, JSOBJ *values, size_t count)
 {
-  PyObject *ret;
-  PyObject *sarg;
-  PyObject *arg;
-  PyObject *opreciseFloat = NULL;
-  JSONObjectDecoder decoder =
+  PyObject *ret = PyList_New((Py_ssize_t) count);
+  size_t index;
+
+  if (!ret)
+  {
+    Object_releaseValues(values, count);
+    return NULL;
+  }
+
+  for (index = 0; index < count; index++)
+  {
+    PyList_SET_ITEM(ret, (Py_ssize_t) index, (PyObject *) values[index]);
+  }
+  return ret;
+}
+
+/*
+From Python 3.11 on _PyDict_NewPresized makes a table for any kind of key, which takes more room than the one
+PyDict_New grows for str keys, so dicts are only presized before that */
+static JSOBJ Object_endObject(void *prv, JSOBJ *values, size_t count)
+{
+#if PY_VERSION_HEX < 0x030B0000
+  PyObject *ret = _PyDict_NewPresized((Py_ssize_t) count);
+#else
+  PyObject *ret = PyDict_New();
+#endif
+  size_t index;
+  int failed;
+
+  if (!ret)
+  {
+    Object_releaseValues(values, count * 2);
+    return NULL;
+  }
+
+  for (index = 0; index < count * 2; index += 2)
+  {
+    failed = PyDict_SetItem(ret, (PyObject *) values[index], (PyObject *) values[index + 1]) < 0;
+    Py_DECREF( (PyObject *) values[index]);
+    Py_DECREF( (PyObject *) values[index + 1]);
+
+    if (failed)
+    {
+      Object_releaseValues(values + index + 2, count * 2 - index - 2);
+      Py_DECREF(ret);
+      return NULL;
+    }
+  }
+  return ret;
+}
+
+/*
+Sets up the callbacks shared by the entry points. keyCache is only used on Python 3.3 and later */
+static void Object_initDecoder(JSONObjectDecoder *decoder, void *keyCache, int preciseFloat)
+{
+  JSONObjectDecoder init =
   {
     Object_newString,
     Object_objectAddKey,
@@ -141,112 +451,3446 @@ PyObject* JSONToObj(PyObject* self, PyObject *args, PyObject *kwargs)
     PyObject_Realloc
   };
 
-  decoder.preciseFloat = 0;
-  decoder.prv = NULL;
+  *decoder = init;
+  decoder->preciseFloat = preciseFloat;
+  decoder->prv = NULL;
+  decoder->errorStr = NULL;
+  decoder->errorOffset = NULL;
+  decoder->endArray = Object_endArray;
+  decoder->endObject = Object_endObject;
+#if PY_VERSION_HEX >= 0x03030000
+  decoder->newStringUTF8 = Object_newStringUTF8;
+  decoder->newKeyUTF8 = Object_newKeyUTF8;
+  decoder->prv = keyCache;
+  memset(keyCache, 0, sizeof(KeyCache));
+#endif
+}
+
+static void Object_releaseDecoder(JSONObjectDecoder *decoder)
+{
+#if PY_VERSION_HEX >= 0x03030000
+  KeyCache_release((KeyCache *) decoder->prv);
+#endif
+}
 
-  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O", g_kwlist, &arg, &opreciseFloat))
+static PyObject *Object_decodeError(JSONObjectDecoder *decoder, JSOBJ ret)
+{
+  if (decoder->errorStr)
   {
-      return NULL;
+    /*
+    FIXME: It's possible to give a much nicer error message here with actual failing element in input etc*/
+
+    PyErr_Format (PyExc_ValueError, "%s", decoder->errorStr);
+
+    if (ret)
+    {
+        Py_DECREF( (PyObject *) ret);
+    }
+
+    return NULL;
+  }
+
+  return ret;
+}
+
+#if PY_VERSION_HEX >= 0x03030000
+/*
+Adds a path of the fields argument, a str of dot separated keys or a sequence of keys, to trie: a dict
+mapping each key to the dict of its selected keys, or to None if the whole value is selected */
+static int Projection_addPath(PyObject *trie, PyObject *path)
+{
+  PyObject *keys;
+  PyObject *key;
+  PyObject *child;
+  Py_ssize_t index;
+  Py_ssize_t count;
+
+  if (PyUnicode_Check(path))
+  {
+    PyObject *dot = PyUnicode_FromString(".");
+
+    if (!dot)
+    {
+      return 0;
+    }
+    keys = PyUnicode_Split(path, dot, -1);
+    Py_DECREF(dot);
+  }
+  else
+  {
+    keys = PySequence_Fast(path, "fields must contain str or sequences of str");
   }
 
-  if (opreciseFloat && PyObject_IsTrue(opreciseFloat))
+  if (!keys)
   {
-      decoder.preciseFloat = 1;
+    return 0;
   }
 
-  if (PyString_Check(arg))
+  count = PySequence_Fast_GET_SIZE(keys);
+
+  if (count == 0)
   {
-      sarg = arg;
+    Py_DECREF(keys);
+    PyErr_Format(PyExc_ValueError, "Empty path in fields");
+    return 0;
   }
-  else
-  if (PyUnicode_Check(arg))
+
+  for (index = 0; index < count; index ++)
   {
-    sarg = PyUnicode_AsUTF8String(arg);
-    if (sarg == NULL)
+    key = PySequence_Fast_GET_ITEM(keys, index);
+
+    if (!PyUnicode_Check(key))
     {
-      //Exception raised above us by codec according to docs
-      return NULL;
+      Py_DECREF(keys);
+      PyErr_Format(PyExc_TypeError, "fields must contain str or sequences of str");
+      return 0;
+    }
+
+    child = PyDict_GetItem(trie, key);
+
+    if (child == Py_None)
+    {
+      // A shorter path already selects all of it
+      break;
+    }
+
+    if (index == count - 1)
+    {
+      if (PyDict_SetItem(trie, key, Py_None) < 0)
+      {
+        Py_DECREF(keys);
+        return 0;
+      }
+      break;
+    }
+
+    if (!child)
+    {
+      if (!(child = PyDict_New()) || PyDict_SetItem(trie, key, child) < 0)
+      {
+        Py_XDECREF(child);
+        Py_DECREF(keys);
+        return 0;
+      }
+      Py_DECREF(child);
     }
+
+    trie = child;
   }
-  else
+
+  Py_DECREF(keys);
+  return 1;
+}
+#endif
+
+static void Projection_free(JSONProjection *projection)
+{
+  size_t index;
+
+  for (index = 0; index < projection->count; index ++)
   {
-    PyErr_Format(PyExc_TypeError, "Expected String or Unicode");
-    return NULL;
+    if (projection->keys[index].fields)
+    {
+      Projection_free((JSONProjection *) projection->keys[index].fields);
+    }
   }
+  PyObject_Free(projection);
+}
 
-  decoder.errorStr = NULL;
-  decoder.errorOffset = NULL;
-
-  ret = JSON_DecodeObject(&decoder, PyString_AS_STRING(sarg), PyString_GET_SIZE(sarg));
+#if PY_VERSION_HEX >= 0x03030000
+/*
+Converts a trie from Projection_addPath, key names point at the UTF-8 kept by the str keys of the trie so it
+must outlive the projection */
+static JSONProjection *Projection_fromTrie(PyObject *trie)
+{
+  Py_ssize_t count = PyDict_Size(trie);
+  Py_ssize_t pos = 0;
+  Py_ssize_t length;
+  PyObject *key;
+  PyObject *value;
+  JSONProjection *projection;
+  JSONProjectionKey *keys;
 
-  if (sarg != arg)
+  projection = (JSONProjection *) PyObject_Malloc(sizeof(JSONProjection) + count * sizeof(JSONProjectionKey));
+  if (!projection)
   {
-    Py_DECREF(sarg);
+    PyErr_NoMemory();
+    return NULL;
   }
 
-  if (decoder.errorStr)
+  keys = (JSONProjectionKey *) (projection + 1);
+  projection->keys = keys;
+  projection->count = 0;
+
+  while (PyDict_Next(trie, &pos, &key, &value))
   {
-    /*
-    FIXME: It's possible to give a much nicer error message here with actual failing element in input etc*/
+    JSONProjectionKey *projectionKey = &keys[projection->count];
+
+    if (!(projectionKey->name = PyUnicode_AsUTF8AndSize(key, &length)))
+    {
+      Projection_free(projection);
+      return NULL;
+    }
 
-    PyErr_Format (PyExc_ValueError, "%s", decoder.errorStr);
+    projectionKey->length = (size_t) length;
+    projectionKey->fields = NULL;
 
-    if (ret)
+    if (value != Py_None && !(projectionKey->fields = Projection_fromTrie(value)))
     {
-        Py_DECREF( (PyObject *) ret);
+      Projection_free(projection);
+      return NULL;
     }
 
-    return NULL;
+    projection->count ++;
   }
 
-  return ret;
+  return projection;
 }
 
-PyObject* JSONFileToObj(PyObject* self, PyObject *args, PyObject *kwargs)
+/*
+Builds the projection for the fields argument, *ptrie receives the trie it points into */
+static JSONProjection *Projection_new(PyObject *fields, PyObject **ptrie)
 {
-  PyObject *read;
-  PyObject *string;
-  PyObject *result;
-  PyObject *file = NULL;
-  PyObject *argtuple;
+  PyObject *iter;
+  PyObject *path;
+  JSONProjection *projection;
+  PyObject *trie;
 
-  if (!PyArg_ParseTuple (args, "O", &file))
+  if (PyUnicode_Check(fields))
   {
+    PyErr_Format(PyExc_TypeError, "fields must be an iterable of paths, not a str");
     return NULL;
   }
 
-  if (!PyObject_HasAttrString (file, "read"))
+  if (!(iter = PyObject_GetIter(fields)))
   {
-    PyErr_Format (PyExc_TypeError, "expected file");
     return NULL;
   }
 
-  read = PyObject_GetAttrString (file, "read");
-
-  if (!PyCallable_Check (read)) {
-    Py_XDECREF(read);
-    PyErr_Format (PyExc_TypeError, "expected file");
+  if (!(trie = PyDict_New()))
+  {
+    Py_DECREF(iter);
     return NULL;
   }
 
-  string = PyObject_CallObject (read, NULL);
-  Py_XDECREF(read);
+  while ((path = PyIter_Next(iter)))
+  {
+    int ok = Projection_addPath(trie, path);
 
-  if (string == NULL)
+    Py_DECREF(path);
+
+    if (!ok)
+    {
+      break;
+    }
+  }
+
+  Py_DECREF(iter);
+
+  if (PyErr_Occurred() || !(projection = Projection_fromTrie(trie)))
   {
+    Py_DECREF(trie);
     return NULL;
   }
 
-  argtuple = PyTuple_Pack(1, string);
-
-  result = JSONToObj (self, argtuple, kwargs);
+  *ptrie = trie;
+  return projection;
+}
+#endif
 
-  Py_XDECREF(argtuple);
-  Py_XDECREF(string);
+#if PY_VERSION_HEX >= 0x03030000
+/*
+Returns the storage of a str the decoder can read in place, which is the case for ASCII and Latin-1 (one
+byte per code point) strings, always followed by a '\0'. *platin1 is set for the latter. Returns NULL
+for wider strings, which are encoded to UTF-8 first */
+static const char *Object_strBuffer(PyObject *arg, Py_ssize_t *plength, int *platin1)
+{
+#if PY_VERSION_HEX < 0x030C0000
+  if (PyUnicode_READY(arg) < 0)
+  {
+    PyErr_Clear();
+    return NULL;
+  }
+#endif
 
-  if (result == NULL) {
+  if (PyUnicode_KIND(arg) != PyUnicode_1BYTE_KIND)
+  {
     return NULL;
   }
 
-  return result;
+  *plength = PyUnicode_GET_LENGTH(arg);
+  *platin1 = !PyUnicode_IS_ASCII(arg);
+  return (const char *) PyUnicode_1BYTE_DATA(arg);
+}
+#endif
+
+/*
+Decodes the cbBuffer bytes at buffer, which are UTF-8 or, with latin1 set, Latin-1. Unless terminated is set
+they aren't followed by a '\0' and nothing past them is read */
+static PyObject *Object_decodeBuffer(const char *buffer, size_t cbBuffer, int terminated, int latin1, int preciseFloat, int structuralIndex, PyObject *fields, int typedArrays)
+{
+  PyObject *trie = NULL;
+  JSONProjection *projection = NULL;
+  PyObject *ret;
+#if PY_VERSION_HEX >= 0x03030000
+  KeyCache keyCache;
+#else
+  void *keyCache = NULL;
+#endif
+  JSONObjectDecoder decoder;
+
+  if (!terminated && (structuralIndex || (fields && fields != Py_None) || typedArrays))
+  {
+    // Only the default decoder has a bounded mode, the others get a terminated copy
+    PyObject *copy = PyBytes_FromStringAndSize(buffer, cbBuffer);
+
+    if (!copy)
+    {
+      return NULL;
+    }
+
+    ret = Object_decodeBuffer(PyString_AS_STRING(copy), PyString_GET_SIZE(copy), 1, latin1, preciseFloat, structuralIndex, fields, typedArrays);
+    Py_DECREF(copy);
+    return ret;
+  }
+
+  if (typedArrays && (structuralIndex || !g_doubleArray))
+  {
+    // The prototypes are only made on Python 3.3 and later, where array has the 'q' type
+    PyErr_Format(PyExc_ValueError, structuralIndex ? "typed_arrays can't be used with structural_index" : "typed_arrays needs Python 3.3 or later");
+    return NULL;
+  }
+
+  if (fields && fields != Py_None)
+  {
+    if (structuralIndex)
+    {
+      PyErr_Format(PyExc_ValueError, "fields can't be used with structural_index");
+    }
+    else
+    {
+#if PY_VERSION_HEX >= 0x03030000
+      projection = Projection_new(fields, &trie);
+#else
+      PyErr_Format(PyExc_ValueError, "fields needs Python 3.3 or later");
+#endif
+    }
+
+    if (!projection)
+    {
+      return NULL;
+    }
+  }
+
+  Object_initDecoder(&decoder, &keyCache, preciseFloat);
+  decoder.projection = projection;
+  decoder.latin1 = latin1;
+#if PY_VERSION_HEX >= 0x03030000
+  decoder.newNumericArray = typedArrays ? Object_newNumericArray : NULL;
+#endif
+
+  if (structuralIndex)
+  {
+    ret = JSON_DecodeObjectIndexed(&decoder, buffer, cbBuffer);
+  }
+  else
+  if (terminated)
+  {
+    ret = JSON_DecodeObject(&decoder, buffer, cbBuffer);
+  }
+  else
+  {
+    ret = JSON_DecodeObjectBounded(&decoder, buffer, cbBuffer);
+  }
+
+  Object_releaseDecoder(&decoder);
+
+  if (projection)
+  {
+    Projection_free(projection);
+    Py_DECREF(trie);
+  }
+
+  return Object_decodeError(&decoder, ret);
+}
+
+/*
+Decodes arg, which is str, bytes, bytearray or any other object exporting a contiguous buffer such as a
+memoryview or an mmap. Bytes and bytearrays are always followed by a '\0', other buffers are decoded in
+place by JSON_DecodeObjectBounded, which saves the copy but decodes slower. One byte per character strs are
+decoded in place too */
+static PyObject *Object_decode(PyObject *arg, int preciseFloat, int structuralIndex, PyObject *fields, int typedArrays)
+{
+  PyObject *sarg;
+  PyObject *ret;
+  Py_buffer view;
+#if PY_VERSION_HEX >= 0x03030000
+  const char *buffer;
+  Py_ssize_t length;
+  int latin1;
+#endif
+
+  if (PyString_Check(arg))
+  {
+    return Object_decodeBuffer(PyString_AS_STRING(arg), PyString_GET_SIZE(arg), 1, 0, preciseFloat, structuralIndex, fields, typedArrays);
+  }
+
+  if (PyUnicode_Check(arg))
+  {
+#if PY_VERSION_HEX >= 0x03030000
+    if ((buffer = Object_strBuffer(arg, &length, &latin1)))
+    {
+      return Object_decodeBuffer(buffer, length, 1, latin1, preciseFloat, structuralIndex, fields, typedArrays);
+    }
+#endif
+
+    sarg = PyUnicode_AsUTF8String(arg);
+    if (sarg == NULL)
+    {
+      //Exception raised above us by codec according to docs
+      return NULL;
+    }
+
+    ret = Object_decodeBuffer(PyString_AS_STRING(sarg), PyString_GET_SIZE(sarg), 1, 0, preciseFloat, structuralIndex, fields, typedArrays);
+    Py_DECREF(sarg);
+    return ret;
+  }
+
+  if (PyObject_CheckBuffer(arg))
+  {
+    // The view also keeps a bytearray from being resized while it's decoded
+    if (PyObject_GetBuffer(arg, &view, PyBUF_SIMPLE) < 0)
+    {
+      return NULL;
+    }
+
+    ret = Object_decodeBuffer((const char *) view.buf, view.len, PyByteArray_Check(arg), 0, preciseFloat, structuralIndex, fields, typedArrays);
+    PyBuffer_Release(&view);
+    return ret;
+  }
+
+  PyErr_Format(PyExc_TypeError, "Expected String or Unicode");
+  return NULL;
+}
+
+/*
+Feeds the push decoder chunkSize characters or bytes at a time, so only one chunk of the file is held in
+memory besides the result */
+static PyObject *Object_decodeChunks(PyObject *read, Py_ssize_t chunkSize, int preciseFloat)
+{
+  PyObject *chunk;
+  PyObject *bytes;
+  JSONPushDecoder *pd;
+  JSOBJ ret;
+  int ok = 1;
+#if PY_VERSION_HEX >= 0x03030000
+  KeyCache keyCache;
+#else
+  void *keyCache = NULL;
+#endif
+  JSONObjectDecoder decoder;
+
+  Object_initDecoder(&decoder, &keyCache, preciseFloat);
+
+  pd = JSON_DecoderInit(&decoder);
+  if (!pd)
+  {
+    Object_releaseDecoder(&decoder);
+    return PyErr_NoMemory();
+  }
+
+  while (ok)
+  {
+    chunk = PyObject_CallFunction(read, "n", chunkSize);
+    if (chunk == NULL)
+    {
+      break;
+    }
+
+    if (PyUnicode_Check(chunk))
+    {
+      bytes = PyUnicode_AsUTF8String(chunk);
+      Py_DECREF(chunk);
+      if (bytes == NULL)
+      {
+        break;
+      }
+    }
+    else
+    if (PyString_Check(chunk))
+    {
+      bytes = chunk;
+    }
+    else
+    {
+      Py_DECREF(chunk);
+      PyErr_Format(PyExc_TypeError, "Expected String or Unicode");
+      break;
+    }
+
+    if (PyString_GET_SIZE(bytes) == 0)
+    {
+      Py_DECREF(bytes);
+      ret = JSON_DecoderFinish(pd);
+      Object_releaseDecoder(&decoder);
+      return Object_decodeError(&decoder, ret);
+    }
+
+    ok = JSON_DecoderFeed(pd, PyString_AS_STRING(bytes), PyString_GET_SIZE(bytes));
+    Py_DECREF(bytes);
+  }
+
+  // Either read() raised or the input is invalid, which Finish reports
+  ret = JSON_DecoderFinish(pd);
+  Object_releaseDecoder(&decoder);
+
+  if (PyErr_Occurred())
+  {
+    if (ret)
+    {
+      Py_DECREF( (PyObject *) ret);
+    }
+    return NULL;
+  }
+
+  return Object_decodeError(&decoder, ret);
+}
+
+/*
+State of loads_lines, the decoder's prv. The key cache comes first so the key callbacks can use prv as is */
+typedef struct __LinesContext
+{
+#if PY_VERSION_HEX >= 0x03030000
+  KeyCache keyCache;
+#endif
+  PyObject *objects;
+  PyObject *errors;
+  JSONObjectDecoder *decoder;
+  size_t errorLine;
+} LinesContext;
+
+static int Object_addLine(void *prv, JSOBJ obj, size_t line)
+{
+  LinesContext *context = (LinesContext *) prv;
+  PyObject *error;
+  int ret;
+
+  if (obj)
+  {
+    ret = PyList_Append(context->objects, (PyObject *) obj);
+    Py_DECREF( (PyObject *) obj);
+    return ret == 0;
+  }
+
+  if (PyErr_Occurred() || !context->errors)
+  {
+    context->errorLine = line;
+    return 0;
+  }
+
+  if (!(error = Py_BuildValue("(ns)", (Py_ssize_t) line, context->decoder->errorStr)))
+  {
+    return 0;
+  }
+
+  ret = PyList_Append(context->errors, error);
+  Py_DECREF(error);
+  return ret == 0;
+}
+
+#if PY_VERSION_HEX >= 0x03030000
+/*
+Parallel loads_lines. The input is split at line boundaries into one range per thread, each decoded with
+JSON_DecodeLines without the GIL. The callbacks of those decoders don't create Python objects but record
+the values as nodes of a per thread tape (strings are copied, the decoder reuses its buffers). Once all
+threads are done the tapes are turned into objects, in line order */
+typedef struct __LineNode
+{
+  int type;
+  JSUTF32 maxChar;
+
+  // Index + 1 of the next value in the same container, 0 if it's the last one
+  size_t next;
+  union
+  {
+    JSINT64 longValue;
+    JSUINT64 unsignedValue;
+    double doubleValue;
+    struct
+    {
+      size_t offset;
+      size_t length;
+    } string;
+    struct
+    {
+      size_t first;
+      size_t last;
+      size_t count;
+    } container;
+  } u;
+} LineNode;
+
+typedef struct __LineResult
+{
+  size_t line;
+
+  // Index + 1 of the root node, 0 if the line is invalid
+  size_t node;
+  const char *errorStr;
+} LineResult;
+
+typedef struct __LinesWorker
+{
+  const char *buffer;
+  size_t cbBuffer;
+  int collectErrors;
+  int outOfMemory;
+  LineNode *nodes;
+  size_t nodeCount;
+  size_t nodeCapacity;
+  char *strings;
+  size_t stringLength;
+  size_t stringCapacity;
+  LineResult *results;
+  size_t resultCount;
+  size_t resultCapacity;
+  JSONObjectDecoder decoder;
+  PyThread_type_lock done;
+} LinesWorker;
+
+#define LINE_NODE(index) ((JSOBJ) (size_t) (index))
+#define LINE_NODE_INDEX(obj) ((size_t) (obj))
+
+static int LinesWorker_grow(void **pitems, size_t *pcapacity, size_t count, size_t itemSize)
+{
+  size_t capacity = *pcapacity ? *pcapacity * 2 : 1024;
+  void *items;
+
+  while (capacity < count)
+  {
+    capacity *= 2;
+  }
+
+  if (!(items = realloc(*pitems, capacity * itemSize)))
+  {
+    return 0;
+  }
+
+  *pitems = items;
+  *pcapacity = capacity;
+  return 1;
+}
+
+static JSOBJ LinesWorker_node(LinesWorker *worker, int type, LineNode **pnode)
+{
+  LineNode *node;
+
+  if (worker->nodeCount == worker->nodeCapacity && !LinesWorker_grow((void **) &worker->nodes, &worker->nodeCapacity, worker->nodeCount + 1, sizeof(LineNode)))
+  {
+    worker->outOfMemory = 1;
+    return NULL;
+  }
+
+  node = &worker->nodes[worker->nodeCount++];
+  node->type = type;
+  node->next = 0;
+  if (pnode)
+  {
+    *pnode = node;
+  }
+  return LINE_NODE(worker->nodeCount);
+}
+
+static JSOBJ LinesWorker_newString(void *prv, wchar_t *start, wchar_t *end)
+{
+  // Unused, newStringUTF8 gets all strings
+  return NULL;
+}
+
+static JSOBJ LinesWorker_newStringUTF8(void *prv, char *start, char *end, JSUTF32 maxChar, int escaped)
+{
+  LinesWorker *worker = (LinesWorker *) prv;
+  size_t length = (size_t) (end - start);
+  LineNode *node;
+  JSOBJ ret;
+
+  if (worker->stringLength + length > worker->stringCapacity && !LinesWorker_grow((void **) &worker->strings, &worker->stringCapacity, worker->stringLength + length, 1))
+  {
+    worker->outOfMemory = 1;
+    return NULL;
+  }
+
+  if (!(ret = LinesWorker_node(worker, JT_UTF8, &node)))
+  {
+    return NULL;
+  }
+
+  memcpy(worker->strings + worker->stringLength, start, length);
+  node->maxChar = maxChar;
+  node->u.string.offset = worker->stringLength;
+  node->u.string.length = length;
+  worker->stringLength += length;
+  return ret;
+}
+
+static void LinesWorker_append(LinesWorker *worker, JSOBJ obj, JSOBJ value)
+{
+  LineNode *container = &worker->nodes[LINE_NODE_INDEX(obj) - 1];
+
+  if (container->u.container.last)
+  {
+    worker->nodes[container->u.container.last - 1].next = LINE_NODE_INDEX(value);
+  }
+  else
+  {
+    container->u.container.first = LINE_NODE_INDEX(value);
+  }
+
+  container->u.container.last = LINE_NODE_INDEX(value);
+}
+
+static void LinesWorker_objectAddKey(void *prv, JSOBJ obj, JSOBJ name, JSOBJ value)
+{
+  LinesWorker_append((LinesWorker *) prv, obj, name);
+  LinesWorker_append((LinesWorker *) prv, obj, value);
+  ((LinesWorker *) prv)->nodes[LINE_NODE_INDEX(obj) - 1].u.container.count ++;
+}
+
+static void LinesWorker_arrayAddItem(void *prv, JSOBJ obj, JSOBJ value)
+{
+  LinesWorker_append((LinesWorker *) prv, obj, value);
+  ((LinesWorker *) prv)->nodes[LINE_NODE_INDEX(obj) - 1].u.container.count ++;
+}
+
+static JSOBJ LinesWorker_newTrue(void *prv)
+{
+  return LinesWorker_node((LinesWorker *) prv, JT_TRUE, NULL);
+}
+
+static JSOBJ LinesWorker_newFalse(void *prv)
+{
+  return LinesWorker_node((LinesWorker *) prv, JT_FALSE, NULL);
+}
+
+static JSOBJ LinesWorker_newNull(void *prv)
+{
+  return LinesWorker_node((LinesWorker *) prv, JT_NULL, NULL);
+}
+
+static JSOBJ LinesWorker_newContainer(LinesWorker *worker, int type)
+{
+  LineNode *node;
+  JSOBJ ret = LinesWorker_node(worker, type, &node);
+
+  if (ret)
+  {
+    node->u.container.first = node->u.container.last = node->u.container.count = 0;
+  }
+  return ret;
+}
+
+static JSOBJ LinesWorker_newObject(void *prv)
+{
+  return LinesWorker_newContainer((LinesWorker *) prv, JT_OBJECT);
+}
+
+static JSOBJ LinesWorker_newArray(void *prv)
+{
+  return LinesWorker_newContainer((LinesWorker *) prv, JT_ARRAY);
+}
+
+static JSOBJ LinesWorker_newLong(void *prv, JSINT64 value)
+{
+  LineNode *node;
+  JSOBJ ret = LinesWorker_node((LinesWorker *) prv, JT_LONG, &node);
+
+  if (ret)
+  {
+    node->u.longValue = value;
+  }
+  return ret;
+}
+
+static JSOBJ LinesWorker_newInt(void *prv, JSINT32 value)
+{
+  return LinesWorker_newLong(prv, value);
+}
+
+static JSOBJ LinesWorker_newUnsignedLong(void *prv, JSUINT64 value)
+{
+  LineNode *node;
+  JSOBJ ret = LinesWorker_node((LinesWorker *) prv, JT_ULONG, &node);
+
+  if (ret)
+  {
+    node->u.unsignedValue = value;
+  }
+  return ret;
+}
+
+static JSOBJ LinesWorker_newDouble(void *prv, double value)
+{
+  LineNode *node;
+  JSOBJ ret = LinesWorker_node((LinesWorker *) prv, JT_DOUBLE, &node);
+
+  if (ret)
+  {
+    node->u.doubleValue = value;
+  }
+  return ret;
+}
+
+static void LinesWorker_releaseObject(void *prv, JSOBJ obj)
+{
+  // The nodes of a failed line are left unreferenced
+}
+
+static int LinesWorker_addLine(void *prv, JSOBJ obj, size_t line)
+{
+  LinesWorker *worker = (LinesWorker *) prv;
+  LineResult *result;
+
+  if (worker->outOfMemory || (worker->resultCount == worker->resultCapacity && !LinesWorker_grow((void **) &worker->results, &worker->resultCapacity, worker->resultCount + 1, sizeof(LineResult))))
+  {
+    worker->outOfMemory = 1;
+    return 0;
+  }
+
+  result = &worker->results[worker->resultCount++];
+  result->line = line;
+  result->node = LINE_NODE_INDEX(obj);
+  result->errorStr = obj ? NULL : worker->decoder.errorStr;
+  return obj || worker->collectErrors;
+}
+
+static void LinesWorker_run(void *arg)
+{
+  LinesWorker *worker = (LinesWorker *) arg;
+
+  JSON_DecodeLines(&worker->decoder, worker->buffer, worker->cbBuffer, LinesWorker_addLine);
+  PyThread_release_lock(worker->done);
+}
+
+static void LinesWorker_init(LinesWorker *worker, const char *buffer, size_t cbBuffer, int preciseFloat, int collectErrors)
+{
+  JSONObjectDecoder init =
+  {
+    LinesWorker_newString,
+    LinesWorker_objectAddKey,
+    LinesWorker_arrayAddItem,
+    LinesWorker_newTrue,
+    LinesWorker_newFalse,
+    LinesWorker_newNull,
+    LinesWorker_newObject,
+    LinesWorker_newArray,
+    LinesWorker_newInt,
+    LinesWorker_newLong,
+    LinesWorker_newUnsignedLong,
+    LinesWorker_newDouble,
+    LinesWorker_releaseObject,
+    malloc,
+    free,
+    realloc
+  };
+
+  memset(worker, 0, sizeof(LinesWorker));
+  worker->buffer = buffer;
+  worker->cbBuffer = cbBuffer;
+  worker->collectErrors = collectErrors;
+  worker->decoder = init;
+  worker->decoder.preciseFloat = preciseFloat;
+  worker->decoder.prv = worker;
+  worker->decoder.newStringUTF8 = LinesWorker_newStringUTF8;
+  worker->decoder.newKeyUTF8 = LinesWorker_newStringUTF8;
+}
+
+static void LinesWorker_release(LinesWorker *worker)
+{
+  free(worker->nodes);
+  free(worker->strings);
+  free(worker->results);
+  if (worker->done)
+  {
+    PyThread_free_lock(worker->done);
+  }
+}
+
+/*
+Creates the Python object for a node, keys go through the key cache */
+static PyObject *LinesWorker_object(LinesWorker *worker, KeyCache *keyCache, size_t index, int isKey)
+{
+  LineNode *node = &worker->nodes[index - 1];
+  PyObject *ret;
+  PyObject *key;
+  PyObject *value;
+  Py_ssize_t item;
+
+  switch (node->type)
+  {
+    case JT_NULL: Py_RETURN_NONE;
+    case JT_TRUE: Py_RETURN_TRUE;
+    case JT_FALSE: Py_RETURN_FALSE;
+    case JT_LONG: return PyLong_FromLongLong(node->u.longValue);
+    case JT_ULONG: return PyLong_FromUnsignedLongLong(node->u.unsignedValue);
+    case JT_DOUBLE: return PyFloat_FromDouble(node->u.doubleValue);
+
+    case JT_UTF8:
+    {
+      char *start = worker->strings + node->u.string.offset;
+      return (isKey ? Object_newKeyUTF8 : Object_newStringUTF8)(keyCache, start, start + node->u.string.length, node->maxChar, 1);
+    }
+
+    case JT_ARRAY:
+    {
+      if (!(ret = PyList_New(node->u.container.count)))
+      {
+        return NULL;
+      }
+
+      for (item = 0, index = node->u.container.first; index; item ++, index = worker->nodes[index - 1].next)
+      {
+        if (!(value = LinesWorker_object(worker, keyCache, index, 0)))
+        {
+          Py_DECREF(ret);
+          return NULL;
+        }
+        PyList_SET_ITEM(ret, item, value);
+      }
+      return ret;
+    }
+
+    default:
+    {
+      if (!(ret = PyDict_New()))
+      {
+        return NULL;
+      }
+
+      for (index = node->u.container.first; index; index = worker->nodes[index - 1].next)
+      {
+        key = LinesWorker_object(worker, keyCache, index, 1);
+        index = worker->nodes[index - 1].next;
+        value = key ? LinesWorker_object(worker, keyCache, index, 0) : NULL;
+
+        if (!value || PyDict_SetItem(ret, key, value) < 0)
+        {
+          Py_XDECREF(key);
+          Py_XDECREF(value);
+          Py_DECREF(ret);
+          return NULL;
+        }
+
+        Py_DECREF(key);
+        Py_DECREF(value);
+      }
+      return ret;
+    }
+  }
+}
+
+/*
+Counts the lines in [start, end), which holds whole lines */
+static size_t Object_countLines(const char *start, const char *end)
+{
+  size_t count = 0;
+
+  while ((start = (const char *) memchr(start, '\n', end - start)))
+  {
+    start ++;
+    count ++;
+  }
+  return count;
+}
+
+/*
+Smallest range given a thread of its own. A thread is started for each range on every call, which costs about
+as much as parsing a few KB, so smaller ranges would only add overhead */
+#define LINES_MIN_RANGE_SIZE 65536
+
+static PyObject *Object_decodeLinesParallel(const char *buffer, size_t cbBuffer, int threads, int preciseFloat, int collectErrors)
+{
+  LinesWorker *workers;
+  LinesWorker *worker;
+  const char *start = buffer;
+  const char *end = buffer + cbBuffer;
+  const char *split;
+  PyObject *objects;
+  PyObject *errors = NULL;
+  PyObject *value;
+  KeyCache keyCache;
+  size_t firstLine = 0;
+  size_t index;
+  int count = 0;
+  int started;
+  int ok = 1;
+
+  if (!(workers = (LinesWorker *) PyMem_Malloc(threads * sizeof(LinesWorker))))
+  {
+    return PyErr_NoMemory();
+  }
+
+  // Ranges of about the same size, each ending after a '\n' or at the end
+  while (start < end && count < threads)
+  {
+    split = start + (end - start) / (threads - count);
+    split = (count == threads - 1 || !(split = (const char *) memchr(split, '\n', end - split))) ? end : split + 1;
+
+    LinesWorker_init(&workers[count], start, split - start, preciseFloat, collectErrors);
+    if (!(workers[count].done = PyThread_allocate_lock()))
+    {
+      ok = 0;
+      break;
+    }
+
+    count ++;
+    start = split;
+  }
+
+  // The first range is decoded on this thread
+  started = 1;
+
+  if (ok)
+  {
+    Py_BEGIN_ALLOW_THREADS
+
+    for (; started < count; started ++)
+    {
+      PyThread_acquire_lock(workers[started].done, WAIT_LOCK);
+      if (PyThread_start_new_thread(LinesWorker_run, &workers[started]) == PYTHREAD_INVALID_THREAD_ID)
+      {
+        PyThread_release_lock(workers[started].done);
+        break;
+      }
+    }
+
+    if (count)
+    {
+      PyThread_acquire_lock(workers[0].done, WAIT_LOCK);
+      LinesWorker_run(&workers[0]);
+    }
+
+    for (index = 1; index < (size_t) started; index ++)
+    {
+      PyThread_acquire_lock(workers[index].done, WAIT_LOCK);
+      PyThread_release_lock(workers[index].done);
+    }
+
+    Py_END_ALLOW_THREADS
+  }
+
+  objects = PyList_New(0);
+  if (collectErrors)
+  {
+    errors = PyList_New(0);
+  }
+
+  memset(&keyCache, 0, sizeof(KeyCache));
+
+  if (!ok || started < count)
+  {
+    PyErr_Format(PyExc_RuntimeError, "Could not start decoding threads");
+    ok = 0;
+  }
+  else
+  if (!objects || (collectErrors && !errors))
+  {
+    ok = 0;
+  }
+
+  for (worker = workers; ok && worker < workers + count; worker ++)
+  {
+    for (index = 0; ok && index < worker->resultCount; index ++)
+    {
+      LineResult *result = &worker->results[index];
+
+      if (result->node)
+      {
+        ok = (value = LinesWorker_object(worker, &keyCache, result->node, 0)) && PyList_Append(objects, value) == 0;
+        Py_XDECREF(value);
+      }
+      else
+      if (collectErrors)
+      {
+        ok = (value = Py_BuildValue("(ns)", (Py_ssize_t) (firstLine + result->line), result->errorStr)) && PyList_Append(errors, value) == 0;
+        Py_XDECREF(value);
+      }
+      else
+      {
+        PyErr_Format(PyExc_ValueError, "Line %zu: %s", firstLine + result->line, result->errorStr);
+        ok = 0;
+      }
+    }
+
+    if (ok && worker->outOfMemory)
+    {
+      PyErr_NoMemory();
+      ok = 0;
+    }
+
+    firstLine += Object_countLines(worker->buffer, worker->buffer + worker->cbBuffer);
+  }
+
+  KeyCache_release(&keyCache);
+
+  for (worker = workers; worker < workers + count; worker ++)
+  {
+    LinesWorker_release(worker);
+  }
+  PyMem_Free(workers);
+
+  if (!ok)
+  {
+    Py_XDECREF(objects);
+    Py_XDECREF(errors);
+    return NULL;
+  }
+
+  if (!collectErrors)
+  {
+    return objects;
+  }
+
+  value = Py_BuildValue("(OO)", objects, errors);
+  Py_DECREF(objects);
+  Py_DECREF(errors);
+  return value;
+}
+#endif
+
+static char *g_lineskwlist[] = {"obj", "precise_float", "collect_errors", "threads", NULL};
+
+PyObject* JSONLinesToObj(PyObject* self, PyObject *args, PyObject *kwargs)
+{
+  PyObject *arg;
+  PyObject *sarg;
+  PyObject *opreciseFloat = NULL;
+  PyObject *ocollectErrors = NULL;
+  PyObject *ret = NULL;
+  LinesContext context;
+  JSONObjectDecoder decoder;
+  int collectErrors;
+  int threads = 1;
+  int ok;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|OOi", g_lineskwlist, &arg, &opreciseFloat, &ocollectErrors, &threads))
+  {
+    return NULL;
+  }
+
+  if (threads < 1)
+  {
+    PyErr_Format(PyExc_ValueError, "threads must be at least 1");
+    return NULL;
+  }
+
+  if (PyObject_HasAttrString(arg, "read"))
+  {
+    sarg = PyObject_CallMethod(arg, "read", NULL);
+  }
+  else
+  {
+    sarg = arg;
+    Py_INCREF(sarg);
+  }
+
+  if (sarg && PyUnicode_Check(sarg))
+  {
+    PyObject *bytes = PyUnicode_AsUTF8String(sarg);
+
+    Py_DECREF(sarg);
+    sarg = bytes;
+  }
+
+  if (!sarg)
+  {
+    return NULL;
+  }
+
+  if (!PyString_Check(sarg))
+  {
+    Py_DECREF(sarg);
+    PyErr_Format(PyExc_TypeError, "Expected String or Unicode");
+    return NULL;
+  }
+
+  collectErrors = ocollectErrors && PyObject_IsTrue(ocollectErrors);
+
+#if PY_VERSION_HEX >= 0x03030000
+  if ((size_t) threads > (size_t) PyString_GET_SIZE(sarg) / LINES_MIN_RANGE_SIZE)
+  {
+    threads = (int) (PyString_GET_SIZE(sarg) / LINES_MIN_RANGE_SIZE);
+  }
+
+  if (threads > 1)
+  {
+    ret = Object_decodeLinesParallel(PyString_AS_STRING(sarg), PyString_GET_SIZE(sarg), threads, opreciseFloat && PyObject_IsTrue(opreciseFloat), collectErrors);
+    Py_DECREF(sarg);
+    return ret;
+  }
+#endif
+
+  context.objects = PyList_New(0);
+  context.errors = collectErrors ? PyList_New(0) : NULL;
+  context.decoder = &decoder;
+  context.errorLine = 0;
+
+  if (context.objects && (context.errors || !collectErrors))
+  {
+    Object_initDecoder(&decoder, &context, opreciseFloat && PyObject_IsTrue(opreciseFloat));
+    decoder.prv = &context;
+
+    ok = JSON_DecodeLines(&decoder, PyString_AS_STRING(sarg), PyString_GET_SIZE(sarg), Object_addLine);
+
+    Object_releaseDecoder(&decoder);
+
+    if (ok)
+    {
+      ret = context.errors ? Py_BuildValue("(OO)", context.objects, context.errors) : context.objects;
+      if (ret == context.objects)
+      {
+        Py_INCREF(ret);
+      }
+    }
+    else
+    if (!PyErr_Occurred())
+    {
+      if (context.errorLine)
+      {
+        PyErr_Format(PyExc_ValueError, "Line %zu: %s", context.errorLine, decoder.errorStr);
+      }
+      else
+      {
+        PyErr_Format(PyExc_ValueError, "%s", decoder.errorStr);
+      }
+    }
+  }
+
+  Py_XDECREF(context.objects);
+  Py_XDECREF(context.errors);
+  Py_DECREF(sarg);
+  return ret;
+}
+
+static char *g_kwlist[] = {"obj", "precise_float", "structural_index", "fields", "typed_arrays", NULL};
+
+PyObject* JSONToObj(PyObject* self, PyObject *args, PyObject *kwargs)
+{
+  PyObject *arg;
+  PyObject *opreciseFloat = NULL;
+  PyObject *ostructuralIndex = NULL;
+  PyObject *fields = NULL;
+  PyObject *otypedArrays = NULL;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|OOOO", g_kwlist, &arg, &opreciseFloat, &ostructuralIndex, &fields, &otypedArrays))
+  {
+      return NULL;
+  }
+
+  return Object_decode(arg, opreciseFloat && PyObject_IsTrue(opreciseFloat), ostructuralIndex && PyObject_IsTrue(ostructuralIndex), fields,
+    otypedArrays && PyObject_IsTrue(otypedArrays));
+}
+
+#ifdef JSON_MAP_FILES
+/*
+Decodes the regular file open as fd from offset on, straight from a read only mapping of it rather than a copy.
+The mapping is followed by at least one page of zeros, which serves as the '\0' the decoder expects after the
+input. Returns 0 if fd can't be mapped, e.g. because it isn't a regular file, otherwise 1 with the result
+or NULL and an exception in *presult and the size of the file in *psize */
+static int Object_decodeMapped(int fd, JSINT64 offset, int preciseFloat, int structuralIndex, PyObject *fields, int typedArrays, PyObject **presult, size_t *psize)
+{
+  struct stat st;
+  size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+  size_t size;
+  size_t mapped;
+  char *map;
+
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 || (JSUINT64) st.st_size > (JSUINT64) (SIZE_MAX - pageSize))
+  {
+    return 0;
+  }
+
+  size = (size_t) st.st_size;
+  mapped = (size / pageSize + 1) * pageSize;
+
+  map = (char *) mmap(NULL, mapped, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (map == MAP_FAILED)
+  {
+    return 0;
+  }
+
+  if (mmap(map, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+  {
+    munmap(map, mapped);
+    return 0;
+  }
+
+#ifdef MADV_SEQUENTIAL
+  madvise(map, size, MADV_SEQUENTIAL);
+#endif
+
+  if (offset < 0 || (JSUINT64) offset > size)
+  {
+    offset = size;
+  }
+
+  *presult = Object_decodeBuffer(map + offset, size - (size_t) offset, 1, 0, preciseFloat, structuralIndex, fields, typedArrays);
+  *psize = size;
+  munmap(map, mapped);
+  return 1;
+}
+
+/*
+Reads what's left of fd into a bytes object, for files that can't be mapped */
+static PyObject *Object_readDescriptor(int fd)
+{
+  PyObject *bytes;
+  Py_ssize_t length = 0;
+  Py_ssize_t capacity = 65536;
+  Py_ssize_t count;
+
+  if (!(bytes = PyBytes_FromStringAndSize(NULL, capacity)))
+  {
+    return NULL;
+  }
+
+  for (;;)
+  {
+    if (length == capacity)
+    {
+      capacity *= 2;
+      if (_PyBytes_Resize(&bytes, capacity) < 0)
+      {
+        return NULL;
+      }
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    count = read(fd, PyBytes_AS_STRING(bytes) + length, capacity - length);
+    Py_END_ALLOW_THREADS
+
+    if (count < 0 && errno == EINTR)
+    {
+      if (PyErr_CheckSignals() < 0)
+      {
+        Py_DECREF(bytes);
+        return NULL;
+      }
+      continue;
+    }
+
+    if (count < 0)
+    {
+      Py_DECREF(bytes);
+      return PyErr_SetFromErrno(PyExc_IOError);
+    }
+
+    if (count == 0)
+    {
+      break;
+    }
+    length += count;
+  }
+
+  _PyBytes_Resize(&bytes, length);
+  return bytes;
+}
+
+/*
+load of a binary file object backed by a regular file, which is decoded from a mapping of it from the
+current position on and then left at its end like read() would. Returns 0 if file doesn't qualify */
+static int Object_decodeFileMapped(PyObject *file, int preciseFloat, int structuralIndex, PyObject *fields, int typedArrays, PyObject **presult)
+{
+  PyObject *raw;
+  PyObject *value;
+  JSINT64 offset;
+  size_t size;
+  int fd;
+
+  // Only a plain io.FileIO, or an io.BufferedReader over one, reads exactly what's in the file. Text files,
+  // subclasses and wrappers such as gzip.GzipFile have a descriptor too but read() returns something else
+  if ((PyObject *) Py_TYPE(file) == g_bufferedReaderType)
+  {
+    if (!(raw = PyObject_GetAttrString(file, "raw")))
+    {
+      PyErr_Clear();
+      return 0;
+    }
+    Py_DECREF(raw);
+
+    if ((PyObject *) Py_TYPE(raw) != g_fileIOType)
+    {
+      return 0;
+    }
+  }
+  else
+  if (!g_fileIOType || (PyObject *) Py_TYPE(file) != g_fileIOType)
+  {
+    return 0;
+  }
+
+  if (!(value = PyObject_CallMethod(file, "flush", NULL)))
+  {
+    PyErr_Clear();
+  }
+  Py_XDECREF(value);
+
+  if ((fd = PyObject_AsFileDescriptor(file)) < 0 || !(value = PyObject_CallMethod(file, "tell", NULL)))
+  {
+    PyErr_Clear();
+    return 0;
+  }
+
+  offset = PyLong_AsLongLong(value);
+  Py_DECREF(value);
+  if (offset == -1 && PyErr_Occurred())
+  {
+    PyErr_Clear();
+    return 0;
+  }
+
+  if (!Object_decodeMapped(fd, offset, preciseFloat, structuralIndex, fields, typedArrays, presult, &size))
+  {
+    return 0;
+  }
+
+  if (!(value = PyObject_CallMethod(file, "seek", "L", (long long) size)))
+  {
+    Py_CLEAR(*presult);
+    return 1;
+  }
+  Py_DECREF(value);
+  return 1;
+}
+#endif
+
+/*
+load of a path, which is mapped if it's a regular file */
+static PyObject *Object_decodePath(PyObject *file, int preciseFloat, int structuralIndex, PyObject *fields, int typedArrays)
+{
+  PyObject *path;
+  PyObject *result = NULL;
+  PyObject *bytes;
+#ifdef JSON_MAP_FILES
+  size_t size;
+  int fd;
+#else
+  PyObject *io;
+  PyObject *opened;
+#endif
+
+#if PY_MAJOR_VERSION >= 3
+  if (!PyUnicode_FSConverter(file, &path))
+  {
+    return NULL;
+  }
+#else
+  if (!PyString_Check(file))
+  {
+    PyErr_Format (PyExc_TypeError, "expected file or path");
+    return NULL;
+  }
+  path = file;
+  Py_INCREF(path);
+#endif
+
+#ifdef JSON_MAP_FILES
+  Py_BEGIN_ALLOW_THREADS
+  fd = open(PyString_AS_STRING(path), O_RDONLY);
+  Py_END_ALLOW_THREADS
+
+  if (fd < 0)
+  {
+    PyErr_SetFromErrnoWithFilename(PyExc_IOError, PyString_AS_STRING(path));
+    Py_DECREF(path);
+    return NULL;
+  }
+
+  if (!Object_decodeMapped(fd, 0, preciseFloat, structuralIndex, fields, typedArrays, &result, &size) && (bytes = Object_readDescriptor(fd)))
+  {
+    result = Object_decode(bytes, preciseFloat, structuralIndex, fields, typedArrays);
+    Py_DECREF(bytes);
+  }
+
+  close(fd);
+#else
+  if ((io = PyImport_ImportModule("io")))
+  {
+    if ((opened = PyObject_CallMethod(io, "open", "Os", path, "rb")))
+    {
+      if ((bytes = PyObject_CallMethod(opened, "read", NULL)))
+      {
+        result = Object_decode(bytes, preciseFloat, structuralIndex, fields, typedArrays);
+        Py_DECREF(bytes);
+      }
+
+      if (!(bytes = PyObject_CallMethod(opened, "close", NULL)))
+      {
+        Py_CLEAR(result);
+      }
+      Py_XDECREF(bytes);
+      Py_DECREF(opened);
+    }
+    Py_DECREF(io);
+  }
+#endif
+
+  Py_DECREF(path);
+  return result;
+}
+
+static char *g_filekwlist[] = {"obj", "precise_float", "structural_index", "chunk_size", "fields", "typed_arrays", NULL};
+
+PyObject* JSONFileToObj(PyObject* self, PyObject *args, PyObject *kwargs)
+{
+  PyObject *read;
+  PyObject *string;
+  PyObject *result;
+  PyObject *file = NULL;
+  PyObject *opreciseFloat = NULL;
+  PyObject *ostructuralIndex = NULL;
+  PyObject *fields = NULL;
+  PyObject *otypedArrays = NULL;
+  Py_ssize_t chunkSize = 0;
+  int preciseFloat;
+  int structuralIndex;
+  int typedArrays;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|OOnOO", g_filekwlist, &file, &opreciseFloat, &ostructuralIndex, &chunkSize, &fields, &otypedArrays))
+  {
+    return NULL;
+  }
+
+  preciseFloat = opreciseFloat && PyObject_IsTrue(opreciseFloat);
+  structuralIndex = ostructuralIndex && PyObject_IsTrue(ostructuralIndex);
+  typedArrays = otypedArrays && PyObject_IsTrue(otypedArrays);
+
+  if (chunkSize > 0 && ((fields && fields != Py_None) || typedArrays))
+  {
+    PyErr_Format(PyExc_ValueError, typedArrays ? "typed_arrays can't be used with chunk_size" : "fields can't be used with chunk_size");
+    return NULL;
+  }
+
+  if (!PyObject_HasAttrString (file, "read"))
+  {
+    return Object_decodePath(file, preciseFloat, structuralIndex, fields, typedArrays);
+  }
+
+#ifdef JSON_MAP_FILES
+  if (chunkSize <= 0 && Object_decodeFileMapped(file, preciseFloat, structuralIndex, fields, typedArrays, &result))
+  {
+    return result;
+  }
+#endif
+
+  read = PyObject_GetAttrString (file, "read");
+
+  if (!PyCallable_Check (read)) {
+    Py_XDECREF(read);
+    PyErr_Format (PyExc_TypeError, "expected file");
+    return NULL;
+  }
+
+  if (chunkSize > 0)
+  {
+    result = Object_decodeChunks(read, chunkSize, preciseFloat);
+    Py_DECREF(read);
+    return result;
+  }
+
+  string = PyObject_CallObject (read, NULL);
+  Py_XDECREF(read);
+
+  if (string == NULL)
+  {
+    return NULL;
+  }
+
+  result = Object_decode(string, preciseFloat, structuralIndex, fields, typedArrays);
+
+  Py_XDECREF(string);
+
+  return result;
+}
+
+PyObject* objToJSON(PyObject* self, PyObject *args, PyObject *kwargs);
+
+#if PY_VERSION_HEX >= 0x03030000
+/*
+Returns nonzero if a path component given as text is an array index: plain ASCII digits, no sign, space or
+underscore */
+static int Object_isIndex(PyObject *component)
+{
+  Py_ssize_t length = PyUnicode_GET_LENGTH(component);
+  Py_ssize_t index;
+  Py_UCS4 ch;
+
+  for (index = 0; index < length; index ++)
+  {
+    ch = PyUnicode_READ_CHAR(component, index);
+
+    if (ch < '0' || ch > '9')
+    {
+      return 0;
+    }
+  }
+  return length > 0;
+}
+
+/*
+Reads the value at path with a JSONReader, stepping over everything else by bracket counting. Returns
+the span of the value or raises and returns 0. Past the value only the character that ends it is looked
+at */
+static int Object_findPath(PyObject *path, const char *buffer, size_t cbBuffer, const char **pstart, const char **pend)
+{
+  JSONReader *reader;
+  JSONToken token;
+  PyObject *keys;
+  PyObject *component;
+  const char *next;
+  Py_ssize_t index;
+  Py_ssize_t count;
+  Py_ssize_t element;
+  int inObject = 0;
+  int event;
+
+  if (PyUnicode_Check(path))
+  {
+    PyObject *dot = PyUnicode_FromString(".");
+
+    if (!dot)
+    {
+      return 0;
+    }
+    keys = PyUnicode_GET_LENGTH(path) ? PyUnicode_Split(path, dot, -1) : PyTuple_New(0);
+    Py_DECREF(dot);
+  }
+  else
+  {
+    keys = PySequence_Fast(path, "path must be a str or a sequence of keys and indexes");
+  }
+
+  if (!keys)
+  {
+    return 0;
+  }
+
+  if (!(reader = JSON_Reader_Init(buffer, cbBuffer, 0, PyObject_Malloc, PyObject_Free, PyObject_Realloc)))
+  {
+    Py_DECREF(keys);
+    PyErr_NoMemory();
+    return 0;
+  }
+
+  count = PySequence_Fast_GET_SIZE(keys);
+
+  for (index = 0; index < count; index ++)
+  {
+    component = PySequence_Fast_GET_ITEM(keys, index);
+    event = JSON_Reader_Next(reader, &token);
+
+    if (event == JE_START_OBJECT)
+    {
+      const char *name;
+      Py_ssize_t length;
+
+      inObject = 1;
+
+      if (!PyUnicode_Check(component))
+      {
+        PyErr_Format(PyExc_TypeError, "Object keys in path must be str");
+        goto ERROR;
+      }
+
+      if (!(name = PyUnicode_AsUTF8AndSize(component, &length)))
+      {
+        goto ERROR;
+      }
+
+      for (;;)
+      {
+        event = JSON_Reader_Next(reader, &token);
+
+        if (event == JE_END_OBJECT)
+        {
+          PyErr_SetObject(PyExc_KeyError, component);
+          goto ERROR;
+        }
+
+        if (event != JE_KEY)
+        {
+          goto DECODE_ERROR;
+        }
+
+        if (!token.escaped)
+        {
+          if ((Py_ssize_t) (token.end - token.start) == length && memcmp(token.start, name, length) == 0)
+          {
+            break;
+          }
+        }
+        else
+        {
+          // Rare enough to unescape with the regular decoder, quotes included
+          PyObject *quoted = PyBytes_FromStringAndSize(token.start - 1, token.end - token.start + 2);
+          PyObject *key = quoted ? Object_decode(quoted, 0, 0, NULL, 0) : NULL;
+          int equal;
+
+          Py_XDECREF(quoted);
+
+          if (!key)
+          {
+            goto ERROR;
+          }
+
+          equal = PyUnicode_Compare(key, component) == 0;
+          Py_DECREF(key);
+
+          if (equal)
+          {
+            break;
+          }
+        }
+
+        if (JSON_Reader_SkipValue(reader, NULL) == JE_ERROR)
+        {
+          goto DECODE_ERROR;
+        }
+      }
+    }
+    else
+    if (event == JE_START_ARRAY)
+    {
+      inObject = 0;
+
+      if (PyUnicode_Check(component))
+      {
+        // Dotted paths give indexes as text
+        PyObject *number = Object_isIndex(component) ? PyLong_FromUnicodeObject(component, 10) : NULL;
+
+        if (!number)
+        {
+          PyErr_Clear();
+          PyErr_Format(PyExc_TypeError, "Array indexes in path must be integers");
+          goto ERROR;
+        }
+        element = PyLong_AsSsize_t(number);
+        Py_DECREF(number);
+      }
+      else
+      {
+        element = PyNumber_AsSsize_t(component, PyExc_IndexError);
+      }
+
+      if (element == -1 && PyErr_Occurred())
+      {
+        goto ERROR;
+      }
+
+      if (element < 0)
+      {
+        PyErr_Format(PyExc_IndexError, "Array index out of range");
+        goto ERROR;
+      }
+
+      for (; element > 0; element --)
+      {
+        event = JSON_Reader_SkipValue(reader, NULL);
+
+        if (event == JE_END_ARRAY)
+        {
+          PyErr_Format(PyExc_IndexError, "Array index out of range");
+          goto ERROR;
+        }
+
+        if (event == JE_ERROR)
+        {
+          goto DECODE_ERROR;
+        }
+      }
+    }
+    else
+    if (event == JE_ERROR)
+    {
+      goto DECODE_ERROR;
+    }
+    else
+    {
+      PyErr_Format(PyExc_TypeError, "Path goes through a value that isn't an object or array");
+      goto ERROR;
+    }
+  }
+
+  event = JSON_Reader_SkipValue(reader, &token);
+
+  switch (event)
+  {
+    case JE_SCALAR:
+      *pstart = token.type == JT_UTF8 ? token.start - 1 : token.start;
+      break;
+
+    case JE_START_OBJECT:
+    case JE_START_ARRAY:
+      *pstart = token.start;
+      break;
+
+    case JE_END_ARRAY:
+      PyErr_Format(PyExc_IndexError, "Array index out of range");
+      goto ERROR;
+
+    default:
+      goto DECODE_ERROR;
+  }
+
+  *pend = JSON_Reader_Offset(reader);
+
+  // The reader only finds where a scalar ends, a value like 12abc or nulll must not pass for 12 or null
+  for (next = *pend; next < buffer + cbBuffer && (*next == ' ' || *next == '\t' || *next == '\r' || *next == '\n'); next ++);
+
+  if (next < buffer + cbBuffer && (count == 0 || (*next != ',' && *next != (inObject ? '}' : ']'))))
+  {
+    PyErr_Format(PyExc_ValueError, "%s", count == 0 ? "Trailing data" : inObject ? "Unexpected character in found when decoding object value" : "Unexpected character found when decoding array value (2)");
+    goto ERROR;
+  }
+
+  JSON_Reader_Release(reader);
+  Py_DECREF(keys);
+  return 1;
+
+DECODE_ERROR:
+  PyErr_Format(PyExc_ValueError, "%s", JSON_Reader_Error(reader, NULL));
+
+ERROR:
+  JSON_Reader_Release(reader);
+  Py_DECREF(keys);
+  return 0;
+}
+#endif
+
+/*
+replace(data, path, new_value, **encoder options) splices the encoding of new_value over the value at path,
+leaving the rest of the document byte for byte as it was */
+PyObject* JSONReplace(PyObject* self, PyObject *args, PyObject *kwargs)
+{
+  PyObject *data;
+  PyObject *path;
+  PyObject *value;
+  PyObject *bytes;
+  PyObject *encoded;
+  PyObject *encodedBytes;
+  PyObject *valueArgs;
+  PyObject *result = NULL;
+  const char *start;
+  const char *end;
+  const char *buffer;
+  Py_ssize_t cbBuffer;
+  char *output;
+
+  if (!PyArg_ParseTuple(args, "OOO:replace", &data, &path, &value))
+  {
+    return NULL;
+  }
+
+  if (PyUnicode_Check(data))
+  {
+    if (!(bytes = PyUnicode_AsUTF8String(data)))
+    {
+      return NULL;
+    }
+  }
+  else
+  if (PyString_Check(data))
+  {
+    bytes = data;
+    Py_INCREF(bytes);
+  }
+  else
+  {
+    PyErr_Format(PyExc_TypeError, "Expected String or Unicode");
+    return NULL;
+  }
+
+  buffer = PyString_AS_STRING(bytes);
+  cbBuffer = PyString_GET_SIZE(bytes);
+
+#if PY_VERSION_HEX >= 0x03030000
+  if (!Object_findPath(path, buffer, cbBuffer, &start, &end))
+#else
+  PyErr_Format(PyExc_NotImplementedError, "replace needs Python 3.3 or later");
+#endif
+  {
+    Py_DECREF(bytes);
+    return NULL;
+  }
+
+  if (!(valueArgs = PyTuple_Pack(1, value)))
+  {
+    Py_DECREF(bytes);
+    return NULL;
+  }
+
+  encoded = objToJSON(self, valueArgs, kwargs);
+  Py_DECREF(valueArgs);
+
+  if (!encoded)
+  {
+    Py_DECREF(bytes);
+    return NULL;
+  }
+
+  encodedBytes = PyUnicode_Check(encoded) ? PyUnicode_AsUTF8String(encoded) : encoded;
+  if (encodedBytes != encoded)
+  {
+    Py_DECREF(encoded);
+  }
+
+  if (!encodedBytes)
+  {
+    Py_DECREF(bytes);
+    return NULL;
+  }
+
+  result = PyBytes_FromStringAndSize(NULL, (start - buffer) + PyString_GET_SIZE(encodedBytes) + (buffer + cbBuffer - end));
+
+  if (result)
+  {
+    output = PyString_AS_STRING(result);
+    memcpy(output, buffer, start - buffer);
+    output += start - buffer;
+    memcpy(output, PyString_AS_STRING(encodedBytes), PyString_GET_SIZE(encodedBytes));
+    output += PyString_GET_SIZE(encodedBytes);
+    memcpy(output, end, buffer + cbBuffer - end);
+  }
+
+  Py_DECREF(encodedBytes);
+  Py_DECREF(bytes);
+
+  if (result && PyUnicode_Check(data))
+  {
+    PyObject *text = PyUnicode_DecodeUTF8(PyString_AS_STRING(result), PyString_GET_SIZE(result), NULL);
+
+    Py_DECREF(result);
+    result = text;
+  }
+
+  return result;
+}
+
+/*
+Test hooks exposing the event parser, which the decoding entry points only use in part. Documents are given as
+str, encoded to UTF-8, or as any buffer, offsets are in bytes */
+static const char *Object_eventName(int event)
+{
+  switch (event)
+  {
+    case JE_START_OBJECT: return "start_object";
+    case JE_END_OBJECT: return "end_object";
+    case JE_START_ARRAY: return "start_array";
+    case JE_END_ARRAY: return "end_array";
+    case JE_KEY: return "key";
+    case JE_SCALAR: return "scalar";
+    case JE_END: return "end";
+    default: return "error";
+  }
+}
+
+static const char *Object_typeName(int type)
+{
+  switch (type)
+  {
+    case JT_UTF8: return "string";
+    case JT_LONG: return "long";
+    case JT_DOUBLE: return "double";
+    case JT_TRUE: return "true";
+    case JT_FALSE: return "false";
+    case JT_NULL: return "null";
+    case JT_OBJECT: return "object";
+    case JT_ARRAY: return "array";
+    default: return "invalid";
+  }
+}
+
+static int Object_getEventBuffer(PyObject *data, PyObject **pbytes, Py_buffer *view)
+{
+  *pbytes = NULL;
+
+  if (PyUnicode_Check(data))
+  {
+    if (!(*pbytes = data = PyUnicode_AsUTF8String(data)))
+    {
+      return 0;
+    }
+  }
+
+  if (PyObject_GetBuffer(data, view, PyBUF_SIMPLE) < 0)
+  {
+    Py_XDECREF(*pbytes);
+    return 0;
+  }
+  return 1;
+}
+
+static void Object_releaseEventBuffer(PyObject *bytes, Py_buffer *view)
+{
+  PyBuffer_Release(view);
+  Py_XDECREF(bytes);
+}
+
+typedef struct __SaxEvents
+{
+  PyObject *events;
+  Py_ssize_t stopAfter;
+} SaxEvents;
+
+static int SaxEvents_add(SaxEvents *se, PyObject *event)
+{
+  int ok;
+
+  if (!event)
+  {
+    return 0;
+  }
+
+  ok = PyList_Append(se->events, event) == 0;
+  Py_DECREF(event);
+  return ok && (se->stopAfter < 0 || PyList_GET_SIZE(se->events) < se->stopAfter);
+}
+
+static int SaxEvents_startObject(void *prv)
+{
+  return SaxEvents_add((SaxEvents *) prv, Py_BuildValue("(s)", Object_eventName(JE_START_OBJECT)));
+}
+
+static int SaxEvents_endObject(void *prv)
+{
+  return SaxEvents_add((SaxEvents *) prv, Py_BuildValue("(s)", Object_eventName(JE_END_OBJECT)));
+}
+
+static int SaxEvents_startArray(void *prv)
+{
+  return SaxEvents_add((SaxEvents *) prv, Py_BuildValue("(s)", Object_eventName(JE_START_ARRAY)));
+}
+
+static int SaxEvents_endArray(void *prv)
+{
+  return SaxEvents_add((SaxEvents *) prv, Py_BuildValue("(s)", Object_eventName(JE_END_ARRAY)));
+}
+
+static int SaxEvents_key(void *prv, const char *start, const char *end, int escaped)
+{
+  return SaxEvents_add((SaxEvents *) prv, Py_BuildValue("(sNi)", Object_eventName(JE_KEY), PyBytes_FromStringAndSize(start, end - start), escaped));
+}
+
+static int SaxEvents_scalar(void *prv, int type, const char *start, const char *end, int escaped)
+{
+  return SaxEvents_add((SaxEvents *) prv, Py_BuildValue("(ssNi)", Object_eventName(JE_SCALAR), Object_typeName(type), PyBytes_FromStringAndSize(start, end - start), escaped));
+}
+
+/*
+_sax_events(data, max_depth=0, stop_after=-1) runs JSON_SaxParse and returns a tuple of the list of events,
+the error message and the error offset, None for both if the document was parsed. The handler stops parsing
+once it has stop_after events if that isn't negative */
+PyObject* JSONSaxEvents(PyObject* self, PyObject *args, PyObject *kwargs)
+{
+  static char *kwlist[] = { "data", "max_depth", "stop_after", NULL };
+  PyObject *data;
+  PyObject *bytes;
+  Py_buffer view;
+  Py_ssize_t maxDepth = 0;
+  JSONSaxHandler handler;
+  SaxEvents se;
+  int ok;
+
+  se.stopAfter = -1;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|nn:_sax_events", kwlist, &data, &maxDepth, &se.stopAfter))
+  {
+    return NULL;
+  }
+
+  if (!Object_getEventBuffer(data, &bytes, &view))
+  {
+    return NULL;
+  }
+
+  if (!(se.events = PyList_New(0)))
+  {
+    Object_releaseEventBuffer(bytes, &view);
+    return NULL;
+  }
+
+  memset(&handler, 0, sizeof(handler));
+  handler.startObject = SaxEvents_startObject;
+  handler.endObject = SaxEvents_endObject;
+  handler.startArray = SaxEvents_startArray;
+  handler.endArray = SaxEvents_endArray;
+  handler.key = SaxEvents_key;
+  handler.scalar = SaxEvents_scalar;
+  handler.malloc = PyObject_Malloc;
+  handler.free = PyObject_Free;
+  handler.realloc = PyObject_Realloc;
+  handler.maxDepth = maxDepth > 0 ? (size_t) maxDepth : 0;
+  handler.prv = &se;
+
+  ok = JSON_SaxParse(&handler, (const char *) view.buf, (size_t) view.len);
+
+  if (PyErr_Occurred())
+  {
+    Py_DECREF(se.events);
+    Object_releaseEventBuffer(bytes, &view);
+    return NULL;
+  }
+
+  Object_releaseEventBuffer(bytes, &view);
+
+  if (ok)
+  {
+    return Py_BuildValue("(NOO)", se.events, Py_None, Py_None);
+  }
+  return Py_BuildValue("(Nsn)", se.events, handler.errorStr, (Py_ssize_t) (handler.errorOffset - (char *) view.buf));
+}
+
+/*
+_reader_events(data, ops, max_depth=0) reads data with a JSONReader, calling JSON_Reader_Next for each 'n' in
+ops and JSON_Reader_SkipValue for each 's', until ops run out or the document ends or fails. Returns a tuple
+of the list of (event, type, span) read, the error message and offset, None if there was none, and the
+offset where reading would continue */
+PyObject* JSONReaderEvents(PyObject* self, PyObject *args, PyObject *kwargs)
+{
+  static char *kwlist[] = { "data", "ops", "max_depth", NULL };
+  PyObject *data;
+  PyObject *bytes;
+  PyObject *events;
+  PyObject *event;
+  PyObject *result;
+  Py_buffer view;
+  Py_ssize_t maxDepth = 0;
+  const char *ops;
+  const char *errorStr;
+  const char *errorOffset;
+  JSONReader *reader;
+  JSONToken token;
+  int type = JE_END;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Os|n:_reader_events", kwlist, &data, &ops, &maxDepth))
+  {
+    return NULL;
+  }
+
+  if (!Object_getEventBuffer(data, &bytes, &view))
+  {
+    return NULL;
+  }
+
+  if (!(reader = JSON_Reader_Init((const char *) view.buf, (size_t) view.len, maxDepth > 0 ? (size_t) maxDepth : 0, PyObject_Malloc, PyObject_Free, PyObject_Realloc)))
+  {
+    Object_releaseEventBuffer(bytes, &view);
+    return PyErr_NoMemory();
+  }
+
+  if (!(events = PyList_New(0)))
+  {
+    goto ERROR;
+  }
+
+  for (; *ops; ops ++)
+  {
+    if (*ops != 'n' && *ops != 's')
+    {
+      PyErr_Format(PyExc_ValueError, "ops must only hold 'n' and 's'");
+      goto ERROR;
+    }
+
+    type = *ops == 'n' ? JSON_Reader_Next(reader, &token) : JSON_Reader_SkipValue(reader, &token);
+    event = Py_BuildValue("(ssN)", Object_eventName(type), Object_typeName(token.type), PyBytes_FromStringAndSize(token.start, token.end - token.start));
+
+    if (!event || PyList_Append(events, event) < 0)
+    {
+      Py_XDECREF(event);
+      goto ERROR;
+    }
+    Py_DECREF(event);
+
+    if (type == JE_END || type == JE_ERROR)
+    {
+      break;
+    }
+  }
+
+  if ((errorStr = JSON_Reader_Error(reader, &errorOffset)))
+  {
+    result = Py_BuildValue("(Nsnn)", events, errorStr, (Py_ssize_t) (errorOffset - (const char *) view.buf), (Py_ssize_t) (JSON_Reader_Offset(reader) - (const char *) view.buf));
+  }
+  else
+  {
+    result = Py_BuildValue("(NOOn)", events, Py_None, Py_None, (Py_ssize_t) (JSON_Reader_Offset(reader) - (const char *) view.buf));
+  }
+
+  JSON_Reader_Release(reader);
+  Object_releaseEventBuffer(bytes, &view);
+  return result;
+
+ERROR:
+  Py_XDECREF(events);
+  JSON_Reader_Release(reader);
+  Object_releaseEventBuffer(bytes, &view);
+  return NULL;
+}
+
+#if PY_VERSION_HEX >= 0x03030000
+/*
+loads_lazy keeps the input and a JSONTape of it, and hands out LazyObject and LazyArray views over the tape.
+Scalars are decoded with the regular decoder when they're accessed, containers become new views */
+typedef struct __LazyTape
+{
+  PyObject_HEAD
+  PyObject *bytes;
+  JSONTapeEntry *entries;
+  size_t count;
+  KeyCache keyCache;
+  JSONObjectDecoder decoder;
+} LazyTape;
+
+typedef struct __LazyView
+{
+  PyObject_HEAD
+  LazyTape *tape;
+  JSUINT32 index;
+
+  // Tape index of each element of an array, made on the first indexed access. For objects the tape index of
+  // the value of each distinct key, made the first time they are counted or listed
+  JSUINT32 *elements;
+  JSUINT32 members;
+} LazyView;
+
+static PyTypeObject LazyTapeType;
+static PyTypeObject LazyObjectType;
+static PyTypeObject LazyArrayType;
+
+static void LazyTape_dealloc(LazyTape *tape)
+{
+  Object_releaseDecoder(&tape->decoder);
+  PyObject_Free(tape->entries);
+  Py_XDECREF(tape->bytes);
+  Py_TYPE(tape)->tp_free((PyObject *) tape);
+}
+
+static void LazyView_dealloc(LazyView *view)
+{
+  PyMem_Free(view->elements);
+  Py_DECREF(view->tape);
+  Py_TYPE(view)->tp_free((PyObject *) view);
+}
+
+static JSUINT32 LazyTape_next(LazyTape *tape, JSUINT32 index)
+{
+  JSONTapeEntry *entry = &tape->entries[index];
+  return (entry->type == JT_OBJECT || entry->type == JT_ARRAY) ? entry->end : index + 1;
+}
+
+static PyObject *LazyTape_value(LazyTape *tape, JSUINT32 index)
+{
+  JSONTapeEntry *entry = &tape->entries[index];
+  LazyView *view;
+  JSOBJ ret;
+
+  if (entry->type == JT_OBJECT || entry->type == JT_ARRAY)
+  {
+    view = PyObject_New(LazyView, entry->type == JT_OBJECT ? &LazyObjectType : &LazyArrayType);
+    if (!view)
+    {
+      return NULL;
+    }
+
+    Py_INCREF(tape);
+    view->tape = tape;
+    view->index = index;
+    view->elements = NULL;
+    view->members = 0;
+    return (PyObject *) view;
+  }
+
+  ret = JSON_DecodeObject(&tape->decoder, PyBytes_AS_STRING(tape->bytes) + entry->start, entry->end - entry->start);
+  return Object_decodeError(&tape->decoder, ret);
+}
+
+/*
+Returns the tape index of the value of key in the object at index, 0 if there's none or -1 on error. Keys
+without escapes are compared as bytes, others are decoded first. Like loads the last of duplicate keys wins,
+so all keys are looked at */
+static Py_ssize_t LazyTape_find(LazyTape *tape, JSUINT32 index, PyObject *key)
+{
+  JSONTapeEntry *entry;
+  const char *buffer = PyBytes_AS_STRING(tape->bytes);
+  const char *name;
+  Py_ssize_t length;
+  Py_ssize_t found = 0;
+  JSUINT32 count = tape->entries[index].count;
+
+  if (!PyUnicode_Check(key))
+  {
+    return 0;
+  }
+
+  if (!(name = PyUnicode_AsUTF8AndSize(key, &length)))
+  {
+    return -1;
+  }
+
+  for (index ++; count > 0; count --)
+  {
+    entry = &tape->entries[index];
+
+    if (memchr(buffer + entry->start + 1, '\\', entry->end - entry->start - 2))
+    {
+      PyObject *decoded = LazyTape_value(tape, index);
+      int equal;
+
+      if (!decoded)
+      {
+        return -1;
+      }
+
+      equal = PyUnicode_Compare(decoded, key) == 0;
+      Py_DECREF(decoded);
+
+      if (equal)
+      {
+        found = index + 1;
+      }
+    }
+    else
+    if ((Py_ssize_t) (entry->end - entry->start - 2) == length && memcmp(buffer + entry->start + 1, name, length) == 0)
+    {
+      found = index + 1;
+    }
+
+    index = LazyTape_next(tape, index + 1);
+  }
+
+  return found;
+}
+
+static Py_ssize_t LazyView_length(LazyView *view)
+{
+  return view->tape->entries[view->index].count;
+}
+
+/*
+Makes the member index of an object: its distinct keys in the order they first appear, each with the value
+of its last occurrence, as loads makes them. Returns 0 on error */
+static int LazyObject_members(LazyView *view)
+{
+  LazyTape *tape = view->tape;
+  JSUINT32 count = tape->entries[view->index].count;
+  JSUINT32 index = view->index + 1;
+  JSUINT32 member;
+  PyObject *positions;
+  PyObject *key;
+  PyObject *position;
+
+  if (view->elements)
+  {
+    return 1;
+  }
+
+  if (!(view->elements = (JSUINT32 *) PyMem_Malloc((count ? count : 1) * sizeof(JSUINT32))))
+  {
+    PyErr_NoMemory();
+    return 0;
+  }
+
+  if (!(positions = PyDict_New()))
+  {
+    goto ERROR;
+  }
+
+  for (member = 0; member < count; member ++)
+  {
+    if (!(key = LazyTape_value(tape, index)))
+    {
+      goto ERROR;
+    }
+
+    if ((position = PyDict_GetItem(positions, key)))
+    {
+      view->elements[PyLong_AsSsize_t(position)] = index + 1;
+    }
+    else
+    {
+      position = PyLong_FromSsize_t((Py_ssize_t) view->members);
+
+      if (!position || PyDict_SetItem(positions, key, position) < 0)
+      {
+        Py_XDECREF(position);
+        Py_DECREF(key);
+        goto ERROR;
+      }
+
+      Py_DECREF(position);
+      view->elements[view->members ++] = index + 1;
+    }
+
+    Py_DECREF(key);
+    index = LazyTape_next(tape, index + 1);
+  }
+
+  Py_DECREF(positions);
+  return 1;
+
+ERROR:
+  Py_XDECREF(positions);
+  PyMem_Free(view->elements);
+  view->elements = NULL;
+  view->members = 0;
+  return 0;
+}
+
+static Py_ssize_t LazyObject_length(LazyView *view)
+{
+  return LazyObject_members(view) ? (Py_ssize_t) view->members : -1;
+}
+
+static PyObject *LazyObject_subscript(LazyView *view, PyObject *key)
+{
+  Py_ssize_t index = LazyTape_find(view->tape, view->index, key);
+
+  if (index == 0)
+  {
+    PyErr_SetObject(PyExc_KeyError, key);
+  }
+
+  return index > 0 ? LazyTape_value(view->tape, (JSUINT32) index) : NULL;
+}
+
+static int LazyObject_contains(LazyView *view, PyObject *key)
+{
+  Py_ssize_t index = LazyTape_find(view->tape, view->index, key);
+  return index < 0 ? -1 : index > 0;
+}
+
+static PyObject *LazyObject_get(LazyView *view, PyObject *args)
+{
+  PyObject *key;
+  PyObject *defaultValue = Py_None;
+  Py_ssize_t index;
+
+  if (!PyArg_ParseTuple(args, "O|O:get", &key, &defaultValue))
+  {
+    return NULL;
+  }
+
+  if ((index = LazyTape_find(view->tape, view->index, key)) < 0)
+  {
+    return NULL;
+  }
+
+  if (index == 0)
+  {
+    Py_INCREF(defaultValue);
+    return defaultValue;
+  }
+
+  return LazyTape_value(view->tape, (JSUINT32) index);
+}
+
+/*
+Lists the keys (what 0), values (1) or (key, value) pairs (2) of an object */
+static PyObject *LazyObject_list(LazyView *view, int what)
+{
+  LazyTape *tape = view->tape;
+  JSUINT32 member;
+  PyObject *list;
+  PyObject *key;
+  PyObject *value;
+
+  if (!LazyObject_members(view) || !(list = PyList_New(view->members)))
+  {
+    return NULL;
+  }
+
+  for (member = 0; member < view->members; member ++)
+  {
+    key = what != 1 ? LazyTape_value(tape, view->elements[member] - 1) : NULL;
+    value = what != 0 ? LazyTape_value(tape, view->elements[member]) : NULL;
+
+    if ((what != 1 && !key) || (what != 0 && !value))
+    {
+      Py_XDECREF(key);
+      Py_XDECREF(value);
+      Py_DECREF(list);
+      return NULL;
+    }
+
+    if (what == 2)
+    {
+      PyObject *item = PyTuple_Pack(2, key, value);
+
+      Py_DECREF(key);
+      Py_DECREF(value);
+
+      if (!item)
+      {
+        Py_DECREF(list);
+        return NULL;
+      }
+      PyList_SET_ITEM(list, member, item);
+    }
+    else
+    {
+      PyList_SET_ITEM(list, member, what == 0 ? key : value);
+    }
+  }
+
+  return list;
+}
+
+static PyObject *LazyObject_keys(LazyView *view, PyObject *unused)
+{
+  return LazyObject_list(view, 0);
+}
+
+static PyObject *LazyObject_values(LazyView *view, PyObject *unused)
+{
+  return LazyObject_list(view, 1);
+}
+
+static PyObject *LazyObject_items(LazyView *view, PyObject *unused)
+{
+  return LazyObject_list(view, 2);
+}
+
+static PyObject *LazyObject_iter(LazyView *view)
+{
+  PyObject *keys = LazyObject_list(view, 0);
+  PyObject *iter;
+
+  if (!keys)
+  {
+    return NULL;
+  }
+
+  iter = PyObject_GetIter(keys);
+  Py_DECREF(keys);
+  return iter;
+}
+
+static PyObject *LazyArray_item(LazyView *view, Py_ssize_t item)
+{
+  LazyTape *tape = view->tape;
+  JSUINT32 count = tape->entries[view->index].count;
+  JSUINT32 element;
+  JSUINT32 index;
+
+  if (item < 0 || item >= (Py_ssize_t) count)
+  {
+    PyErr_SetString(PyExc_IndexError, "list index out of range");
+    return NULL;
+  }
+
+  if (!view->elements)
+  {
+    if (!(view->elements = (JSUINT32 *) PyMem_Malloc(count * sizeof(JSUINT32))))
+    {
+      return PyErr_NoMemory();
+    }
+
+    for (element = 0, index = view->index + 1; element < count; element ++)
+    {
+      view->elements[element] = index;
+      index = LazyTape_next(tape, index);
+    }
+  }
+
+  return LazyTape_value(tape, view->elements[item]);
+}
+
+static PyMappingMethods LazyObject_as_mapping =
+{
+  (lenfunc) LazyObject_length,
+  (binaryfunc) LazyObject_subscript,
+  NULL
+};
+
+static PySequenceMethods LazyObject_as_sequence =
+{
+  0, 0, 0, 0, 0, 0, 0,
+  (objobjproc) LazyObject_contains
+};
+
+static PySequenceMethods LazyArray_as_sequence =
+{
+  (lenfunc) LazyView_length,
+  0,
+  0,
+  (ssizeargfunc) LazyArray_item
+};
+
+static PyMethodDef LazyObject_methods[] =
+{
+  {"get", (PyCFunction) LazyObject_get, METH_VARARGS, "Returns the value of key, or default if there's none."},
+  {"keys", (PyCFunction) LazyObject_keys, METH_NOARGS, "Returns a list of the keys."},
+  {"values", (PyCFunction) LazyObject_values, METH_NOARGS, "Returns a list of the values."},
+  {"items", (PyCFunction) LazyObject_items, METH_NOARGS, "Returns a list of (key, value) pairs."},
+  {NULL, NULL, 0, NULL}
+};
+
+static PyTypeObject LazyTapeType =
+{
+  PyVarObject_HEAD_INIT(NULL, 0)
+  "ujson._LazyTape",
+  sizeof(LazyTape),
+  0,
+  (destructor) LazyTape_dealloc,
+};
+
+static PyTypeObject LazyObjectType =
+{
+  PyVarObject_HEAD_INIT(NULL, 0)
+  "ujson.LazyObject",
+  sizeof(LazyView),
+  0,
+  (destructor) LazyView_dealloc,
+};
+
+static PyTypeObject LazyArrayType =
+{
+  PyVarObject_HEAD_INIT(NULL, 0)
+  "ujson.LazyArray",
+  sizeof(LazyView),
+  0,
+  (destructor) LazyView_dealloc,
+};
+#endif
+
+/*
+Decoder keeps the decoder, its escape buffer and key cache and the parsed options from call to call, so
+decode() only has the document to deal with */
+typedef struct __Decoder
+{
+  PyObject_HEAD
+  JSONObjectDecoder decoder;
+#if PY_VERSION_HEX >= 0x03030000
+  KeyCache keyCache;
+#else
+  void *keyCache;
+#endif
+  JSONProjection *projection;
+  PyObject *trie;
+} Decoder;
+
+#define DECODER_ESCAPE_BUFFER_LENGTH 256
+
+static void Decoder_clear(Decoder *self)
+{
+  if (self->decoder.escBuffer)
+  {
+    Object_releaseDecoder(&self->decoder);
+    self->decoder.free(self->decoder.escBuffer);
+    self->decoder.escBuffer = NULL;
+  }
+
+#if PY_VERSION_HEX >= 0x03030000
+  if (self->projection)
+  {
+    Projection_free(self->projection);
+    self->projection = NULL;
+  }
+#endif
+  Py_CLEAR(self->trie);
+}
+
+static void Decoder_dealloc(Decoder *self)
+{
+  Decoder_clear(self);
+  Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+static char *g_decoderkwlist[] = {"precise_float", "fields", "typed_arrays", NULL};
+
+static int Decoder_init(Decoder *self, PyObject *args, PyObject *kwargs)
+{
+  PyObject *opreciseFloat = NULL;
+  PyObject *fields = NULL;
+  PyObject *otypedArrays = NULL;
+  int typedArrays;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|OOO", g_decoderkwlist, &opreciseFloat, &fields, &otypedArrays))
+  {
+    return -1;
+  }
+
+  typedArrays = otypedArrays && PyObject_IsTrue(otypedArrays);
+  if (typedArrays && !g_doubleArray)
+  {
+    PyErr_Format(PyExc_ValueError, "typed_arrays needs Python 3.3 or later");
+    return -1;
+  }
+
+  Decoder_clear(self);
+
+  if (fields && fields != Py_None)
+  {
+#if PY_VERSION_HEX >= 0x03030000
+    if (!(self->projection = Projection_new(fields, &self->trie)))
+    {
+      return -1;
+    }
+#else
+    PyErr_Format(PyExc_ValueError, "fields needs Python 3.3 or later");
+    return -1;
+#endif
+  }
+
+  Object_initDecoder(&self->decoder, &self->keyCache, opreciseFloat && PyObject_IsTrue(opreciseFloat));
+  self->decoder.projection = self->projection;
+#if PY_VERSION_HEX >= 0x03030000
+  self->decoder.newNumericArray = typedArrays ? Object_newNumericArray : NULL;
+#endif
+
+  if (!(self->decoder.escBuffer = (wchar_t *) self->decoder.malloc(DECODER_ESCAPE_BUFFER_LENGTH * sizeof(wchar_t))))
+  {
+    PyErr_NoMemory();
+    return -1;
+  }
+  self->decoder.escBufferLength = DECODER_ESCAPE_BUFFER_LENGTH;
+  return 0;
+}
+
+static PyObject *Decoder_decode(Decoder *self, PyObject *arg)
+{
+  PyObject *sarg;
+  Py_buffer view;
+  JSOBJ ret;
+#if PY_VERSION_HEX >= 0x03030000
+  const char *buffer;
+  Py_ssize_t length;
+  int latin1;
+#endif
+
+  if (!self->decoder.escBuffer)
+  {
+    PyErr_Format(PyExc_ValueError, "Decoder is not initialized");
+    return NULL;
+  }
+
+  self->decoder.latin1 = 0;
+
+  if (PyString_Check(arg))
+  {
+    ret = JSON_DecodeObject(&self->decoder, PyString_AS_STRING(arg), PyString_GET_SIZE(arg));
+  }
+  else
+#if PY_VERSION_HEX >= 0x03030000
+  if (PyUnicode_Check(arg) && (buffer = Object_strBuffer(arg, &length, &latin1)))
+  {
+    self->decoder.latin1 = latin1;
+    ret = JSON_DecodeObject(&self->decoder, buffer, length);
+  }
+  else
+#endif
+  if (PyUnicode_Check(arg))
+  {
+    if (!(sarg = PyUnicode_AsUTF8String(arg)))
+    {
+      return NULL;
+    }
+    ret = JSON_DecodeObject(&self->decoder, PyString_AS_STRING(sarg), PyString_GET_SIZE(sarg));
+    Py_DECREF(sarg);
+  }
+  else
+  if (PyObject_CheckBuffer(arg))
+  {
+    // The view also keeps a bytearray from being resized while it's decoded
+    if (PyObject_GetBuffer(arg, &view, PyBUF_SIMPLE) < 0)
+    {
+      return NULL;
+    }
+
+    if (PyByteArray_Check(arg))
+    {
+      ret = JSON_DecodeObject(&self->decoder, (const char *) view.buf, view.len);
+    }
+    else
+    if (self->projection || self->decoder.newNumericArray)
+    {
+      // The bounded mode doesn't project or collect numeric arrays
+      sarg = PyBytes_FromStringAndSize((const char *) view.buf, view.len);
+      ret = sarg ? JSON_DecodeObject(&self->decoder, PyString_AS_STRING(sarg), PyString_GET_SIZE(sarg)) : NULL;
+      Py_XDECREF(sarg);
+    }
+    else
+    {
+      ret = JSON_DecodeObjectBounded(&self->decoder, (const char *) view.buf, view.len);
+    }
+    PyBuffer_Release(&view);
+
+    if (!ret && PyErr_Occurred())
+    {
+      return NULL;
+    }
+  }
+  else
+  {
+    PyErr_Format(PyExc_TypeError, "Expected String or Unicode");
+    return NULL;
+  }
+
+  return Object_decodeError(&self->decoder, ret);
+}
+
+static PyMethodDef Decoder_methods[] =
+{
+  {"decode", (PyCFunction) Decoder_decode, METH_O, "Converts JSON as string to dict object structure, same as loads with the options of the decoder."},
+  {NULL, NULL, 0, NULL}
+};
+
+static PyTypeObject DecoderType =
+{
+  PyVarObject_HEAD_INIT(NULL, 0)
+  "ujson.Decoder",
+  sizeof(Decoder),
+  0,
+  (destructor) Decoder_dealloc,
+};
+
+int initJSONToObj(PyObject *module)
+{
+#if PY_VERSION_HEX >= 0x03030000
+  PyObject *mod_array;
+#endif
+#ifdef JSON_MAP_FILES
+  PyObject *mod_io;
+#endif
+
+  DecoderType.tp_flags = Py_TPFLAGS_DEFAULT;
+  DecoderType.tp_doc = "Decoder(precise_float=False, fields=None, typed_arrays=False), reusable decoder that keeps its options and buffers from one decode() to the next.";
+  DecoderType.tp_methods = Decoder_methods;
+  DecoderType.tp_init = (initproc) Decoder_init;
+  DecoderType.tp_new = PyType_GenericNew;
+
+  if (PyType_Ready(&DecoderType) < 0)
+  {
+    return -1;
+  }
+
+  Py_INCREF(&DecoderType);
+  PyModule_AddObject(module, "Decoder", (PyObject *) &DecoderType);
+
+#if PY_VERSION_HEX >= 0x03030000
+  LazyTapeType.tp_flags = Py_TPFLAGS_DEFAULT;
+
+  LazyObjectType.tp_flags = Py_TPFLAGS_DEFAULT;
+  LazyObjectType.tp_doc = "Read-only view of a JSON object returned by loads_lazy, values are decoded when accessed.";
+  LazyObjectType.tp_as_mapping = &LazyObject_as_mapping;
+  LazyObjectType.tp_as_sequence = &LazyObject_as_sequence;
+  LazyObjectType.tp_iter = (getiterfunc) LazyObject_iter;
+  LazyObjectType.tp_methods = LazyObject_methods;
+
+  LazyArrayType.tp_flags = Py_TPFLAGS_DEFAULT;
+  LazyArrayType.tp_doc = "Read-only view of a JSON array returned by loads_lazy, values are decoded when accessed.";
+  LazyArrayType.tp_as_sequence = &LazyArray_as_sequence;
+
+  if (PyType_Ready(&LazyTapeType) < 0 || PyType_Ready(&LazyObjectType) < 0 || PyType_Ready(&LazyArrayType) < 0)
+  {
+    return -1;
+  }
+
+  Py_INCREF(&LazyObjectType);
+  PyModule_AddObject(module, "LazyObject", (PyObject *) &LazyObjectType);
+  Py_INCREF(&LazyArrayType);
+  PyModule_AddObject(module, "LazyArray", (PyObject *) &LazyArrayType);
+
+  // typed_arrays is refused without them
+  if ((mod_array = PyImport_ImportModule("array")))
+  {
+    g_longArray = PyObject_CallMethod(mod_array, "array", "s[i]", "q", 0);
+    g_doubleArray = g_longArray ? PyObject_CallMethod(mod_array, "array", "s[d]", "d", 0.0) : NULL;
+    Py_DECREF(mod_array);
+  }
+  if (!g_doubleArray)
+  {
+    PyErr_Clear();
+  }
+#endif
+
+#ifdef JSON_MAP_FILES
+  // Without them every file object is read
+  if ((mod_io = PyImport_ImportModule("io")))
+  {
+    g_fileIOType = PyObject_GetAttrString(mod_io, "FileIO");
+    g_bufferedReaderType = g_fileIOType ? PyObject_GetAttrString(mod_io, "BufferedReader") : NULL;
+    Py_DECREF(mod_io);
+  }
+  if (!g_bufferedReaderType)
+  {
+    Py_CLEAR(g_fileIOType);
+    PyErr_Clear();
+  }
+#endif
+  return 0;
+}
+
+static char *g_lazykwlist[] = {"obj", "precise_float", NULL};
+
+PyObject* JSONToObjLazy(PyObject* self, PyObject *args, PyObject *kwargs)
+{
+#if PY_VERSION_HEX >= 0x03030000
+  PyObject *arg;
+  PyObject *bytes;
+  PyObject *opreciseFloat = NULL;
+  PyObject *ret;
+  LazyTape *tape;
+  JSONTape built;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O", g_lazykwlist, &arg, &opreciseFloat))
+  {
+    return NULL;
+  }
+
+  if (PyUnicode_Check(arg))
+  {
+    if (!(bytes = PyUnicode_AsUTF8String(arg)))
+    {
+      return NULL;
+    }
+  }
+  else
+  if (PyBytes_Check(arg))
+  {
+    bytes = arg;
+    Py_INCREF(bytes);
+  }
+  else
+  {
+    PyErr_Format(PyExc_TypeError, "Expected String or Unicode");
+    return NULL;
+  }
+
+  if (!JSON_BuildTape(&built, PyBytes_AS_STRING(bytes), PyBytes_GET_SIZE(bytes), 0, PyObject_Malloc, PyObject_Free, PyObject_Realloc))
+  {
+    Py_DECREF(bytes);
+    PyErr_Format(PyExc_ValueError, "%s", built.errorStr);
+    return NULL;
+  }
+
+  if (!(tape = PyObject_New(LazyTape, &LazyTapeType)))
+  {
+    PyObject_Free(built.entries);
+    Py_DECREF(bytes);
+    return NULL;
+  }
+
+  tape->bytes = bytes;
+  tape->entries = built.entries;
+  tape->count = built.count;
+  Object_initDecoder(&tape->decoder, &tape->keyCache, opreciseFloat && PyObject_IsTrue(opreciseFloat));
+
+  ret = LazyTape_value(tape, 0);
+  Py_DECREF(tape);
+  return ret;
+#else
+  PyErr_Format(PyExc_NotImplementedError, "loads_lazy needs Python 3.3 or later");
+  return NULL;
+#endif
+}
+
+#if PY_VERSION_HEX >= 0x03030000
+/*
+loads_columns collects the fields of the records into one column per key. A column keeps its values as numbers
+(JT_LONG or JT_DOUBLE, by the rules of typed_arrays) until a value that isn't one turns up, then they become
+objects in list (type JT_INVALID). Records without the key get None */
+typedef struct __Column
+{
+  PyObject *name;
+  int type;
+  union
+  {
+    JSINT64 *longs;
+    double *doubles;
+  } numbers;
+  // Set for the doubles that were integers, which are made ints again if the column becomes a list
+  char *integers;
+  size_t count;
+  size_t capacity;
+  PyObject *list;
+} Column;
+
+typedef struct __ColumnsContext
+{
+  KeyCache keyCache;
+  Column *columns;
+  size_t count;
+  size_t capacity;
+  // Key names to column numbers, for keys that aren't where the previous record had them
+  PyObject *index;
+  size_t row;
+  size_t field;
+} ColumnsContext;
+
+#define COLUMN_EXACT_DOUBLE(value) ((value) >= -(1LL << 53) && (value) <= (1LL << 53))
+
+/*
+Turns the numbers of column into objects in its list */
+static int Column_toList(Column *column)
+{
+  PyObject *item;
+  size_t index;
+
+  if (!(column->list = PyList_New((Py_ssize_t) column->count)))
+  {
+    return 0;
+  }
+
+  for (index = 0; index < column->count; index ++)
+  {
+    if (column->type == JT_LONG)
+    {
+      item = PyLong_FromLongLong(column->numbers.longs[index]);
+    }
+    else
+    if (column->integers && column->integers[index])
+    {
+      item = PyLong_FromLongLong((JSINT64) column->numbers.doubles[index]);
+    }
+    else
+    {
+      item = PyFloat_FromDouble(column->numbers.doubles[index]);
+    }
+
+    if (!item)
+    {
+      return 0;
+    }
+    PyList_SET_ITEM(column->list, index, item);
+  }
+
+  PyMem_Free(column->numbers.longs);
+  PyMem_Free(column->integers);
+  column->numbers.longs = NULL;
+  column->integers = NULL;
+  column->capacity = 0;
+  column->type = JT_INVALID;
+  return 1;
+}
+
+/*
+Starts flagging which doubles of column were integers, the ones it has so far as integer */
+static int Column_trackIntegers(Column *column, int integer)
+{
+  if (!(column->integers = (char *) PyMem_Malloc(column->capacity)))
+  {
+    PyErr_NoMemory();
+    return 0;
+  }
+  memset(column->integers, integer, column->count);
+  return 1;
+}
+
+/*
+Appends value, or the number at number if type is JT_LONG or JT_DOUBLE, to column. value is borrowed */
+static int Column_append(Column *column, int type, PyObject *value, const void *number)
+{
+  JSINT64 longValue = 0;
+  double doubleValue = 0.0;
+  int integer = 0;
+  size_t index;
+  void *numbers;
+
+  if (type == JT_LONG)
+  {
+    memcpy(&longValue, number, sizeof(longValue));
+  }
+  else
+  if (type == JT_DOUBLE)
+  {
+    memcpy(&doubleValue, number, sizeof(doubleValue));
+  }
+
+  if (column->type == JT_LONG && type == JT_DOUBLE)
+  {
+    for (index = 0; index < column->count && COLUMN_EXACT_DOUBLE(column->numbers.longs[index]); index ++);
+
+    if (index == column->count)
+    {
+      if (!Column_trackIntegers(column, 1))
+      {
+        return 0;
+      }
+
+      for (index = 0; index < column->count; index ++)
+      {
+        column->numbers.doubles[index] = (double) column->numbers.longs[index];
+      }
+      column->type = JT_DOUBLE;
+    }
+  }
+  else
+  if (column->type == JT_DOUBLE && type == JT_LONG && COLUMN_EXACT_DOUBLE(longValue))
+  {
+    if (!column->integers && !Column_trackIntegers(column, 0))
+    {
+      return 0;
+    }
+
+    type = JT_DOUBLE;
+    doubleValue = (double) longValue;
+    integer = 1;
+  }
+
+  if (column->type != JT_INVALID && column->type != type && !Column_toList(column))
+  {
+    return 0;
+  }
+
+  if (column->type == JT_INVALID)
+  {
+    if (type == JT_LONG)
+    {
+      value = PyLong_FromLongLong(longValue);
+    }
+    else
+    if (type == JT_DOUBLE)
+    {
+      value = PyFloat_FromDouble(doubleValue);
+    }
+    else
+    {
+      Py_INCREF(value);
+    }
+
+    if (!value || PyList_Append(column->list, value) < 0)
+    {
+      Py_XDECREF(value);
+      return 0;
+    }
+
+    Py_DECREF(value);
+    column->count ++;
+    return 1;
+  }
+
+  if (column->count == column->capacity)
+  {
+    if (!(numbers = PyMem_Realloc(column->numbers.longs, column->capacity * 2 * sizeof(JSINT64))))
+    {
+      PyErr_NoMemory();
+      return 0;
+    }
+    column->numbers.longs = (JSINT64 *) numbers;
+
+    if (column->integers)
+    {
+      if (!(numbers = PyMem_Realloc(column->integers, column->capacity * 2)))
+      {
+        PyErr_NoMemory();
+        return 0;
+      }
+      column->integers = (char *) numbers;
+    }
+    column->capacity *= 2;
+  }
+
+  if (column->integers)
+  {
+    column->integers[column->count] = (char) integer;
+  }
+
+  if (type == JT_LONG)
+  {
+    column->numbers.longs[column->count++] = longValue;
+  }
+  else
+  {
+    column->numbers.doubles[column->count++] = doubleValue;
+  }
+  return 1;
+}
+
+/*
+Brings column to count values, with None for the records that didn't have the key, or takes off the value
+of a key found twice in a record, where the last one counts like in a dict */
+static int Column_resize(Column *column, size_t count)
+{
+  while (column->count < count)
+  {
+    if (!Column_append(column, JT_INVALID, Py_None, NULL))
+    {
+      return 0;
+    }
+  }
+
+  if (column->count > count)
+  {
+    if (column->list && PyList_SetSlice(column->list, (Py_ssize_t) count, (Py_ssize_t) column->count, NULL) < 0)
+    {
+      return 0;
+    }
+    column->count = count;
+  }
+  return 1;
+}
+
+/*
+Adds the column for name, whose first value is of type, taking the reference to name */
+static Column *Columns_add(ColumnsContext *context, PyObject *name, int type)
+{
+  Column *column;
+  PyObject *number;
+  void *columns;
+  int ok;
+
+  if (context->count == context->capacity)
+  {
+    if (!(columns = PyMem_Realloc(context->columns, (context->capacity * 2 + 8) * sizeof(Column))))
+    {
+      PyErr_NoMemory();
+      Py_DECREF(name);
+      return NULL;
+    }
+    context->columns = (Column *) columns;
+    context->capacity = context->capacity * 2 + 8;
+  }
+
+  if (!(number = PyLong_FromSize_t(context->count)))
+  {
+    Py_DECREF(name);
+    return NULL;
+  }
+  ok = PyDict_SetItem(context->index, name, number);
+  Py_DECREF(number);
+
+  column = &context->columns[context->count++];
+  column->name = name;
+  column->type = type;
+  column->numbers.longs = NULL;
+  column->integers = NULL;
+  column->count = 0;
+  column->capacity = 0;
+  column->list = NULL;
+
+  if (ok < 0)
+  {
+    return NULL;
+  }
+
+  if (type == JT_INVALID)
+  {
+    return (column->list = PyList_New(0)) ? column : NULL;
+  }
+
+  if (!(column->numbers.longs = (JSINT64 *) PyMem_Malloc(64 * sizeof(JSINT64))))
+  {
+    PyErr_NoMemory();
+    return NULL;
+  }
+  column->capacity = 64;
+  return column;
+}
+
+static int Columns_addField(void *prv, size_t row, JSOBJ name, int type, JSOBJ value, const void *number)
+{
+  ColumnsContext *context = (ColumnsContext *) prv;
+  Column *column = NULL;
+  PyObject *found;
+  int ok;
+
+  if (row != context->row)
+  {
+    context->row = row;
+    context->field = 0;
+  }
+
+  // Records tend to list their keys in the same order, so the column next to the last one is tried first
+  if (context->field < context->count && context->columns[context->field].name == (PyObject *) name)
+  {
+    column = &context->columns[context->field];
+    Py_DECREF((PyObject *) name);
+  }
+  else
+  if ((found = PyDict_GetItem(context->index, (PyObject *) name)))
+  {
+    column = &context->columns[PyLong_AsSsize_t(found)];
+    Py_DECREF((PyObject *) name);
+  }
+  else
+  {
+    column = Columns_add(context, (PyObject *) name, row ? JT_INVALID : type);
+  }
+
+  ok = column && Column_resize(column, row) && Column_append(column, type, (PyObject *) value, number);
+  Py_XDECREF((PyObject *) value);
+
+  if (column)
+  {
+    context->field = (size_t) (column - context->columns) + 1;
+  }
+  return ok;
+}
+
+static void Columns_release(ColumnsContext *context)
+{
+  size_t index;
+
+  for (index = 0; index < context->count; index ++)
+  {
+    Py_DECREF(context->columns[index].name);
+    Py_XDECREF(context->columns[index].list);
+    PyMem_Free(context->columns[index].numbers.longs);
+    PyMem_Free(context->columns[index].integers);
+  }
+
+  PyMem_Free(context->columns);
+  Py_XDECREF(context->index);
+  KeyCache_release(&context->keyCache);
+}
+#endif
+
+static char *g_columnskwlist[] = {"obj", "precise_float", NULL};
+
+/*
+loads_columns(data) decodes an array of objects into a dict of one column per key, array.array for numbers and
+lists for the rest, without building the objects in between */
+PyObject* JSONColumnsToObj(PyObject* self, PyObject *args, PyObject *kwargs)
+{
+#if PY_VERSION_HEX >= 0x03030000
+  PyObject *arg;
+  PyObject *bytes = NULL;
+  PyObject *opreciseFloat = NULL;
+  PyObject *ret = NULL;
+  PyObject *column;
+  JSONObjectDecoder decoder;
+  ColumnsContext context;
+  Py_buffer view;
+  const char *buffer;
+  Py_ssize_t length;
+  int latin1 = 0;
+  size_t rows;
+  size_t index;
+  int ok;
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|O", g_columnskwlist, &arg, &opreciseFloat))
+  {
+    return NULL;
+  }
+
+  if (!g_doubleArray)
+  {
+    PyErr_Format(PyExc_ValueError, "loads_columns needs the array module");
+    return NULL;
+  }
+
+  if (PyUnicode_Check(arg))
+  {
+    if (!(buffer = Object_strBuffer(arg, &length, &latin1)))
+    {
+      if (!(bytes = PyUnicode_AsUTF8String(arg)))
+      {
+        return NULL;
+      }
+      buffer = PyBytes_AS_STRING(bytes);
+      length = PyBytes_GET_SIZE(bytes);
+    }
+  }
+  else
+  if (PyBytes_Check(arg))
+  {
+    buffer = PyBytes_AS_STRING(arg);
+    length = PyBytes_GET_SIZE(arg);
+  }
+  else
+  if (PyObject_CheckBuffer(arg))
+  {
+    // The view also keeps a bytearray from being resized while it's decoded
+    if (PyObject_GetBuffer(arg, &view, PyBUF_SIMPLE) < 0)
+    {
+      return NULL;
+    }
+
+    if (PyByteArray_Check(arg))
+    {
+      buffer = (const char *) view.buf;
+      length = view.len;
+    }
+    else
+    {
+      // Other buffers aren't known to be followed by a '\0', they're decoded from a copy
+      bytes = PyBytes_FromStringAndSize((const char *) view.buf, view.len);
+      PyBuffer_Release(&view);
+
+      if (!bytes)
+      {
+        return NULL;
+      }
+      buffer = PyBytes_AS_STRING(bytes);
+      length = PyBytes_GET_SIZE(bytes);
+    }
+  }
+  else
+  {
+    PyErr_Format(PyExc_TypeError, "Expected String or Unicode");
+    return NULL;
+  }
+
+  Object_initDecoder(&decoder, &context, opreciseFloat && PyObject_IsTrue(opreciseFloat));
+  decoder.latin1 = latin1;
+  context.columns = NULL;
+  context.count = 0;
+  context.capacity = 0;
+  context.row = 0;
+  context.field = 0;
+
+  if ((context.index = PyDict_New()))
+  {
+    ok = JSON_DecodeRecords(&decoder, buffer, (size_t) length, Columns_addField, &rows);
+
+    if (!ok)
+    {
+      if (!PyErr_Occurred())
+      {
+        PyErr_Format(PyExc_ValueError, "%s", decoder.errorStr);
+      }
+    }
+    else
+    if ((ret = PyDict_New()))
+    {
+      for (index = 0; index < context.count; index ++)
+      {
+        Column *current = &context.columns[index];
+
+        if (!Column_resize(current, rows))
+        {
+          Py_CLEAR(ret);
+          break;
+        }
+
+        column = current->list ? current->list : (PyObject *) Object_newNumericArray(NULL, current->type, current->numbers.longs, current->count);
+        if (!column || PyDict_SetItem(ret, current->name, column) < 0)
+        {
+          if (column && !current->list)
+          {
+            Py_DECREF(column);
+          }
+          Py_CLEAR(ret);
+          break;
+        }
+
+        if (!current->list)
+        {
+          Py_DECREF(column);
+        }
+      }
+    }
+  }
+
+  Columns_release(&context);
+  Py_XDECREF(bytes);
+  if (PyByteArray_Check(arg))
+  {
+    PyBuffer_Release(&view);
+  }
+  return ret;
+#else
+  PyErr_Format(PyExc_NotImplementedError, "loads_columns needs Python 3.3 or later");
+  return NULL;
+#endif
 }
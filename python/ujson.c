@@ -45,6 +45,10 @@ void initObjToJSON(void);
 
 /* JSONToObj */
 PyObject* JSONToObj(PyObject* self, PyObject *args, PyObject *kwargs);
+PyObject* JSONToObjLazy(PyObject* self, PyObject *args, PyObject *kwargs);
+PyObject* JSONLinesToObj(PyObject* self, PyObject *args, PyObject *kwargs);
+PyObject* JSONColumnsToObj(PyObject* self, PyObject *args, PyObject *kwargs);
+int initJSONToObj(PyObject *module);
 
 /* objToJSONFile */
 PyObject* objToJSONFile(PyObject* self, PyObject *args, PyObject *kwargs);
@@ -52,16 +56,29 @@ PyObject* objToJSONFile(PyObject* self, PyObject *args, PyObject *kwargs);
 /* JSONFileToObj */
 PyObject* JSONFileToObj(PyObject* self, PyObject *args, PyObject *kwargs);
 
+/* JSONReplace */
+PyObject* JSONReplace(PyObject* self, PyObject *args, PyObject *kwargs);
+
+/* Test hooks */
+PyObject* JSONSaxEvents(PyObject* self, PyObject *args, PyObject *kwargs);
+PyObject* JSONReaderEvents(PyObject* self, PyObject *args, PyObject *kwargs);
+
 
 #define ENCODER_HELP_TEXT "Use ensure_ascii=false to output UTF-8. Pass in double_precision to alter the maximum digit precision of doubles. Set encode_html_chars=True to encode < > & as unicode escape sequences. Set escape_forward_slashes=False to prevent escaping / characters."
 
 static PyMethodDef ujsonMethods[] = {
   {"encode", (PyCFunction) objToJSON, METH_VARARGS | METH_KEYWORDS, "Converts arbitrary object recursively into JSON. " ENCODER_HELP_TEXT},
-  {"decode", (PyCFunction) JSONToObj, METH_VARARGS | METH_KEYWORDS, "Converts JSON as string to dict object structure. Use precise_float=True to use high precision float decoder."},
+  {"decode", (PyCFunction) JSONToObj, METH_VARARGS | METH_KEYWORDS, "Converts JSON as string, bytes or buffer to dict object structure. Use precise_float=True to use high precision float decoder. Use typed_arrays=True to get arrays of numbers as array.array."},
   {"dumps", (PyCFunction) objToJSON, METH_VARARGS | METH_KEYWORDS,  "Converts arbitrary object recursively into JSON. " ENCODER_HELP_TEXT},
-  {"loads", (PyCFunction) JSONToObj, METH_VARARGS | METH_KEYWORDS,  "Converts JSON as string to dict object structure. Use precise_float=True to use high precision float decoder."},
+  {"loads", (PyCFunction) JSONToObj, METH_VARARGS | METH_KEYWORDS,  "Converts JSON as string, bytes or buffer to dict object structure. Use precise_float=True to use high precision float decoder. Use typed_arrays=True to get arrays of numbers as array.array."},
   {"dump", (PyCFunction) objToJSONFile, METH_VARARGS | METH_KEYWORDS, "Converts arbitrary object recursively into JSON file. " ENCODER_HELP_TEXT},
-  {"load", (PyCFunction) JSONFileToObj, METH_VARARGS | METH_KEYWORDS, "Converts JSON as file to dict object structure. Use precise_float=True to use high precision float decoder."},
+  {"load", (PyCFunction) JSONFileToObj, METH_VARARGS | METH_KEYWORDS, "Converts JSON as file or path to dict object structure, regular files are decoded from a memory mapping. Use precise_float=True to use high precision float decoder. Use typed_arrays=True to get arrays of numbers as array.array."},
+  {"loads_lines", (PyCFunction) JSONLinesToObj, METH_VARARGS | METH_KEYWORDS, "Converts JSON Lines, one document per line, from a string or file to a list of objects. Blank lines are skipped. Use collect_errors=True to get a tuple of the list and a list of (line number, message) for the invalid lines instead of raising. Use threads=N to parse up to N parts of the input, of at least 64 KB each, in parallel. Use precise_float=True to use high precision float decoder."},
+  {"loads_columns", (PyCFunction) JSONColumnsToObj, METH_VARARGS | METH_KEYWORDS, "Converts a JSON array of objects to a dict of columns, one per key, without building the objects. Columns of numbers are array.array like with typed_arrays=True, the others lists, with None where an object lacks the key. Use precise_float=True to use high precision float decoder."},
+  {"loads_lazy", (PyCFunction) JSONToObjLazy, METH_VARARGS | METH_KEYWORDS, "Returns a read-only view of the JSON document in a string, LazyObject or LazyArray, that decodes values only when they're accessed. Scalar documents are decoded right away. Use precise_float=True to use high precision float decoder."},
+  {"replace", (PyCFunction) JSONReplace, METH_VARARGS | METH_KEYWORDS, "Replaces the value at path, a dotted str or a sequence of keys and array indexes, with new_value encoded to JSON and returns the new document. Only the part of the document up to the end of the value is read. Encoder options are passed on to the encoder."},
+  {"_sax_events", (PyCFunction) JSONSaxEvents, METH_VARARGS | METH_KEYWORDS, "For the tests, runs the event parser over a document and returns (events, error, error offset)."},
+  {"_reader_events", (PyCFunction) JSONReaderEvents, METH_VARARGS | METH_KEYWORDS, "For the tests, reads a document with JSON_Reader_Next ('n' in ops) and JSON_Reader_SkipValue ('s') and returns (events, error, error offset, offset)."},
   {NULL, NULL, 0, NULL}       /* Sentinel */
 };
 
@@ -104,6 +121,11 @@ PYMODINITFUNC
     MODINITERROR;
   }
 
+  if (initJSONToObj(module) < 0)
+  {
+    MODINITERROR;
+  }
+
   version_string = PyString_FromString (UJSON_VERSION);
   PyModule_AddObject (module, "__version__", version_string);
 
@@ -200,6 +200,23 @@ def benchmark_array_doubles():
     decode_data = None
 
 
+def benchmark_coordinate_arrays():
+    global decode_data, test_object
+    results_new_benchmark("GeoJSON-like array with 256 [lon, lat] coordinate pairs")
+    COUNT = 10000
+
+    test_object = []
+    for x in range(256):
+        test_object.append([round(random.uniform(-180, 180), 7), round(random.uniform(-90, 90), 7)])
+    run_encode(COUNT)
+
+    decode_data = json.dumps(test_object)
+    test_object = None
+    run_decode(COUNT)
+
+    decode_data = None
+
+
 def benchmark_array_utf8_strings():
     global decode_data, test_object
     results_new_benchmark("Array with 256 UTF-8 strings")
@@ -323,6 +340,42 @@ def benchmark_complex_object():
     decode_data = None
 
 
+def benchmark_complex_object_indented():
+    global decode_data, test_object
+    COUNT = 100
+
+    with open(os.path.join(os.path.dirname(__file__), "sample.json"), "r") as f:
+       test_object = json.load(f)
+
+    results_new_benchmark("Complex object, compact")
+    decode_data = ujson.dumps(test_object)
+    run_decode(COUNT)
+
+    results_new_benchmark("Complex object, indent=4")
+    decode_data = ujson.dumps(test_object, indent=4)
+    run_decode(COUNT)
+
+    decode_data = None
+    test_object = None
+
+
+def benchmark_ndjson_threads():
+    COUNT = 3
+    print("loads_lines with 20000 lines of medium complex objects")
+
+    line = json.dumps({"words": "Lorem ipsum dolor sit amet", "friends": FRIENDS, "id": 1234567, "score": 91.25})
+    data = "\n".join([line]*20000)
+
+    serial = None
+    threads = 1
+    while threads <= max(os.cpu_count() or 1, 4):
+        results = timeit.repeat(lambda: ujson.loads_lines(data, threads=threads), repeat=5, number=COUNT)
+        elapsed = min(results) / COUNT
+        serial = serial or elapsed
+        print("{} threads: {:.02f} ms ({:.02f}x)".format(threads, elapsed * 1000, serial / elapsed))
+        threads *= 2
+
+
 # =============================================================================
 # Main.
 # =============================================================================
@@ -330,8 +383,13 @@ if __name__ == "__main__":
     if len(sys.argv) > 1 and "skip-lib-comps" in sys.argv:
         skip_lib_comparisons = True
 
+    if "ndjson-threads" in sys.argv:
+        benchmark_ndjson_threads()
+        sys.exit()
+
     benchmark_array_doubles()
     """
+    benchmark_coordinate_arrays()
     benchmark_array_utf8_strings()
     benchmark_array_byte_strings()
     benchmark_medium_complex_object()
@@ -339,5 +397,6 @@ if __name__ == "__main__":
     benchmark_array_of_dict_string_int_pairs()
     benchmark_dict_of_arrays_of_dict_string_int_pairs()
     benchmark_complex_object()
+    benchmark_complex_object_indented()
     """
     results_output_table()
@@ -3,12 +3,19 @@ from __future__ import print_function, unicode_literals
 import six
 from six.moves import range, zip
 
+import array
 import calendar
 import datetime
+import bz2
 import functools
+import gc
+import gzip
+import io
 import decimal
 import json
 import math
+import os
+import tempfile
 import time
 import pytz
 if six.PY2:
@@ -23,6 +30,11 @@ try:
 except ImportError:
     blist = None
 
+try:
+    import tracemalloc
+except ImportError:
+    tracemalloc = None
+
 json_unicode = json.dumps if six.PY3 else functools.partial(json.dumps, encoding="utf-8")
 
 
@@ -635,8 +647,26 @@ class UltraJSONTests(unittest.TestCase):
         f = filelike()
         self.assertEqual([1, 2, 3, 4], ujson.load(f))
 
+    def test_loadFileInChunks(self):
+        doc = json.dumps({"a\\\"b": [1.5, -20, "caf\u00e9 \\", None, {"x": [True, False]}], "n" * 40: "\U0001f600" * 9})
+        for chunk_size in (1, 2, 3, 5, 8, 13, 64, 4096):
+            self.assertEqual(json.loads(doc), ujson.load(six.StringIO(doc), chunk_size=chunk_size))
+            self.assertEqual(json.loads(doc), ujson.load(six.BytesIO(doc.encode("utf-8")), chunk_size=chunk_size))
+
+    def test_loadFileInChunksErrors(self):
+        for doc in ("", "[1,]", "[12ab]", '{"a" 1}', '"abc', '[1] x', "[" * 1025 + "]" * 1025, "tru", "[1"):
+            for chunk_size in (1, 3, 100):
+                self.assertRaises(ValueError, ujson.load, six.StringIO(doc), chunk_size=chunk_size)
+
+        class failing:
+            def read(self, size):
+                raise IOError("boom")
+        self.assertRaises(IOError, ujson.load, failing(), chunk_size=10)
+
     def test_loadFileArgsError(self):
-        self.assertRaises(TypeError, ujson.load, "[]")
+        self.assertRaises(TypeError, ujson.load, 1)
+        # A str is taken as a path
+        self.assertRaises(IOError, ujson.load, "[]")
 
     def test_version(self):
         if six.PY2:
@@ -688,6 +718,586 @@ class UltraJSONTests(unittest.TestCase):
             input = quote + (base * 1024 * 1024 * 2) + quote
             ujson.decode(input)
 
+    def test_decodeStringSpecialsAtEveryOffset(self):
+        # Puts escapes, quotes and multibyte characters on both sides of
+        # every 16 and 32 byte boundary the string scanner works with.
+        for special in ("\\\"", "\\\\", "\\n", "\\u00e5", "å", "日", "\U0001f600"):
+            for n in range(70):
+                doc = "[\"" + "x" * n + special + "y" * (70 - n) + "\", \"" + "z" * n + "\"]"
+                self.assertEqual(json.loads(doc), ujson.decode(doc))
+                self.assertEqual(json.loads(doc), ujson.decode(doc.encode("utf-8")))
+
+    def test_decodeStringWidths(self):
+        # One string per storage width, plus the same characters escaped.
+        for s in ("ascii only", "café naïve", "日本語 ال", "smile \U0001f600 å"):
+            self.assertEqual(s, ujson.decode(json.dumps(s, ensure_ascii=False)))
+            self.assertEqual(s, ujson.decode(json.dumps(s, ensure_ascii=True)))
+            self.assertEqual([s, s], ujson.decode(json.dumps([s, s])))
+        self.assertEqual("\udc00 lone", ujson.decode("\"\\udc00 lone\""))
+
+    def test_decodeStringSwitchesToEscapeBuffer(self):
+        # Strings are read in place until the first character that needs
+        # rewriting, after which the prefix is copied and decoding goes on.
+        for tail in ("\\t", "\\u00e9\u00e9", "\\ud83d\\ude00"):
+            for head in ("", "plain ", "\u00e5\u65e5 " * 9, "\U0001f600" * 5):
+                doc = "\"" + head + tail + head + "\""
+                self.assertEqual(json.loads(doc), ujson.decode(doc))
+                self.assertEqual(json.loads(doc), ujson.decode(doc.encode("utf-8")))
+        self.assertEqual("ab\x80cd", ujson.decode(b"\"ab\x80cd\""))
+
+    def test_decodeRepeatedKeysShareObjects(self):
+        doc = json.dumps([{"id": i, "name": "n", "caf\u00e9": i, "k" * 100: i} for i in range(1000)])
+        result = ujson.decode(doc)
+        self.assertEqual(json.loads(doc), result)
+        first = list(result[0])[:2]
+        for record in result:
+            self.assertTrue(all(a is b for a, b in zip(first, list(record)[:2])))
+        self.assertEqual({"a\"b": 1, "a": 2}, ujson.decode('{"a\\"b": 1, "a": 2}'))
+        # Keys are shared within a call but not interned, an interned "append" already exists
+        key = list(ujson.decode('{"append": 1}'))[0]
+        self.assertIsNot(six.moves.intern("append"), key)
+
+    def test_decodeStructuralIndexMatchesRecursive(self):
+        docs = ['[]', '{}', ' [ 1 , "a" , { "b" : [ null , true , false ] } ] ', '"top"', '-1.5e3', '{"a":1,}',
+                json.dumps([{"id": i, "s": "x" * i + "\\" * (i % 3) + "\"", "f": i / 3.0} for i in range(200)]),
+                json.dumps({"k" * 70: ["v\\" * 40, {"n": [[[]]]}]}, indent=4), "[" * 500 + "]" * 500]
+        for doc in docs:
+            self.assertEqual(ujson.loads(doc), ujson.loads(doc, structural_index=True))
+            self.assertEqual(ujson.loads(doc), ujson.loads(doc.encode("utf-8"), structural_index=True))
+
+    def test_decodeStructuralIndexErrors(self):
+        for doc in ("", " ", "[", "[1,]", "[,1]", "[1 2]", "[12ab]", "{1:2}", '{"a" 1}', '{"a":}', '[1]]',
+                    '[1] x', '"abc', '["a\\"]', "[" * 1025 + "]" * 1025, "[tru]", "nul"):
+            self.assertRaises(ValueError, ujson.loads, doc)
+            self.assertRaises(ValueError, ujson.loads, doc, structural_index=True)
+
+    def test_decodeDeepNestingWithoutRecursion(self):
+        # Open containers live on a heap stack, which starts with room for 64
+        doc = '{"a": [' * 511 + '{"b": "\\u00e9"}' + ']}' * 511
+        result = ujson.loads(doc)
+        for i in range(511):
+            result = result["a"][0]
+        self.assertEqual({"b": "\u00e9"}, result)
+        self.assertRaises(ValueError, ujson.loads, '{"a": [' * 512 + '{}' + ']}' * 512)
+        self.assertRaises(ValueError, ujson.loads, '[[' * 100 + ']' * 199)
+        self.assertRaises(ValueError, ujson.loads, '[{"a": [1, {"b": ' * 100)
+
+    def test_decodeFields(self):
+        doc = ('{"id": 7, "route": {"dest": "a\\u00e9", "prio": 3}, "skip": [1, {"x": "]}\\""}],'
+               ' "items": [{"id": 1, "v": [1, 2]}, {"id": 2}, 3], "m\\u0065ta": {"a": 1}}')
+        self.assertEqual({"id": 7, "route": {"dest": "a\u00e9"}, "items": [{"id": 1}, {"id": 2}, 3], "meta": {"a": 1}},
+                         ujson.loads(doc, fields=["id", "route.dest", ("items", "id"), "meta"]))
+        self.assertEqual({"route": {"dest": "a\u00e9", "prio": 3}}, ujson.loads(doc, fields=["route", "route.dest"]))
+        self.assertEqual({}, ujson.loads(doc, fields=[]))
+        self.assertEqual([{"id": 1}, {}], ujson.loads('[{"id": 1, "x": 2}, {"y": 3}]', fields={"id"}))
+        self.assertEqual({"id": 7}, ujson.load(six.StringIO(doc), fields=["id"]))
+
+    def test_decodeFieldsErrors(self):
+        # Skipped values are only checked for balanced brackets and terminated strings
+        self.assertEqual({}, ujson.loads('{"x": [1 2 {"a" 3}]}', fields=["a"]))
+        for doc in ('{"x": [1, 2}', '{"x": "abc', '{"x": }', '{"x" 1}', '{"x": 1 "a": 2}', '{"a": [1,]}', '{"x": 1} 2'):
+            self.assertRaises(ValueError, ujson.loads, doc, fields=["a"])
+        self.assertRaises(TypeError, ujson.loads, "{}", fields="a")
+        self.assertRaises(TypeError, ujson.loads, "{}", fields=[1])
+        self.assertRaises(ValueError, ujson.loads, "{}", fields=[[]])
+        self.assertRaises(ValueError, ujson.loads, "{}", fields=["a"], structural_index=True)
+        self.assertRaises(ValueError, ujson.load, six.StringIO("{}"), fields=["a"], chunk_size=1)
+
+    def test_replace(self):
+        doc = '{"id": 12, "ts": "2020",  "n\\u0061me": [1, {"x": [0, 1, 2]}, "s"], "rest": {"a": [true]}}'
+        self.assertEqual(doc.replace("12", "99"), ujson.replace(doc, "id", 99))
+        self.assertEqual(doc.replace('"s"', "null"), ujson.replace(doc, "name.2", None))
+        self.assertEqual(doc.replace("2]}", '{"b":"\\u00e9"}]}'), ujson.replace(doc, ["name", 1, "x", 2], {"b": "\u00e9"}))
+        self.assertEqual(doc.replace('"2020"', '"\u00e9"').encode("utf-8"),
+                         ujson.replace(doc.encode("utf-8"), ("ts",), "\u00e9", ensure_ascii=False))
+        self.assertEqual(" [] ", ujson.replace(" {} ", "", []))
+        # Past the value only the character that ends it is read
+        self.assertEqual('[1, 2, {', ujson.replace('[0, 2, {', [0], 1))
+        self.assertEqual('{"a": [5] }', ujson.replace('{"a": 1.5 }', "a", [5]))
+        self.assertEqual('[0, 1]', ujson.replace('[0, 2]', "1", 1))
+        self.assertEqual('[0, 1', ujson.replace('[0, 2', "1", 1))
+
+    def test_replaceErrors(self):
+        doc = '{"id": 12, "list": [1, 2], "obj": {}}'
+        self.assertRaises(KeyError, ujson.replace, doc, "nope", 1)
+        self.assertRaises(IndexError, ujson.replace, doc, "list.2", 1)
+        self.assertRaises(IndexError, ujson.replace, doc, ["list", -1], 1)
+        self.assertRaises(TypeError, ujson.replace, doc, "list.x", 1)
+        self.assertRaises(TypeError, ujson.replace, doc, "id.x", 1)
+        self.assertRaises(TypeError, ujson.replace, doc, 3, 1)
+        self.assertRaises(ValueError, ujson.replace, '{"a": 1', "b", 1)
+        self.assertRaises(ValueError, ujson.replace, '{"a" 1}', "a", 1)
+        self.assertRaises(OverflowError, ujson.replace, doc, "id", 2 ** 70)
+        # A value is only replaced where loads would read it
+        for bad in ("12abc", "nulll", "truex", "1.5.5", "1e", '"a" "b"', "[1] x", "1]"):
+            self.assertRaises(ValueError, ujson.replace, '{"a": %s, "b":2}' % bad, "a", 5)
+            self.assertRaises(ValueError, ujson.replace, '[%s, 2]' % bad.replace("]", "}"), [0], 5)
+        self.assertRaises(ValueError, ujson.replace, "12abc", "", 5)
+        self.assertRaises(ValueError, ujson.replace, "1 2", [], 5)
+        for index in ("+1", " 1", "1 ", "-0", "1_0", "\u0661", ""):
+            self.assertRaises(TypeError, ujson.replace, "[0, 1]", [index], 5)
+
+    def test_loadsLazy(self):
+        doc = ujson.loads_lazy('{"a": 1, "b": [1, 2.5, "x\\u00e9", {"c": null}], "k\\u0065y": true}')
+        self.assertTrue(isinstance(doc, ujson.LazyObject))
+        self.assertEqual(3, len(doc))
+        self.assertEqual(1, doc["a"])
+        self.assertTrue(doc["key"])
+        self.assertTrue("key" in doc)
+        self.assertFalse("c" in doc)
+        self.assertEqual(["a", "b", "key"], list(doc))
+        self.assertEqual(5, doc.get("c", 5))
+        self.assertRaises(KeyError, lambda: doc["c"])
+        items = doc["b"]
+        self.assertTrue(isinstance(items, ujson.LazyArray))
+        self.assertEqual(4, len(items))
+        self.assertEqual("x\u00e9", items[2])
+        self.assertEqual({"c": None}, dict(items[-1].items()))
+        self.assertEqual([1, 2.5, "x\u00e9"], list(items)[:3])
+        self.assertRaises(IndexError, lambda: items[4])
+        self.assertEqual(5, ujson.loads_lazy(b"5"))
+        self.assertEqual(0, len(ujson.loads_lazy(b" [ ] ")))
+
+    def test_loadsLazyDuplicateKeys(self):
+        # Like loads the last value of a key wins, keys stay where they first appear
+        data = '{"a": 1, "b": [2], "\\u0061": 3, "c": 4, "a": {"x": 5}}'
+        doc = ujson.loads_lazy(data)
+        self.assertEqual({"x": 5}, dict(doc["a"].items()))
+        self.assertEqual({"x": 5}, dict(doc.get("a").items()))
+        self.assertEqual(3, len(doc))
+        self.assertEqual(list(ujson.loads(data)), list(doc))
+        self.assertEqual(["a", "b", "c"], doc.keys())
+        self.assertEqual([2], list(doc.values()[1]))
+        self.assertEqual(4, doc.items()[2][1])
+        doc = ujson.loads_lazy('{"a": 1, "a": 2}')
+        self.assertEqual((2, 1, [("a", 2)]), (doc["a"], len(doc), doc.items()))
+
+    def test_loadsLazyErrors(self):
+        for doc in ("", "{", "[1,]", '{"a" 1}', "[1] x", '["abc', "[tru]"):
+            self.assertRaises(ValueError, ujson.loads_lazy, doc)
+        # Values are only decoded when accessed
+        doc = ujson.loads_lazy(b'[1, "\xc0\x80", 123456789012345678901234567890]')
+        self.assertEqual(1, doc[0])
+        self.assertRaises(ValueError, lambda: doc[1])
+        self.assertRaises(ValueError, lambda: doc[2])
+        self.assertRaises(TypeError, ujson.loads_lazy, 1)
+
+    def test_loadsLines(self):
+        data = '{"a": 1}\n\n  \r\n[1, "x\\u00e9"]\r\n"' + "\\u00e9" * 10000 + '"\n5'
+        expected = [{"a": 1}, [1, "x\u00e9"], "\u00e9" * 10000, 5]
+        self.assertEqual(expected, ujson.loads_lines(data))
+        self.assertEqual(expected, ujson.loads_lines(data.encode("utf-8")))
+        self.assertEqual(expected, ujson.loads_lines(six.StringIO(data)))
+        self.assertEqual([], ujson.loads_lines(""))
+        self.assertEqual([[1.1]], ujson.loads_lines("[1.1]\n", precise_float=True))
+
+    def test_loadsLinesErrors(self):
+        data = '[1]\n{"a": \n"abc\n[2] 3\n4'
+        self.assertEqual(([[1], 4], [(2, "Expected object or value"), (3, "Unmatched ''\"' when when decoding 'string'"),
+                                     (4, "Trailing data")]),
+                         ujson.loads_lines(data, collect_errors=True))
+        try:
+            ujson.loads_lines(data)
+        except ValueError as e:
+            self.assertEqual("Line 2: Expected object or value", str(e))
+        else:
+            self.fail("ValueError not raised")
+        self.assertRaises(TypeError, ujson.loads_lines, 1)
+
+    def test_loadsLinesThreads(self):
+        data = "\n".join(['{"id": %d, "name": "x\\u00e9%d", "v": [1.5, -2, 18446744073709551615, null, true]}' % (x, x)
+                          for x in range(4000)]) + "\n\n"
+        expected = ujson.loads_lines(data)
+        # Ranges are at least 64 KB, so threads is capped by the size of the input
+        for threads in (2, 3, 16, 5000, 2 ** 31 - 1):
+            self.assertEqual(expected, ujson.loads_lines(data, threads=threads))
+        self.assertEqual([[1]], ujson.loads_lines("[1]", threads=2 ** 31 - 1))
+        self.assertEqual([], ujson.loads_lines("", threads=4))
+        self.assertRaises(ValueError, ujson.loads_lines, data, threads=0)
+
+    def test_loadsLinesThreadsErrors(self):
+        data = "\n".join("[%d]" % x if x % 10000 else "{" for x in range(1, 30000))
+        objects, errors = ujson.loads_lines(data, collect_errors=True)
+        message = "Key name of object must be 'string' when decoding 'object'"
+        self.assertEqual([(10000, message), (20000, message)], errors)
+        self.assertEqual((objects, errors), ujson.loads_lines(data, collect_errors=True, threads=4))
+        try:
+            ujson.loads_lines(data, threads=4)
+        except ValueError as e:
+            self.assertEqual("Line 10000: " + message, str(e))
+        else:
+            self.fail("ValueError not raised")
+
+    def test_decoder(self):
+        decoder = ujson.Decoder()
+        for doc in ('{"a": [1, 2.5, null]}', b'"x\\u00e9"', '["' + "\\n" * 100000 + '"]', '"short\\t"', "[]"):
+            self.assertEqual(ujson.loads(doc), decoder.decode(doc))
+        self.assertEqual(1.1, ujson.Decoder(precise_float=True).decode("1.1"))
+        self.assertEqual({"a": {"b": 1}}, ujson.Decoder(fields=["a.b"]).decode('{"a": {"b": 1, "c": 2}, "d": 3}'))
+
+    def test_decoderErrors(self):
+        decoder = ujson.Decoder()
+        self.assertRaises(ValueError, decoder.decode, '{"a": ')
+        self.assertRaises(ValueError, decoder.decode, '"\\u00e9" 1')
+        self.assertRaises(TypeError, decoder.decode, 1)
+        self.assertEqual([1], decoder.decode("[1]"))
+        self.assertRaises(ValueError, ujson.Decoder.__new__(ujson.Decoder).decode, "1")
+        self.assertRaises(TypeError, ujson.Decoder, fields=[1])
+
+    @unittest.skipIf(tracemalloc is None, "Needs tracemalloc")
+    def test_decodeEscapeBufferSize(self):
+        doc = ('["a\\n", "' + "x" * 10000000 + '"]').encode("ascii")
+        tracemalloc.start()
+        try:
+            result = ujson.loads(doc)
+            peak = tracemalloc.get_traced_memory()[1]
+        finally:
+            tracemalloc.stop()
+        self.assertEqual(["a\n", "x" * 10000000], result)
+        # The escape buffer is sized to the escaped string, not to the rest of the document
+        self.assertLess(peak, 1.5 * len(doc))
+
+    def test_decodeEscapeBufferGrowth(self):
+        decoder = ujson.Decoder()
+        for length in (10, 1000, 100000, 10, 300000):
+            doc = '["' + "\\u00e9\\n" * length + '", "\\t"]'
+            self.assertEqual(["\u00e9\n" * length, "\t"], ujson.loads(doc))
+            self.assertEqual(["\u00e9\n" * length, "\t"], decoder.decode(doc))
+        self.assertRaises(ValueError, ujson.loads, '["' + "\\n" * 100000)
+
+    def test_loadPath(self):
+        directory = tempfile.mkdtemp()
+        path = os.path.join(directory, "doc.json")
+        try:
+            # Sizes around a page check that the byte after the mapping reads as the end of the input
+            for size in (1, 4095, 4096, 4097, 8192):
+                doc = b"[" + b" " * (size - 2) + b"]" if size > 1 else b"7"
+                with open(path, "wb") as f:
+                    f.write(doc)
+                self.assertEqual(ujson.loads(doc), ujson.load(path))
+                self.assertEqual(ujson.loads(doc), ujson.load(path.encode("utf-8"), structural_index=True))
+                with open(path, "wb") as f:
+                    f.write(doc[:-1] + b"[")
+                self.assertRaises(ValueError, ujson.load, path)
+
+            with open(path, "wb") as f:
+                f.write(b'xx{"a": "\\u00e9", "b": [1]}')
+            with open(path, "rb") as f:
+                f.read(2)
+                self.assertEqual({"a": "\u00e9", "b": [1]}, ujson.load(f))
+                self.assertEqual(b"", f.read())
+            with open(path, "wb") as f:
+                f.write(b'{"a": "\\u00e9", "b": [1]}')
+            self.assertEqual({"b": [1]}, ujson.load(path, fields=["b"]))
+        finally:
+            os.remove(path)
+            os.rmdir(directory)
+
+    def test_loadWrappedFiles(self):
+        # Only plain binary files are mapped, other file objects with a descriptor are read
+        directory = tempfile.mkdtemp()
+        path = os.path.join(directory, "doc.json")
+        opens = [gzip.open, bz2.BZ2File]
+        try:
+            import lzma
+            opens.append(lzma.open)
+        except ImportError:
+            pass
+
+        class Reader(io.BufferedReader):
+            def read(self, *args):
+                return b"[42]"
+
+        try:
+            for opener in opens:
+                with opener(path, "wb") as f:
+                    f.write(b'{"a": [1, 2, 3]}')
+                with opener(path, "rb") as f:
+                    self.assertEqual({"a": [1, 2, 3]}, ujson.load(f))
+            with open(path, "wb") as f:
+                f.write(b"[1]")
+            with Reader(io.FileIO(path)) as f:
+                self.assertEqual([42], ujson.load(f))
+            with open(path, "rb", buffering=0) as f:
+                self.assertEqual([1], ujson.load(f))
+                self.assertEqual(b"", f.read())
+        finally:
+            os.remove(path)
+            os.rmdir(directory)
+
+    def test_loadPathErrors(self):
+        directory = tempfile.mkdtemp()
+        path = os.path.join(directory, "doc.json")
+        try:
+            self.assertRaises(IOError, ujson.load, path)
+            with open(path, "wb") as f:
+                pass
+            self.assertRaises(ValueError, ujson.load, path)
+            with open(path, "w") as f:
+                f.write("[1, 2]")
+            with open(path) as f:
+                self.assertEqual([1, 2], ujson.load(f))
+            self.assertEqual([3], ujson.load(six.BytesIO(b"[3]")))
+        finally:
+            os.remove(path)
+            os.rmdir(directory)
+
+    def test_decodeBuffers(self):
+        doc = b'{"a": [1, 2.5, "x\\u00e9"], "b": null}'
+        expected = ujson.loads(doc)
+        for junk in (b"1", b" ", b'"', b"e"):
+            view = memoryview(junk * 4 + doc + junk * 4)[4:-4]
+            self.assertEqual(expected, ujson.loads(view))
+            self.assertEqual(expected, ujson.Decoder().decode(view))
+            self.assertEqual(expected, ujson.loads(view, structural_index=True))
+        self.assertEqual(expected, ujson.loads(bytearray(doc)))
+        self.assertEqual({"b": None}, ujson.loads(memoryview(doc), fields=["b"]))
+        self.assertEqual(123, ujson.loads(memoryview(b"1234")[:3]))
+        self.assertEqual("ab", ujson.loads(memoryview(b'"ab"x')[:4]))
+        self.assertEqual([], ujson.loads(memoryview(b"  []  ]")[:-1]))
+
+    def test_decodeBuffersErrors(self):
+        # Truncated slices must fail on their own end, not go on into what follows them
+        for doc in (b'"ab', b"[1, 2", b"tru", b'{"a": ', b'{"a"', b'"\\u00', b'"\\', b"[", b""):
+            view = memoryview(doc + b'"]} 1')[:len(doc)]
+            self.assertRaises(ValueError, ujson.loads, view)
+            self.assertRaises(ValueError, ujson.Decoder().decode, view)
+        self.assertRaises(ValueError, ujson.loads, memoryview(b"[1] x"))
+        self.assertRaises(TypeError, ujson.loads, 1)
+        self.assertRaises(BufferError, ujson.loads, memoryview(b"[1, 2]")[::2])
+
+    def test_decodeBytearrayLocked(self):
+        # A bytearray can't be resized while it's decoded in place, here by a finalizer run by the collector
+        def resizeDuring(decode, doc):
+            data = bytearray(doc)
+            resized = []
+
+            class Resizer(object):
+                def __del__(self):
+                    try:
+                        data.extend(b" ")
+                        resized.append(True)
+                    except BufferError:
+                        resized.append(False)
+
+            threshold = gc.get_threshold()
+            gc.collect()
+            resizer = Resizer()
+            resizer.cycle = resizer
+            del resizer
+            gc.set_threshold(1)
+            try:
+                decode(data)
+            finally:
+                gc.set_threshold(*threshold)
+            return resized
+
+        doc = b"[" + b'[1, {"a": [2]}],' * 200 + b"[1]]"
+        self.assertEqual([False], resizeDuring(ujson.loads, doc))
+        self.assertEqual([False], resizeDuring(ujson.Decoder().decode, doc))
+        self.assertEqual([False], resizeDuring(ujson.loads_columns, b"[" + b'{"a": [1, {}]},' * 200 + b"{}]"))
+
+    def test_decodeStr(self):
+        # ASCII and Latin-1 strs are read in place, wider ones through UTF-8
+        for doc in ('{"a": ["x\\n", 1.5, null]}',
+                    '{"\u00e9": ["caf\u00e9\\u00ff", "\u00ff\u0080"], "a\u00e0": "\\"\u00e9"}',
+                    '{"\u20ac": "\u00e9\u20ac", "b": ["\U0001f600\\ud83d\\ude00"]}'):
+            expected = json.loads(doc)
+            self.assertEqual(expected, ujson.loads(doc))
+            self.assertEqual(expected, ujson.loads(doc.encode("utf-8")))
+            self.assertEqual(expected, ujson.loads(doc, structural_index=True))
+            self.assertEqual(expected, ujson.Decoder().decode(doc))
+        self.assertEqual({"\u00e9": 1}, ujson.loads('{"\u00e9": 1, "b": 2}', fields=["\u00e9"]))
+        decoder = ujson.Decoder()
+        self.assertEqual("\u00e9", decoder.decode('"\u00e9"'))
+        self.assertEqual("\u00e9", decoder.decode('"\u00e9"'.encode("utf-8")))
+
+    def test_decodeStrErrors(self):
+        for doc in ('"\u00e9', '\u00e9', '["\u00ff\\x"]', '{"\u00e9": }', '"\u00e9\x00"'):
+            self.assertRaises(ValueError, ujson.loads, doc)
+            self.assertRaises(ValueError, ujson.Decoder().decode, doc)
+        self.assertRaises(UnicodeEncodeError, ujson.loads, '"\ud800"')
+
+    def test_decodeTypedArrays(self):
+        doc = '{"t": [1, -2, 9223372036854775807], "v": [0.5, 1e3, -2], "m": [1, "a"], "e": [], "n": [[1.5], [2]]}'
+        expected = ujson.loads(doc)
+        for result in (ujson.loads(doc, typed_arrays=True), ujson.Decoder(typed_arrays=True).decode(doc),
+                       ujson.loads(memoryview(doc.encode("utf-8")), typed_arrays=True),
+                       ujson.load(six.BytesIO(doc.encode("utf-8")), typed_arrays=True)):
+            self.assertEqual(array.array("q", [1, -2, 9223372036854775807]), result["t"])
+            self.assertEqual(array.array("d", [0.5, 1000.0, -2.0]), result["v"])
+            self.assertEqual([1, "a"], result["m"])
+            self.assertEqual([], result["e"])
+            self.assertEqual([array.array("d", [1.5]), array.array("q", [2])], result["n"])
+            self.assertEqual(expected, json.loads(json.dumps(result, default=list)))
+        # Integers that wouldn't convert exactly keep the array a list
+        self.assertEqual([9007199254740993, 0.5], ujson.loads("[9007199254740993, 0.5]", typed_arrays=True))
+        self.assertEqual([18446744073709551615], ujson.loads("[18446744073709551615]", typed_arrays=True))
+        big = list(range(-100000, 100000, 3))
+        self.assertEqual(array.array("q", big), ujson.loads(json.dumps(big), typed_arrays=True))
+        self.assertEqual({"v": array.array("d", [0.1])}, ujson.loads('{"v": [0.1], "w": [1]}', fields=["v"], typed_arrays=True))
+
+    def test_decodeTypedArraysErrors(self):
+        for doc in ("[1,]", "[1 2]", "[1, 2", "[1, 2.5", "[99999999999999999999]", "[1] x", "[1, [2]"):
+            self.assertRaises(ValueError, ujson.loads, doc, typed_arrays=True)
+        self.assertRaises(ValueError, ujson.loads, "[1]", typed_arrays=True, structural_index=True)
+        self.assertRaises(ValueError, ujson.load, six.BytesIO(b"[1]"), typed_arrays=True, chunk_size=1)
+
+    def test_loadsColumns(self):
+        doc = ('[{"ts": 1, "v": 0.5, "k": "a", "big": 9007199254740993},'
+               ' {"v": 2, "ts": 2, "k": null, "big": 1.5, "x": [1]},'
+               ' {"ts": 3, "v": 1e3, "k": "\u00e9", "big": 1, "ts": 4}]')
+        expected = {"ts": array.array("q", [1, 2, 4]), "v": array.array("d", [0.5, 2.0, 1000.0]),
+                    "k": ["a", None, "\u00e9"], "big": [9007199254740993, 1.5, 1], "x": [None, [1], None]}
+        encoded = doc.encode("utf-8")
+        for data in (doc, encoded, bytearray(encoded), memoryview(encoded), memoryview(b"x" + encoded + b"]")[1:-1]):
+            result = ujson.loads_columns(data)
+            self.assertEqual(expected, result)
+            self.assertEqual(["ts", "v", "k", "big", "x"], list(result))
+        self.assertEqual({}, ujson.loads_columns(" [ ] "))
+        self.assertEqual({"a": [None, 1]}, ujson.loads_columns('[{}, {"a": 1}]'))
+        self.assertEqual({"a": array.array("d", [0.1])}, ujson.loads_columns('[{"a": 0.1}]', precise_float=True))
+        # Integers of a column of doubles that becomes a list are ints again, as with typed_arrays
+        for values in ([1, 0.5, "s"], [1, 0.5, None], [1, 0.5, 9007199254740993], [0.5, 1, "s"], [0.5, 2, 1e300, -3, [1]],
+                       list(range(100)) + [0.5] + list(range(100)) + ["s"]):
+            result = ujson.loads_columns(json.dumps([{"a": value} if value is not None else {} for value in values]))
+            self.assertEqual([type(value) for value in values], [type(value) for value in result["a"]])
+            self.assertEqual(values, result["a"])
+        self.assertEqual(ujson.loads("[1, 0.5, 2]", typed_arrays=True), ujson.loads_columns('[{"a": 1}, {"a": 0.5}, {"a": 2}]')["a"])
+        doc = json.dumps([{"i": i, "f": i / 7.0, "s": str(i)} for i in range(10000)])
+        rows = ujson.loads(doc)
+        result = ujson.loads_columns(doc)
+        self.assertEqual([row["i"] for row in rows], list(result["i"]))
+        self.assertEqual([row["f"] for row in rows], list(result["f"]))
+        self.assertEqual([row["s"] for row in rows], result["s"])
+
+    def test_loadsColumnsErrors(self):
+        for doc in ("", "{}", "[1]", '[{"a": 1}, 2]', "[{}", '[{"a": 1},]', '[{"a": }]', '[{1: 2}]', '[{"a" 1}]',
+                    '[{"a": 1}] x', '[{"a": [1,]}]', '[{"a": 99999999999999999999}]', '[{"a": "x}]'):
+            self.assertRaises(ValueError, ujson.loads_columns, doc)
+        # The records are decoded by the same code as loads, so they fail the same way
+        for doc in ('[{"a": 1},]', '[{"a": }]', '[{1: 2}]', '[{"a" 1}]', '[{"a": 1 "b": 2}]', '[{"a": 1}{}]', '[{"a": 12abc}]',
+                    '[{"a": [1,]}]', '[{"a": nul}]', '[{"a": 1}] x', '[{"a": "x}]', '[{"a": %s}]' % ("[" * 5000 + "]" * 5000)):
+            with self.assertRaises(ValueError) as loadsError:
+                ujson.loads(doc)
+            with self.assertRaises(ValueError) as columnsError:
+                ujson.loads_columns(doc)
+            self.assertEqual(str(loadsError.exception), str(columnsError.exception))
+        self.assertRaises(TypeError, ujson.loads_columns, 1)
+        self.assertRaises(UnicodeEncodeError, ujson.loads_columns, '[{"a": "\ud800"}]')
+
+    def test_decodeContainerSizes(self):
+        # Containers are made once they're closed, from the values kept on the decoder's value stack
+        docs = [list(range(1000)), {"k%d" % i: [i] * (i % 4) for i in range(300)}, [[], {}, [[]], [{}]],
+                [[i, {"a": [i, i + 1], "b": {}}] for i in range(200)], {"a": 1, "b": {"a": 2}, "c": [{"a": 3}]}]
+        for doc in docs:
+            encoded = json.dumps(doc)
+            self.assertEqual(doc, ujson.loads(encoded))
+            self.assertEqual([doc, doc], ujson.loads_lines(encoded + "\n" + encoded))
+        deep = []
+        for i in range(300):
+            deep = [i, deep, str(i)]
+        self.assertEqual(deep, ujson.loads(json.dumps(deep)))
+        self.assertEqual({"a": 3, "b": 2}, ujson.loads('{"a": 1, "b": 2, "a": 3}'))
+
+    def test_decodeContainerSizesErrors(self):
+        for doc in ("[1, 2, 3", '{"a": [1, 2], "b": [3, 4}', "[" + "1," * 1000 + "]", '[{"a": 1, "b": }]',
+                    "[[1, 2], [3, 4], 5, x]", '{"a": {"b": {"c": [1, 2, 3]}}'):
+            self.assertRaises(ValueError, ujson.loads, doc)
+
+    def test_saxEvents(self):
+        events, error, offset = ujson._sax_events('{"a": [1, -2.5e3, "x\\n", true, false, null], "b\\"": {}}')
+        self.assertEqual([("start_object",), ("key", b"a", 0), ("start_array",), ("scalar", "long", b"1", 0),
+                          ("scalar", "double", b"-2.5e3", 0), ("scalar", "string", b"x\\n", 1),
+                          ("scalar", "true", b"true", 0), ("scalar", "false", b"false", 0),
+                          ("scalar", "null", b"null", 0), ("end_array",), ("key", b"b\\\"", 1), ("start_object",),
+                          ("end_object",), ("end_object",)], events)
+        self.assertEqual((None, None), (error, offset))
+        self.assertEqual(([("scalar", "string", "\u00e9".encode("utf-8"), 0)], None, None), ujson._sax_events('"\u00e9"'))
+        # Nesting past the 64 levels kept on the C stack, and the depth limit
+        events = ujson._sax_events("[" * 200 + "]" * 200)[0]
+        self.assertEqual([("start_array",)] * 200 + [("end_array",)] * 200, events)
+        self.assertEqual(None, ujson._sax_events("[[[1]]]", max_depth=3)[1])
+        self.assertEqual(("Reached object decoding depth limit", 3), ujson._sax_events("[[[[1]]]]", max_depth=3)[1:])
+        self.assertEqual(([("start_array",), ("scalar", "long", b"1", 0)], "Stopped by the handler", 2),
+                         ujson._sax_events("[1, [2]]", stop_after=2))
+        # Nothing past the end of the buffer is read
+        self.assertEqual(([("start_array",), ("scalar", "long", b"12", 0)], "Unexpected character found when decoding array value (2)", 3),
+                         ujson._sax_events(memoryview(b"[12345]")[:3]))
+        for doc in ("[]", " {} ", '{"a":1,}', '[1, {"b": [null]}, "c"]', "[1,]", '{"a" 1}', "[1 2]", '"\\x"', "{", "1 2"):
+            try:
+                ujson.loads(doc)
+                expected = None
+            except ValueError as e:
+                expected = str(e)
+            self.assertEqual(expected, ujson._sax_events(doc)[1])
+
+    def test_saxEventsErrors(self):
+        errors = [("", "Expected object or value", 0),
+                  ("[1, 2", "Unexpected character found when decoding array value (2)", 5),
+                  ('{"a" 1}', "No ':' found when decoding object value", 5),
+                  ('{"a": 1 "b": 2}', "Unexpected character in found when decoding object value", 8),
+                  ("[1,]", "Unexpected character found when decoding array value (1)", 3),
+                  ("{1: 2}", "Key name of object must be 'string' when decoding 'object'", 1),
+                  ('"abc', "Unmatched ''\"' when when decoding 'string'", 4),
+                  ('"a\\q"', "Unrecognized escape sequence when decoding 'string'", 3),
+                  ('"\\u12g4"', "Unexpected character in unicode escape sequence when decoding 'string'", 5),
+                  ("[tru]", "Unexpected character found when decoding 'true'", 1),
+                  ("1 2", "Trailing data", 2),
+                  ("1e", "Trailing data", 1),
+                  ('{"a":}', "Expected object or value", 5)]
+        for doc, message, offset in errors:
+            self.assertEqual((message, offset), ujson._sax_events(doc)[1:])
+        self.assertEqual([("start_array",), ("scalar", "long", b"1", 0)], ujson._sax_events("[1, x]")[0])
+        self.assertRaises(TypeError, ujson._sax_events, 1)
+
+    def test_readerEvents(self):
+        doc = '{"a": [1, {"x": 2.5}], "b\\"": "s", "c": null}'
+        events, error, offset, end = ujson._reader_events(doc, "n" * 20)
+        self.assertEqual([("start_object", "object", b"{"), ("key", "string", b"a"), ("start_array", "array", b"["),
+                          ("scalar", "long", b"1"), ("start_object", "object", b"{"), ("key", "string", b"x"),
+                          ("scalar", "double", b"2.5"), ("end_object", "object", b"}"), ("end_array", "array", b"]"),
+                          ("key", "string", b"b\\\""), ("scalar", "string", b"s"), ("key", "string", b"c"),
+                          ("scalar", "null", b"null"), ("end_object", "object", b"}"), ("end", "invalid", b"")], events)
+        self.assertEqual((None, None, len(doc)), (error, offset, end))
+        # Skipping where a key is next skips the key and its value, in arrays a value at a time
+        self.assertEqual([("start_object", "object", b"{"), ("key", "string", b"a"), ("key", "string", b"b\\\""),
+                          ("key", "string", b"c"), ("end_object", "object", b"}"), ("end", "invalid", b"")],
+                         ujson._reader_events(doc, "nsssss")[0])
+        self.assertEqual(([("start_array", "array", b"["), ("start_array", "array", b"["), ("scalar", "long", b"3"),
+                           ("end_array", "array", b"]")], None, None, 13), ujson._reader_events("[[1, [2]], 3]", "nssn"))
+        # Skipped containers are only checked for balanced brackets
+        self.assertEqual((None, None, 10), ujson._reader_events("[1, [2, x], 3]", "nss")[1:])
+        # Reading can stop anywhere, also with the nesting kept on the heap
+        self.assertEqual(([("start_array", "array", b"["), ("scalar", "long", b"1")], None, None, 2), ujson._reader_events("[1, 2]", "nn"))
+        self.assertEqual(100, len(ujson._reader_events("[" * 100, "n" * 100)[0]))
+        self.assertEqual((None, None, 198), ujson._reader_events("[" * 100 + "]" * 100, "nns")[1:])
+
+    def test_readerEventsErrors(self):
+        self.assertEqual(([("scalar", "long", b"12"), ("error", "invalid", b"")], "Trailing data", 2, 2),
+                         ujson._reader_events("12abc", "nn"))
+        self.assertEqual(("Expected object or value", 4, 4), ujson._reader_events("[1, x]", "nnnn")[1:])
+        self.assertEqual(("Unexpected character found when decoding array value (2)", 9, 9), ujson._reader_events("[1, [2, 3", "nss")[1:])
+        self.assertEqual(("Unmatched ''\"' when when decoding 'string'", 8, 8), ujson._reader_events('{"a": "x', "ns")[1:])
+        self.assertEqual(("Reached object decoding depth limit", 2, 2), ujson._reader_events("[[[1]]]", "nnn", max_depth=2)[1:])
+        self.assertRaises(ValueError, ujson._reader_events, "[]", "nx")
+
+    def test_decodeStringCodePointOutOfRange(self):
+        self.assertRaises(ValueError, ujson.decode, b"\"\xf4\x90\x80\x80\"")
+
+    def test_encodeIndentBigObject(self):
+        obj = [{"key%d" % x: [x, {"nested": [str(x)] * 5}]} for x in range(5000)]
+        output = ujson.encode(obj, indent=4)
+        self.assertEqual(obj, json.loads(output))
+        self.assertEqual(obj, ujson.decode(output))
+
+    def test_decodeWhitespaceRuns(self):
+        for ws in (" ", "\n", " \t\r\n", " " * 15, " " * 16, " " * 17, "\n" + " " * 40):
+            doc = ws.join(["", "{", "\"a\"", ":", "[", "1", ",", "true", "]", ",", "\"b\"", ":", "{", "}", "}", ""])
+            self.assertEqual({"a": [1, True], "b": {}}, ujson.decode(doc))
+        self.assertRaises(ValueError, ujson.decode, " " * 100 + "x")
+        self.assertRaises(ValueError, ujson.decode, "[" + " " * 100)
+
     def test_object_default(self):
         # An object without toDict or __json__ defined should be serialized
         # as an empty dict.
@@ -861,6 +1471,20 @@ class UltraJSONTests(unittest.TestCase):
         self.assertEqual(1.893, ujson.loads("1.893"))
         self.assertEqual(1.3, ujson.loads("1.3"))
 
+    def test_decodePreciseFloatCorrectlyRounded(self):
+        for doc in ("0.1", "-0.0", "0.000000", "1e23", "8.98846567431158e307", "2.2250738585072014e-308",
+                    "9007199254740993.0", "9007199254740993.0000000000000000000001", "7.1e-10",
+                    "0.30000000000000004", "1.7976931348623157e308", "12345678901234567.5e30",
+                    "0.000000000000000000000000000001234", "1.e5",
+                    "1.00000000000000011102230246251565404236316680908203125"):
+            self.assertEqual(repr(float(doc)), repr(ujson.loads(doc, precise_float=True)))
+            self.assertEqual([float(doc), 1], ujson.loads("[" + doc + ",1]", precise_float=True))
+
+    def test_decodePreciseFloatRangeError(self):
+        self.assertRaises(ValueError, ujson.loads, "1.0e309", precise_float=True)
+        self.assertRaises(ValueError, ujson.loads, "-1e999999999999", precise_float=True)
+        self.assertEqual([0.0], ujson.loads("[0.0e999999]", precise_float=True))
+
     def test_encodeBigSet(self):
         s = set()
         for x in range(0, 100000):